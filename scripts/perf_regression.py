@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Performance regression test of the PMatrix benchmark driver.
+
+Runs the workloads listed in the baseline file (test/perf_baseline.json) with
+mpirun, each on its number of processes, and compares the fastest repetition
+with the stored time. The test fails if any workload is slower than its
+baseline by more than its tolerance (the file's default tolerance, unless
+the workload sets its own).
+
+Fill workloads are compared on the fill time, all others on the compute
+time (see src/benchmark.h).
+
+Baselines are machine dependent: record them on the reference machine with
+  scripts/perf_regression.py --exe build/PMatrix --update
+and commit the file. Workloads without a recorded time fail the test,
+unless it is run with --update. Usually run with `make perftests`.
+"""
+
+import argparse
+import json
+import platform
+import subprocess
+import sys
+import tempfile
+import os
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from scaling import gitCommit  # noqa: E402
+
+
+def runWorkload(args, workload):
+    """Runs one workload and returns the time compared to the baseline."""
+    with tempfile.NamedTemporaryFile(suffix=".jsonl", delete=False) as f:
+        outputFile = f.name
+    command = ([args.mpirun, "-np", str(workload["ranks"])]
+               + args.mpirun_args.split()
+               + [args.exe, "-bench", "-ops", workload["op"],
+                  "-sizes", str(workload["n"]),
+                  "-blocks", str(workload["block"]),
+                  "-reps", str(args.reps), "-warmups", "1",
+                  "-out", outputFile])
+    try:
+        subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+        with open(outputFile) as f:
+            record = json.loads(f.readline())
+    finally:
+        os.remove(outputFile)
+    if workload["op"] == "fill":
+        return record["fill_s"]["min"]
+    return record["compute_s"]["min"]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--exe", default="build/PMatrix",
+                        help="path to the PMatrix executable")
+    parser.add_argument("--mpirun", default="mpirun")
+    parser.add_argument("--mpirun-args", default="",
+                        help="extra arguments of mpirun, e.g. --oversubscribe")
+    parser.add_argument("--baseline", default="test/perf_baseline.json")
+    parser.add_argument("--reps", type=int, default=5)
+    parser.add_argument("--update", action="store_true",
+                        help="store the measured times as the new baseline")
+    args = parser.parse_args()
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)
+
+    if baseline["host"] and baseline["host"] != platform.node():
+        print("warning: baseline recorded on %s, running on %s"
+              % (baseline["host"], platform.node()))
+
+    print("%5s %-12s %6s %6s %12s %12s %8s  %s" % (
+        "ranks", "op", "n", "block", "baseline(s)", "time(s)", "ratio",
+        "status"))
+    numFailures = 0
+    numMissing = 0
+    for workload in baseline["workloads"]:
+        time = runWorkload(args, workload)
+        reference = workload["time"]
+        tolerance = workload.get("tolerance", baseline["tolerance"])
+        if reference is None or reference <= 0.:
+            ratio, status = float("nan"), "NO BASELINE"
+            numMissing += 1
+        else:
+            ratio = time / reference
+            if ratio > 1. + tolerance:
+                status = "REGRESSION (> %.0f%%)" % (100. * tolerance)
+                numFailures += 1
+            else:
+                status = "ok"
+        print("%5d %-12s %6d %6d %12s %12.4f %8.2f  %s" % (
+            workload["ranks"], workload["op"], workload["n"],
+            workload["block"],
+            "-" if reference is None else "%.4f" % reference, time, ratio,
+            status), flush=True)
+        if args.update:
+            workload["time"] = time
+
+    if args.update:
+        baseline["host"] = platform.node()
+        baseline["commit"] = gitCommit()
+        with open(args.baseline, "w") as f:
+            json.dump(baseline, f, indent=1)
+        print("baseline updated in", args.baseline)
+        return 0
+
+    if numMissing > 0:
+        print("%d workload(s) without a baseline, record them with --update"
+              % numMissing)
+    if numFailures > 0:
+        print("%d workload(s) regressed" % numFailures)
+    if numFailures > 0 or numMissing > 0:
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,217 @@
+#!/usr/bin/env python3
+"""Strong and weak scaling study of the PMatrix benchmark driver.
+
+Runs `PMatrix -bench` with mpirun over a list of process counts, collects
+the JSON lines it prints (see src/benchmark.h), stores them together with
+the git commit and the machine in a results file, and prints tables of
+parallel efficiency and of the time breakdown (fill, compute, comm).
+
+Strong scaling keeps the matrix sizes fixed. Weak scaling keeps the work per
+process fixed: the sizes given are those of the smallest process count, and
+grow as (p / p0)^(1/3), since gemm and the eigensolvers cost O(n^3).
+
+The comm column is the time spent in the MPIcontroller wrappers; the
+communication done by BLACS inside ScaLAPACK is part of the compute time.
+
+Examples:
+  scripts/scaling.py --exe build/PMatrix --ranks 1,4,9,16 --ops gemm,syevd \\
+      --sizes 4096 --mode strong
+  scripts/scaling.py --exe build/PMatrix --ranks 1,4,16 --sizes 2048 \\
+      --mode weak --compare results/scaling-strong-1a2b3c4.json
+  scripts/scaling.py --exe build/PMatrix --ranks 16,64,256 --ops eye \\
+      --sizes 100000 --reps 5
+"""
+
+import argparse
+import datetime
+import json
+import os
+import platform
+import subprocess
+import sys
+import tempfile
+
+
+def gitCommit():
+    """Returns the current commit, with a '+dirty' suffix if the tree has
+    uncommitted changes, or 'unknown' outside of a git repository."""
+    try:
+        commit = subprocess.check_output(
+            ["git", "rev-parse", "--short", "HEAD"],
+            stderr=subprocess.DEVNULL, text=True).strip()
+        status = subprocess.check_output(
+            ["git", "status", "--porcelain", "--untracked-files=no"],
+            stderr=subprocess.DEVNULL, text=True)
+        return commit + ("+dirty" if status.strip() else "")
+    except (subprocess.CalledProcessError, FileNotFoundError):
+        return "unknown"
+
+
+def sizesFor(args, ranks):
+    if args.mode == "strong":
+        return args.sizes
+    p0 = args.ranks[0]
+    return [int(round(n * (ranks / p0) ** (1. / 3.))) for n in args.sizes]
+
+
+def runBenchmark(args, ranks):
+    """Runs the benchmark driver on a number of processes and returns the
+    list of result records."""
+    with tempfile.NamedTemporaryFile(suffix=".jsonl", delete=False) as f:
+        outputFile = f.name
+    command = ([args.mpirun, "-np", str(ranks)] + args.mpirun_args.split()
+               + [args.exe, "-bench",
+                  "-ops", ",".join(args.ops),
+                  "-sizes", ",".join(str(n) for n in sizesFor(args, ranks)),
+                  "-blocks", ",".join(str(b) for b in args.blocks),
+                  "-reps", str(args.reps),
+                  "-warmups", str(args.warmups),
+                  "-out", outputFile])
+    print("running:", " ".join(command), file=sys.stderr)
+    try:
+        subprocess.run(command, check=True, stdout=subprocess.DEVNULL)
+        with open(outputFile) as f:
+            return [json.loads(line) for line in f if line.startswith("{")]
+    finally:
+        os.remove(outputFile)
+
+
+def efficiency(mode, reference, record):
+    """Parallel efficiency of a record with respect to the reference record
+    (the one with the fewest processes)."""
+    t0 = reference["compute_s"]["min"]
+    t = record["compute_s"]["min"]
+    if t <= 0.:
+        return float("nan")
+    if mode == "strong":
+        return t0 * reference["procs"] / (t * record["procs"])
+    return t0 / t
+
+
+def printTables(results, previous=None, file=sys.stdout):
+    """Prints the scaling tables in markdown. If previous results are given,
+    adds the ratio of the compute times (previous / current, >1 is faster)."""
+    mode = results["mode"]
+    records = results["records"]
+
+    def key(r):
+        return (r["op"], r["block"], r["procs"], r["n"])
+
+    oldRecords = {}
+    if previous is not None:
+        for r in previous["records"]:
+            oldRecords[key(r)] = r
+
+    print("# %s scaling, commit %s, %s, %s\n" % (
+        mode, results["commit"], results["host"], results["date"]),
+        file=file)
+    series = sorted({(r["op"], r["block"]) for r in records})
+    for op, block in series:
+        rows = sorted([r for r in records
+                       if r["op"] == op and r["block"] == block],
+                      key=lambda r: (r["n"] if mode == "strong" else 0,
+                                     r["procs"]))
+        # in strong scaling, each size is a separate series
+        groups = {}
+        for r in rows:
+            groups.setdefault(r["n"] if mode == "strong" else 0, []).append(r)
+        for _, group in sorted(groups.items()):
+            reference = group[0]
+            title = "## %s, block %d" % (op, block)
+            if mode == "strong":
+                title += ", n = %d" % reference["n"]
+            print(title + "\n", file=file)
+            header = ("| procs | grid | n | fill (s) | compute (s) | "
+                      "comm (s) | GFLOP/s | efficiency |")
+            line = "|---|---|---|---|---|---|---|---|"
+            if previous is not None:
+                header += " vs %s |" % previous["commit"]
+                line += "---|"
+            print(header, file=file)
+            print(line, file=file)
+            for r in group:
+                row = "| %d | %dx%d | %d | %.4f | %.4f | %.4f | %.2f | %.2f |" % (
+                    r["procs"], r["grid"][0], r["grid"][1], r["n"],
+                    r["fill_s"]["mean"], r["compute_s"]["min"],
+                    r["comm_s"]["mean"], r["gflops"],
+                    efficiency(mode, reference, r))
+                if previous is not None:
+                    old = oldRecords.get(key(r))
+                    if old is not None and r["compute_s"]["min"] > 0.:
+                        row += " %.2fx |" % (old["compute_s"]["min"]
+                                             / r["compute_s"]["min"])
+                    else:
+                        row += " - |"
+                print(row, file=file)
+            print("", file=file)
+
+
+def parseArguments():
+    parser = argparse.ArgumentParser(
+        description=__doc__,
+        formatter_class=argparse.RawDescriptionHelpFormatter)
+
+    def intList(s):
+        return [int(x) for x in s.split(",")]
+
+    parser.add_argument("--exe", default="build/PMatrix",
+                        help="path to the PMatrix executable")
+    parser.add_argument("--mpirun", default="mpirun")
+    parser.add_argument("--mpirun-args", default="",
+                        help="extra arguments of mpirun, e.g. --oversubscribe")
+    parser.add_argument("--mode", choices=["strong", "weak"],
+                        default="strong")
+    parser.add_argument("--ranks", type=intList, default=[1, 4, 9, 16],
+                        help="comma separated process counts")
+    parser.add_argument("--ops", type=lambda s: s.split(","),
+                        default=["gemm", "syevd"])
+    parser.add_argument("--sizes", type=intList, default=[4096])
+    parser.add_argument("--blocks", type=intList, default=[64])
+    parser.add_argument("--reps", type=int, default=3)
+    parser.add_argument("--warmups", type=int, default=1)
+    parser.add_argument("--results-dir", default="results",
+                        help="directory where the results file is written")
+    parser.add_argument("--compare",
+                        help="results file of a previous run to compare to")
+    parser.add_argument("--report-only",
+                        help="print the tables of an existing results file")
+    return parser.parse_args()
+
+
+def main():
+    args = parseArguments()
+
+    previous = None
+    if args.compare:
+        with open(args.compare) as f:
+            previous = json.load(f)
+
+    if args.report_only:
+        with open(args.report_only) as f:
+            printTables(json.load(f), previous)
+        return
+
+    results = {
+        "commit": gitCommit(),
+        "host": platform.node(),
+        "date": datetime.datetime.now().isoformat(timespec="seconds"),
+        "mode": args.mode,
+        "records": [],
+    }
+    for ranks in args.ranks:
+        results["records"] += runBenchmark(args, ranks)
+
+    os.makedirs(args.results_dir, exist_ok=True)
+    fileName = os.path.join(args.results_dir, "scaling-%s-%s.json" % (
+        args.mode, results["commit"]))
+    with open(fileName, "w") as f:
+        json.dump(results, f, indent=1)
+    print("results written to", fileName, file=sys.stderr)
+
+    printTables(results, previous)
+    with open(os.path.splitext(fileName)[0] + ".md", "w") as f:
+        printTables(results, previous, file=f)
+
+
+if __name__ == "__main__":
+    main()
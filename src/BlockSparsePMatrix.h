@@ -0,0 +1,721 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <vector>
+#include "PMatrix.h"
+#include "scalapackTraits.h"
+
+/** Class for a block-sparse matrix, MPI-distributed like a ParallelMatrix,
+ * which only stores the tiles (the blocks of the block-cyclic distribution)
+ * that are nonzero.
+ *
+ * Which tiles are nonzero is known by every MPI process, while each process
+ * stores the nonzero tiles it owns, one after the other, each tile in
+ * column-major order. prod(), the element-wise operations and dot() skip
+ * the zero tiles, so that their cost scales with the fraction of nonzero
+ * tiles (the tile fill ratio) rather than with the size of the matrix.
+ * Scalapack calls need the dense matrix, which is expanded just in time
+ * (e.g. diagonalize()) with toParallelMatrix().
+ */
+template <typename T>
+class BlockSparseParallelMatrix {
+ private:
+  int numRows_ = 0;
+  int numCols_ = 0;
+  // as in ParallelMatrix, the requested number of blocks and the block size
+  int numBlocksRows_ = 0;
+  int numBlocksCols_ = 0;
+  int blockSizeRows_ = 0;
+  int blockSizeCols_ = 0;
+  // tiles of blockSize rows/cols that actually cover the matrix (the last
+  // one may be smaller), in total and on this MPI process
+  int numTileRows_ = 0;
+  int numTileCols_ = 0;
+  int numLocalTileRows_ = 0;
+  int numLocalTileCols_ = 0;
+
+  // BLACS process grid, as in ParallelMatrix
+  blacsInt numBlacsRows_ = 0;
+  blacsInt numBlacsCols_ = 0;
+  blacsInt myBlacsRow_ = 0;
+  blacsInt myBlacsCol_ = 0;
+  blacsInt blacsContext_ = 0;
+
+  // nonzeroTiles_[ib + jb * numTileRows_] is 1 if the tile (ib,jb) is
+  // stored, the same on all MPI processes
+  std::vector<char> nonzeroTiles_;
+  // start in mat of the local tile (ib/numBlacsRows_, jb/numBlacsCols_),
+  // or -1 if the tile is zero
+  std::vector<int64_t> tileOffsets_;
+  std::vector<T> mat;
+
+  // dummy values to return when accessing elements not available locally
+  T dummyZero = 0;
+
+  BlockSparseParallelMatrix() = default;
+
+  /** Sets up (or reads) the process grid and the blocking, as the
+   * ParallelMatrix constructor does.
+   */
+  void initGrid(const int& numRows, const int& numCols,
+                const int& numBlocksRows, const int& numBlocksCols,
+                const int& blacsContext);
+
+  /** Sets the nonzero tiles and allocates the (zeroed) local tiles.
+   */
+  void initLayout(const std::vector<char>& nonzeroTiles);
+
+  /** Adds the tiles of nonzeroTiles which are zero in this matrix to the
+   * stored ones, keeping the values of the tiles already stored.
+   */
+  void addTiles(const std::vector<char>& nonzeroTiles);
+
+  int tileRows(const int& ib) const {
+    return std::min(blockSizeRows_, numRows_ - ib * blockSizeRows_);
+  }
+  int tileCols(const int& jb) const {
+    return std::min(blockSizeCols_, numCols_ - jb * blockSizeCols_);
+  }
+  bool isNonzero(const int& ib, const int& jb) const {
+    return nonzeroTiles_[ib + size_t(jb) * numTileRows_] != 0;
+  }
+
+  /** Returns the start in mat of the tile (ib,jb), or -1 if the tile is
+   * zero or isn't owned by this MPI process.
+   */
+  int64_t tileOffset(const int& ib, const int& jb) const;
+
+  /** Errors out if the two matrices aren't distributed in the same way.
+   */
+  void checkSameLayout(const BlockSparseParallelMatrix<T>& that) const;
+
+  /** Broadcasts a panel of tiles within a row or a column ("Row" or
+   * "Column") of the process grid, from the process at column (or row)
+   * source of that scope.
+   */
+  void broadcastPanel(std::vector<T>& panel, const char* scope,
+                      const blacsInt& source) const;
+
+ public:
+  /** Constructor of a matrix with the given nonzero tiles, set to zero.
+   * @param numRows, numCols, numBlocksRows, numBlocksCols, blacsContext:
+   * as for the ParallelMatrix constructor.
+   * @param nonzeroTiles: (row, col) indices of the tiles to be stored,
+   * the same on all MPI processes. Tile (ib,jb) holds the rows from
+   * ib * blockSizeRows, with blockSizeRows = ceil(numRows/numBlocksRows).
+   */
+  BlockSparseParallelMatrix(const int& numRows, const int& numCols,
+                            const int& numBlocksRows, const int& numBlocksCols,
+                            const std::vector<std::tuple<int, int>>& nonzeroTiles,
+                            const int& blacsContext = -1);
+
+  /** Converts a dense matrix, keeping the tiles with at least an element
+   * larger than threshold in absolute value. The block-sparse matrix uses
+   * the same blacs context and blocking. Must be called by all processes.
+   */
+  explicit BlockSparseParallelMatrix(const ParallelMatrix<T>& that,
+                                     const double& threshold = 0.);
+
+  /** Copy constructor
+   */
+  BlockSparseParallelMatrix(const BlockSparseParallelMatrix<T>& that);
+
+  /** Copy assignment
+   */
+  BlockSparseParallelMatrix& operator=(const BlockSparseParallelMatrix<T>& that);
+
+  ~BlockSparseParallelMatrix();
+
+  /** Find global number of rows and columns
+   */
+  int rows() const { return numRows_; }
+  int cols() const { return numCols_; }
+
+  /** Number of elements stored by this MPI process.
+   */
+  size_t localSize() const { return mat.size(); }
+
+  /** Number of nonzero tiles, and their fraction of all the tiles.
+   */
+  int numNonzeroTiles() const;
+  double fillRatio() const;
+
+  /** Returns true if the element (row,col) belongs to a nonzero tile
+   * stored by this MPI process.
+   */
+  bool indicesAreLocal(const int& row, const int& col) const;
+
+  /** Get and set operator, for elements of the nonzero tiles.
+   * Returns a dummy zero if the element isn't stored by this MPI process,
+   * and errors out if it is owned by this process but its tile is zero:
+   * tiles can only be added collectively, e.g. with operator+=.
+   */
+  T& operator()(const int& row, const int& col);
+
+  /** Returns any element of the matrix owned by this MPI process,
+   * zero for the elements of zero tiles or of other processes.
+   */
+  T get(const int& row, const int& col) const;
+
+  /** Expands the matrix into a dense ParallelMatrix, on the same context
+   * and with the same blocking.
+   */
+  ParallelMatrix<T> toParallelMatrix() const;
+
+  /** Diagonalizes the matrix, as ParallelMatrix::diagonalize(): the dense
+   * matrix only lives for the duration of the call.
+   */
+  std::tuple<std::vector<double>, ParallelMatrix<T>> diagonalize();
+  std::tuple<std::vector<double>, ParallelMatrix<T>> diagonalize(
+      int numEigenvalues);
+
+  /** Matrix-matrix multiplication C = A B, skipping the zero tiles.
+   * As in scalapack's SUMMA, for every block of the inner dimension the
+   * nonzero tiles of the column of A are broadcast along the rows of the
+   * process grid and those of the row of B along the columns, and each
+   * process multiplies the pairs of nonzero tiles of its tiles of C.
+   * The tiles of C are the ones with at least one nonzero product.
+   * The matrices must share the blacs context and the inner blocking.
+   */
+  BlockSparseParallelMatrix<T> prod(
+      const BlockSparseParallelMatrix<T>& that) const;
+
+  /** Matrix-matrix addition and subtraction, with a matrix of the same
+   * size and distribution. Tiles nonzero in that are added to this matrix.
+   */
+  BlockSparseParallelMatrix<T>& operator+=(
+      const BlockSparseParallelMatrix<T>& that);
+  BlockSparseParallelMatrix<T>& operator-=(
+      const BlockSparseParallelMatrix<T>& that);
+
+  /** Matrix-scalar multiplication and division.
+   */
+  BlockSparseParallelMatrix<T>& operator*=(const T& that);
+  BlockSparseParallelMatrix<T>& operator/=(const T& that);
+
+  /** Computes \sum_ij A_ij * B_ij, as ParallelMatrix::dot(), over the tiles
+   * that are nonzero in both matrices.
+   */
+  T dot(const BlockSparseParallelMatrix<T>& that) const;
+
+  /** Computes the squared Frobenius norm of the matrix
+   */
+  T squaredNorm() const;
+
+  /** Computes the Frobenius norm of the matrix
+   */
+  T norm() const;
+};
+
+template <typename T>
+void BlockSparseParallelMatrix<T>::initGrid(const int& numRows,
+                                            const int& numCols,
+                                            const int& numBlocksRows,
+                                            const int& numBlocksCols,
+                                            const int& blacsContext) {
+  // let ParallelMatrix set up (or read) the process grid
+  ParallelMatrix<T> grid;
+  grid.initBlacs(0, 0, blacsContext);
+  numBlacsRows_ = grid.numBlacsRows_;
+  numBlacsCols_ = grid.numBlacsCols_;
+  myBlacsRow_ = grid.myBlacsRow_;
+  myBlacsCol_ = grid.myBlacsCol_;
+  blacsContext_ = grid.blacsContext_;
+
+  numRows_ = numRows;
+  numCols_ = numCols;
+  numBlocksRows_ = numBlocksRows == 0 ? int(numBlacsRows_) : numBlocksRows;
+  numBlocksCols_ = numBlocksCols == 0 ? int(numBlacsCols_) : numBlocksCols;
+  // same block size as the ParallelMatrix constructor
+  blockSizeRows_ = numRows_ / numBlocksRows_;
+  if (numRows_ % numBlocksRows_ != 0) blockSizeRows_ += 1;
+  blockSizeCols_ = numCols_ / numBlocksCols_;
+  if (numCols_ % numBlocksCols_ != 0) blockSizeCols_ += 1;
+
+  numTileRows_ = (numRows_ + blockSizeRows_ - 1) / blockSizeRows_;
+  numTileCols_ = (numCols_ + blockSizeCols_ - 1) / blockSizeCols_;
+  // tiles ib = lib * numBlacsRows_ + myBlacsRow_ are local
+  numLocalTileRows_ = myBlacsRow_ < numTileRows_
+      ? (numTileRows_ - 1 - int(myBlacsRow_)) / int(numBlacsRows_) + 1 : 0;
+  numLocalTileCols_ = myBlacsCol_ < numTileCols_
+      ? (numTileCols_ - 1 - int(myBlacsCol_)) / int(numBlacsCols_) + 1 : 0;
+}
+
+template <typename T>
+void BlockSparseParallelMatrix<T>::initLayout(
+    const std::vector<char>& nonzeroTiles) {
+  nonzeroTiles_ = nonzeroTiles;
+  tileOffsets_.assign(size_t(numLocalTileRows_) * numLocalTileCols_, -1);
+  size_t numElements = 0;
+  for (int ljb = 0; ljb < numLocalTileCols_; ljb++) {
+    int jb = ljb * numBlacsCols_ + myBlacsCol_;
+    for (int lib = 0; lib < numLocalTileRows_; lib++) {
+      int ib = lib * numBlacsRows_ + myBlacsRow_;
+      if (!isNonzero(ib, jb)) continue;
+      tileOffsets_[lib + size_t(ljb) * numLocalTileRows_] = numElements;
+      numElements += size_t(tileRows(ib)) * tileCols(jb);
+    }
+  }
+  mat.assign(numElements, T(0.));
+  trackMemory("BlockSparseParallelMatrix", mat.size() * sizeof(T));
+}
+
+template <typename T>
+void BlockSparseParallelMatrix<T>::addTiles(
+    const std::vector<char>& nonzeroTiles) {
+  std::vector<char> allTiles = nonzeroTiles_;
+  for (size_t t = 0; t < allTiles.size(); t++) {
+    allTiles[t] = allTiles[t] || nonzeroTiles[t];
+  }
+  if (allTiles == nonzeroTiles_) return;
+
+  std::vector<int64_t> oldOffsets = tileOffsets_;
+  std::vector<T> oldMat = std::move(mat);
+  trackMemory("BlockSparseParallelMatrix", -long(oldMat.size() * sizeof(T)));
+  initLayout(allTiles);
+  for (size_t t = 0; t < oldOffsets.size(); t++) {
+    if (oldOffsets[t] == -1) continue;
+    int ib = int(t % numLocalTileRows_) * numBlacsRows_ + myBlacsRow_;
+    int jb = int(t / numLocalTileRows_) * numBlacsCols_ + myBlacsCol_;
+    size_t tileSize = size_t(tileRows(ib)) * tileCols(jb);
+    std::copy(oldMat.begin() + oldOffsets[t],
+              oldMat.begin() + oldOffsets[t] + tileSize,
+              mat.begin() + tileOffsets_[t]);
+  }
+}
+
+template <typename T>
+int64_t BlockSparseParallelMatrix<T>::tileOffset(const int& ib,
+                                                 const int& jb) const {
+  if (ib % numBlacsRows_ != myBlacsRow_ || jb % numBlacsCols_ != myBlacsCol_) {
+    return -1;
+  }
+  return tileOffsets_[ib / numBlacsRows_ +
+                      size_t(jb / numBlacsCols_) * numLocalTileRows_];
+}
+
+template <typename T>
+void BlockSparseParallelMatrix<T>::checkSameLayout(
+    const BlockSparseParallelMatrix<T>& that) const {
+  if (numRows_ != that.numRows_ || numCols_ != that.numCols_ ||
+      blockSizeRows_ != that.blockSizeRows_ ||
+      blockSizeCols_ != that.blockSizeCols_ ||
+      blacsContext_ != that.blacsContext_) {
+    Error("Cannot combine block-sparse matrices of different distributions.");
+  }
+}
+
+template <typename T>
+void BlockSparseParallelMatrix<T>::broadcastPanel(std::vector<T>& panel,
+                                                  const char* scope,
+                                                  const blacsInt& source) const {
+  bool isRow = scope[0] == 'R';
+  if ((isRow ? numBlacsCols_ : numBlacsRows_) == 1) return;
+  blacsInt m = panel.size();
+  blacsInt n = 1;
+  if ((isRow ? myBlacsCol_ : myBlacsRow_) == source) {
+    scalapack<T>::gebs2d(&blacsContext_, scope, &m, &n, panel.data(), &m);
+  } else {
+    blacsInt sourceRow = isRow ? myBlacsRow_ : source;
+    blacsInt sourceCol = isRow ? source : myBlacsCol_;
+    scalapack<T>::gebr2d(&blacsContext_, scope, &m, &n, panel.data(), &m,
+                         &sourceRow, &sourceCol);
+  }
+}
+
+template <typename T>
+BlockSparseParallelMatrix<T>::BlockSparseParallelMatrix(
+    const int& numRows, const int& numCols, const int& numBlocksRows,
+    const int& numBlocksCols,
+    const std::vector<std::tuple<int, int>>& nonzeroTiles,
+    const int& blacsContext) {
+  initGrid(numRows, numCols, numBlocksRows, numBlocksCols, blacsContext);
+  std::vector<char> tiles(size_t(numTileRows_) * numTileCols_, 0);
+  for (auto [ib, jb] : nonzeroTiles) {
+    if (ib < 0 || ib >= numTileRows_ || jb < 0 || jb >= numTileCols_) {
+      Error("Tile " + std::to_string(ib) + " " + std::to_string(jb) +
+            " is outside of the block-sparse matrix.");
+    }
+    tiles[ib + size_t(jb) * numTileRows_] = 1;
+  }
+  initLayout(tiles);
+}
+
+template <typename T>
+BlockSparseParallelMatrix<T>::BlockSparseParallelMatrix(
+    const ParallelMatrix<T>& that, const double& threshold) {
+  initGrid(that.numRows_, that.numCols_, that.numBlocksRows_,
+           that.numBlocksCols_, that.blacsContext_);
+
+  // find the local nonzero tiles, then share them with all processes
+  size_t lld = that.descMat_[8];
+  std::vector<int> tiles(size_t(numTileRows_) * numTileCols_, 0);
+  for (int ljb = 0; ljb < numLocalTileCols_; ljb++) {
+    int jb = ljb * numBlacsCols_ + myBlacsCol_;
+    for (int lib = 0; lib < numLocalTileRows_; lib++) {
+      int ib = lib * numBlacsRows_ + myBlacsRow_;
+      bool isZero = true;
+      for (int j = 0; j < tileCols(jb) && isZero; j++) {
+        const T* column = that.mat + (size_t(ljb) * blockSizeCols_ + j) * lld
+                          + size_t(lib) * blockSizeRows_;
+        for (int i = 0; i < tileRows(ib); i++) {
+          if (std::abs(column[i]) > threshold) {
+            isZero = false;
+            break;
+          }
+        }
+      }
+      if (!isZero) tiles[ib + size_t(jb) * numTileRows_] = 1;
+    }
+  }
+  mpi->allReduceSum(&tiles);
+  initLayout(std::vector<char>(tiles.begin(), tiles.end()));
+
+  for (int ljb = 0; ljb < numLocalTileCols_; ljb++) {
+    int jb = ljb * numBlacsCols_ + myBlacsCol_;
+    for (int lib = 0; lib < numLocalTileRows_; lib++) {
+      int ib = lib * numBlacsRows_ + myBlacsRow_;
+      int64_t offset = tileOffsets_[lib + size_t(ljb) * numLocalTileRows_];
+      if (offset == -1) continue;
+      for (int j = 0; j < tileCols(jb); j++) {
+        const T* column = that.mat + (size_t(ljb) * blockSizeCols_ + j) * lld
+                          + size_t(lib) * blockSizeRows_;
+        std::copy(column, column + tileRows(ib),
+                  mat.begin() + offset + size_t(j) * tileRows(ib));
+      }
+    }
+  }
+}
+
+template <typename T>
+BlockSparseParallelMatrix<T>::BlockSparseParallelMatrix(
+    const BlockSparseParallelMatrix<T>& that)
+    : numRows_(that.numRows_), numCols_(that.numCols_),
+      numBlocksRows_(that.numBlocksRows_), numBlocksCols_(that.numBlocksCols_),
+      blockSizeRows_(that.blockSizeRows_), blockSizeCols_(that.blockSizeCols_),
+      numTileRows_(that.numTileRows_), numTileCols_(that.numTileCols_),
+      numLocalTileRows_(that.numLocalTileRows_),
+      numLocalTileCols_(that.numLocalTileCols_),
+      numBlacsRows_(that.numBlacsRows_), numBlacsCols_(that.numBlacsCols_),
+      myBlacsRow_(that.myBlacsRow_), myBlacsCol_(that.myBlacsCol_),
+      blacsContext_(that.blacsContext_), nonzeroTiles_(that.nonzeroTiles_),
+      tileOffsets_(that.tileOffsets_), mat(that.mat) {
+  trackMemory("BlockSparseParallelMatrix", mat.size() * sizeof(T));
+}
+
+template <typename T>
+BlockSparseParallelMatrix<T>& BlockSparseParallelMatrix<T>::operator=(
+    const BlockSparseParallelMatrix<T>& that) {
+  if (this != &that) {
+    trackMemory("BlockSparseParallelMatrix", -long(mat.size() * sizeof(T)));
+    numRows_ = that.numRows_;
+    numCols_ = that.numCols_;
+    numBlocksRows_ = that.numBlocksRows_;
+    numBlocksCols_ = that.numBlocksCols_;
+    blockSizeRows_ = that.blockSizeRows_;
+    blockSizeCols_ = that.blockSizeCols_;
+    numTileRows_ = that.numTileRows_;
+    numTileCols_ = that.numTileCols_;
+    numLocalTileRows_ = that.numLocalTileRows_;
+    numLocalTileCols_ = that.numLocalTileCols_;
+    numBlacsRows_ = that.numBlacsRows_;
+    numBlacsCols_ = that.numBlacsCols_;
+    myBlacsRow_ = that.myBlacsRow_;
+    myBlacsCol_ = that.myBlacsCol_;
+    blacsContext_ = that.blacsContext_;
+    nonzeroTiles_ = that.nonzeroTiles_;
+    tileOffsets_ = that.tileOffsets_;
+    mat = that.mat;
+    trackMemory("BlockSparseParallelMatrix", mat.size() * sizeof(T));
+  }
+  return *this;
+}
+
+template <typename T>
+BlockSparseParallelMatrix<T>::~BlockSparseParallelMatrix() {
+  trackMemory("BlockSparseParallelMatrix", -long(mat.size() * sizeof(T)));
+}
+
+template <typename T>
+int BlockSparseParallelMatrix<T>::numNonzeroTiles() const {
+  int count = 0;
+  for (char tile : nonzeroTiles_) count += tile;
+  return count;
+}
+
+template <typename T>
+double BlockSparseParallelMatrix<T>::fillRatio() const {
+  if (nonzeroTiles_.empty()) return 0.;
+  return double(numNonzeroTiles()) / double(nonzeroTiles_.size());
+}
+
+template <typename T>
+bool BlockSparseParallelMatrix<T>::indicesAreLocal(const int& row,
+                                                   const int& col) const {
+  return tileOffset(row / blockSizeRows_, col / blockSizeCols_) != -1;
+}
+
+template <typename T>
+T& BlockSparseParallelMatrix<T>::operator()(const int& row, const int& col) {
+  int ib = row / blockSizeRows_;
+  int jb = col / blockSizeCols_;
+  int64_t offset = tileOffset(ib, jb);
+  if (offset == -1) {
+    if (ib % numBlacsRows_ == myBlacsRow_ &&
+        jb % numBlacsCols_ == myBlacsCol_) {
+      DeveloperError("Element " + std::to_string(row) + " " +
+                     std::to_string(col) +
+                     " belongs to a zero tile of a block-sparse matrix.");
+    }
+    dummyZero = 0.;
+    return dummyZero;
+  }
+  return mat[offset + size_t(col % blockSizeCols_) * tileRows(ib) +
+             row % blockSizeRows_];
+}
+
+template <typename T>
+T BlockSparseParallelMatrix<T>::get(const int& row, const int& col) const {
+  int ib = row / blockSizeRows_;
+  int jb = col / blockSizeCols_;
+  int64_t offset = tileOffset(ib, jb);
+  if (offset == -1) return T(0.);
+  return mat[offset + size_t(col % blockSizeCols_) * tileRows(ib) +
+             row % blockSizeRows_];
+}
+
+template <typename T>
+ParallelMatrix<T> BlockSparseParallelMatrix<T>::toParallelMatrix() const {
+  ParallelMatrix<T> result(numRows_, numCols_, numBlocksRows_, numBlocksCols_,
+                           blacsContext_);
+  size_t lld = result.descMat_[8];
+  for (int ljb = 0; ljb < numLocalTileCols_; ljb++) {
+    int jb = ljb * numBlacsCols_ + myBlacsCol_;
+    for (int lib = 0; lib < numLocalTileRows_; lib++) {
+      int ib = lib * numBlacsRows_ + myBlacsRow_;
+      int64_t offset = tileOffsets_[lib + size_t(ljb) * numLocalTileRows_];
+      if (offset == -1) continue;
+      for (int j = 0; j < tileCols(jb); j++) {
+        auto tileColumn = mat.begin() + offset + size_t(j) * tileRows(ib);
+        std::copy(tileColumn, tileColumn + tileRows(ib),
+                  result.mat + (size_t(ljb) * blockSizeCols_ + j) * lld
+                      + size_t(lib) * blockSizeRows_);
+      }
+    }
+  }
+  return result;
+}
+
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+BlockSparseParallelMatrix<T>::diagonalize() {
+  ParallelMatrix<T> dense = toParallelMatrix();
+  return dense.diagonalize();
+}
+
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+BlockSparseParallelMatrix<T>::diagonalize(int numEigenvalues) {
+  ParallelMatrix<T> dense = toParallelMatrix();
+  return dense.diagonalize(numEigenvalues);
+}
+
+template <typename T>
+BlockSparseParallelMatrix<T> BlockSparseParallelMatrix<T>::prod(
+    const BlockSparseParallelMatrix<T>& that) const {
+  if (numCols_ != that.numRows_) {
+    Error("Cannot multiply matrices for which lhs.cols != rhs.rows.");
+  }
+  if (blockSizeCols_ != that.blockSizeRows_ ||
+      blacsContext_ != that.blacsContext_) {
+    Error("Block-sparse products need the same blacs context and the same "
+          "blocking of lhs.cols and rhs.rows.");
+  }
+  using Matrix = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+  // the result has the rows of this matrix and the columns of that one
+  BlockSparseParallelMatrix<T> result;
+  result.initGrid(numRows_, that.numCols_, numBlocksRows_, that.numBlocksCols_,
+                  blacsContext_);
+  std::vector<char> productTiles(size_t(numTileRows_) * that.numTileCols_, 0);
+  double flops = 0.;
+  for (int jb = 0; jb < that.numTileCols_; jb++) {
+    for (int kb = 0; kb < numTileCols_; kb++) {
+      if (!that.isNonzero(kb, jb)) continue;
+      for (int ib = 0; ib < numTileRows_; ib++) {
+        if (!isNonzero(ib, kb)) continue;
+        productTiles[ib + size_t(jb) * numTileRows_] = 1;
+        if (ib % numBlacsRows_ == myBlacsRow_ &&
+            jb % numBlacsCols_ == myBlacsCol_) {
+          flops += flopsGemm<T>(tileRows(ib), that.tileCols(jb), tileCols(kb));
+        }
+      }
+    }
+  }
+  result.initLayout(productTiles);
+  RegionTimer timer("prod", flops);
+
+  std::vector<T> aPanel, bPanel;
+  std::vector<int64_t> aOffsets(numLocalTileRows_);
+  std::vector<int64_t> bOffsets(that.numLocalTileCols_);
+  for (int kb = 0; kb < numTileCols_; kb++) {
+    int k = tileCols(kb);
+
+    // nonzero tiles A(ib,kb) of the local tile rows, packed in aPanel
+    size_t aSize = 0;
+    for (int lib = 0; lib < numLocalTileRows_; lib++) {
+      int ib = lib * numBlacsRows_ + myBlacsRow_;
+      aOffsets[lib] = isNonzero(ib, kb) ? int64_t(aSize) : -1;
+      if (aOffsets[lib] != -1) aSize += size_t(tileRows(ib)) * k;
+    }
+    // nonzero tiles B(kb,jb) of the local tile columns, packed in bPanel
+    size_t bSize = 0;
+    for (int ljb = 0; ljb < that.numLocalTileCols_; ljb++) {
+      int jb = ljb * numBlacsCols_ + myBlacsCol_;
+      bOffsets[ljb] = that.isNonzero(kb, jb) ? int64_t(bSize) : -1;
+      if (bOffsets[ljb] != -1) bSize += size_t(k) * that.tileCols(jb);
+    }
+
+    // a panel is only needed if the other one has a nonzero tile somewhere:
+    // the decision must be the same on all the processes of the broadcast
+    bool anyA = false, anyB = false;
+    for (int ib = 0; ib < numTileRows_ && !anyA; ib++) {
+      anyA = isNonzero(ib, kb);
+    }
+    for (int jb = 0; jb < that.numTileCols_ && !anyB; jb++) {
+      anyB = that.isNonzero(kb, jb);
+    }
+    if (!anyA || !anyB) continue;
+
+    blacsInt aSource = kb % numBlacsCols_;
+    blacsInt bSource = kb % numBlacsRows_;
+    if (aSize > 0) {
+      aPanel.resize(aSize);
+      if (myBlacsCol_ == aSource) {
+        for (int lib = 0; lib < numLocalTileRows_; lib++) {
+          if (aOffsets[lib] == -1) continue;
+          int ib = lib * numBlacsRows_ + myBlacsRow_;
+          auto tile = mat.begin() + tileOffset(ib, kb);
+          std::copy(tile, tile + size_t(tileRows(ib)) * k,
+                    aPanel.begin() + aOffsets[lib]);
+        }
+      }
+      broadcastPanel(aPanel, "Row", aSource);
+    }
+    if (bSize > 0) {
+      bPanel.resize(bSize);
+      if (myBlacsRow_ == bSource) {
+        for (int ljb = 0; ljb < that.numLocalTileCols_; ljb++) {
+          if (bOffsets[ljb] == -1) continue;
+          int jb = ljb * numBlacsCols_ + myBlacsCol_;
+          auto tile = that.mat.begin() + that.tileOffset(kb, jb);
+          std::copy(tile, tile + size_t(k) * that.tileCols(jb),
+                    bPanel.begin() + bOffsets[ljb]);
+        }
+      }
+      that.broadcastPanel(bPanel, "Column", bSource);
+    }
+    if (aSize == 0 || bSize == 0) continue;
+
+    for (int ljb = 0; ljb < that.numLocalTileCols_; ljb++) {
+      if (bOffsets[ljb] == -1) continue;
+      int jb = ljb * numBlacsCols_ + myBlacsCol_;
+      Eigen::Map<const Matrix> b(bPanel.data() + bOffsets[ljb], k,
+                                 that.tileCols(jb));
+      for (int lib = 0; lib < numLocalTileRows_; lib++) {
+        if (aOffsets[lib] == -1) continue;
+        int ib = lib * numBlacsRows_ + myBlacsRow_;
+        Eigen::Map<const Matrix> a(aPanel.data() + aOffsets[lib],
+                                   tileRows(ib), k);
+        Eigen::Map<Matrix> c(result.mat.data() + result.tileOffset(ib, jb),
+                             tileRows(ib), that.tileCols(jb));
+        c.noalias() += a * b;
+      }
+    }
+  }
+  return result;
+}
+
+template <typename T>
+BlockSparseParallelMatrix<T>& BlockSparseParallelMatrix<T>::operator+=(
+    const BlockSparseParallelMatrix<T>& that) {
+  checkSameLayout(that);
+  addTiles(that.nonzeroTiles_);
+  for (size_t t = 0; t < that.tileOffsets_.size(); t++) {
+    if (that.tileOffsets_[t] == -1) continue;
+    int ib = int(t % numLocalTileRows_) * numBlacsRows_ + myBlacsRow_;
+    int jb = int(t / numLocalTileRows_) * numBlacsCols_ + myBlacsCol_;
+    size_t tileSize = size_t(tileRows(ib)) * tileCols(jb);
+    for (size_t i = 0; i < tileSize; i++) {
+      mat[tileOffsets_[t] + i] += that.mat[that.tileOffsets_[t] + i];
+    }
+  }
+  return *this;
+}
+
+template <typename T>
+BlockSparseParallelMatrix<T>& BlockSparseParallelMatrix<T>::operator-=(
+    const BlockSparseParallelMatrix<T>& that) {
+  checkSameLayout(that);
+  addTiles(that.nonzeroTiles_);
+  for (size_t t = 0; t < that.tileOffsets_.size(); t++) {
+    if (that.tileOffsets_[t] == -1) continue;
+    int ib = int(t % numLocalTileRows_) * numBlacsRows_ + myBlacsRow_;
+    int jb = int(t / numLocalTileRows_) * numBlacsCols_ + myBlacsCol_;
+    size_t tileSize = size_t(tileRows(ib)) * tileCols(jb);
+    for (size_t i = 0; i < tileSize; i++) {
+      mat[tileOffsets_[t] + i] -= that.mat[that.tileOffsets_[t] + i];
+    }
+  }
+  return *this;
+}
+
+template <typename T>
+BlockSparseParallelMatrix<T>& BlockSparseParallelMatrix<T>::operator*=(
+    const T& that) {
+  for (size_t i = 0; i < mat.size(); i++) {
+    mat[i] *= that;
+  }
+  return *this;
+}
+
+template <typename T>
+BlockSparseParallelMatrix<T>& BlockSparseParallelMatrix<T>::operator/=(
+    const T& that) {
+  for (size_t i = 0; i < mat.size(); i++) {
+    mat[i] /= that;
+  }
+  return *this;
+}
+
+template <typename T>
+T BlockSparseParallelMatrix<T>::dot(
+    const BlockSparseParallelMatrix<T>& that) const {
+  checkSameLayout(that);
+  T scalar = 0.;
+  for (size_t t = 0; t < tileOffsets_.size(); t++) {
+    if (tileOffsets_[t] == -1 || that.tileOffsets_[t] == -1) continue;
+    int ib = int(t % numLocalTileRows_) * numBlacsRows_ + myBlacsRow_;
+    int jb = int(t / numLocalTileRows_) * numBlacsCols_ + myBlacsCol_;
+    size_t tileSize = size_t(tileRows(ib)) * tileCols(jb);
+    for (size_t i = 0; i < tileSize; i++) {
+      scalar += mat[tileOffsets_[t] + i] * that.mat[that.tileOffsets_[t] + i];
+    }
+  }
+  T scalarOut = 0.;
+  mpi->allReduceSum(&scalar, &scalarOut);
+  return scalarOut;
+}
+
+template <typename T>
+T BlockSparseParallelMatrix<T>::squaredNorm() const {
+  return dot(*this);
+}
+
+template <typename T>
+T BlockSparseParallelMatrix<T>::norm() const {
+  return sqrt(squaredNorm());
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <functional>
+#include "PMatrix.h"
+
+/** Interface for a square linear operator A, known only through its action
+ * on a block of MPI-distributed vectors.
+ *
+ * Iterative eigensolvers only need the products Y = A X, with X a N x k
+ * ParallelMatrix holding one vector per column. The operator also decides
+ * how these blocks are distributed, through newBlock(), so that all the
+ * blocks a solver creates share one blacs context and can be multiplied
+ * together.
+ */
+template <typename T>
+class LinearOperator {
+ public:
+  virtual ~LinearOperator() = default;
+
+  /** Returns the global size N of the operator.
+   */
+  virtual int rows() const = 0;
+
+  /** Returns a zero N x numVectors block, in the layout that apply() takes.
+   */
+  virtual ParallelMatrix<T> newBlock(const int& numVectors) const = 0;
+
+  /** Returns Y = A X, for a block of vectors X made by newBlock().
+   */
+  virtual ParallelMatrix<T> apply(const ParallelMatrix<T>& x) const = 0;
+};
+
+/** A dense ParallelMatrix as a linear operator, applied with prod().
+ * The matrix is referenced, not copied, and must outlive the operator.
+ */
+template <typename T>
+class MatrixOperator : public LinearOperator<T> {
+ private:
+  ParallelMatrix<T>& matrix;
+
+ public:
+  explicit MatrixOperator(ParallelMatrix<T>& matrix_) : matrix(matrix_) {
+    if (matrix.rows() != matrix.cols()) {
+      Error("MatrixOperator needs a square matrix.");
+    }
+  }
+
+  int rows() const override { return matrix.rows(); }
+
+  ParallelMatrix<T> newBlock(const int& numVectors) const override {
+    return matrix.newBlock(numVectors);
+  }
+
+  ParallelMatrix<T> apply(const ParallelMatrix<T>& x) const override {
+    return matrix.prod(x);
+  }
+};
+
+/** A linear operator defined by a user function computing Y = A X, e.g.
+ * [&](const ParallelMatrix<double>& x) { return sparse.prod(x); } for a
+ * SparseParallelMatrix, or a matrix-free product.
+ *
+ * The blocks given to the function are N x k ParallelMatrices with
+ * numBlocksRows blocks of rows, all on one blacs context: the one passed
+ * here, or a new one if blacsContext = -1. The function must return a
+ * block of the same layout, e.g. made with x.newBlock(k).
+ */
+template <typename T>
+class CallbackOperator : public LinearOperator<T> {
+ public:
+  using Callback = std::function<ParallelMatrix<T>(const ParallelMatrix<T>&)>;
+
+ private:
+  Callback callback;
+  // a N x 1 block, that fixes the layout of all the others
+  ParallelMatrix<T> layout;
+
+ public:
+  CallbackOperator(const int& numRows, Callback callback_,
+                   const int& numBlocksRows = 0, const int& blacsContext = -1)
+      : callback(std::move(callback_)),
+        layout(numRows, 1, numBlocksRows, 0, blacsContext) {}
+
+  int rows() const override { return layout.rows(); }
+
+  ParallelMatrix<T> newBlock(const int& numVectors) const override {
+    return layout.newBlock(numVectors);
+  }
+
+  ParallelMatrix<T> apply(const ParallelMatrix<T>& x) const override {
+    return callback(x);
+  }
+};
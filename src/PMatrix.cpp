@@ -1,101 +1,82 @@
 #include "PMatrix.h"
 
+#include <cmath>
 #include "blacs.h"
 #include "mpi/mpiHelper.h"
+#include "profiler.h"
+#include "scalapackTraits.h"
 #include "utilities.h"
 
 #ifdef MPI_AVAIL
 
-template <>
-ParallelMatrix<double> ParallelMatrix<double>::prod(
-    const ParallelMatrix<double>& that, const char& trans1,
-    const char& trans2) {
-
-  if(cols() != that.rows()) {
-    Error("Cannot multiply matrices for which lhs.cols != rhs.rows.");
-  }
-  auto result = that;
-  result.zeros();
+// The scalapack operations are written once for all element types, and
+// call the routine of the right precision through scalapack<T>
+// (see scalapackTraits.h). They are instantiated at the end of the file.
+
+// Workspace size returned by a query (lwork = -1) in the first element of a
+// work array. In single precision it is a float, exact only up to 2^24, so
+// it is rounded up past the stored value.
+template <typename R>
+static blacsInt workspaceSize(const R& query) {
+  R above = std::nextafter(query, std::numeric_limits<R>::infinity());
+  return std::max(blacsInt(std::ceil(double(above))), blacsInt(1));
+}
 
-  int m;
-  if (trans1 == transN) {
-    m = numRows_;
-  } else {
-    m = numCols_;
-  }
-  int n;
-  if (trans2 == transN) {
-    n = that.numCols_;
-  } else {
-    n = that.numRows_;
-  }
-  int k;
-  if (trans1 == transN) {
-    k = numCols_;
-  } else {
-    k = numRows_;
-  }
-  // check on k being consistent
-  if (trans2 == transN) {
-    assert(k == that.numRows_);
-  } else {
-    assert(k == that.numCols_);
-  }
-  double alpha = 1.;
-  double beta = 0.;
-  int one = 1;
-  pdgemm_(&trans1, &trans2, &m, &n, &k, &alpha, mat, &one, &one, &descMat_[0],
-          that.mat, &one, &one, &that.descMat_[0], &beta, result.mat, &one,
-          &one, &result.descMat_[0]);
+template <typename T>
+ParallelMatrix<T> ParallelMatrix<T>::prod(const ParallelMatrix<T>& that,
+                                          const char& trans1,
+                                          const char& trans2) {
+  // the result has the blocking of the rows of trans1(this) and of the
+  // cols of trans2(that), and must share their blacs context
+  ParallelMatrix<T> result(
+      trans1 == transN ? numRows_ : numCols_,
+      trans2 == transN ? that.numCols_ : that.numRows_,
+      trans1 == transN ? numBlocksRows_ : numBlocksCols_,
+      trans2 == transN ? that.numBlocksCols_ : that.numBlocksRows_,
+      blacsContext_);
+  result.gemm(*this, that, trans1, trans2);
   return result;
 }
 
-template <>
-ParallelMatrix<std::complex<double>> ParallelMatrix<std::complex<double>>::prod(
-    const ParallelMatrix<std::complex<double>>& that, const char& trans1,
-    const char& trans2) {
-
-  ParallelMatrix<std::complex<double>> result(numRows_, numCols_,
-                                              numBlocksRows_, numBlocksCols_);
-  if(cols() != that.rows()) {
+template <typename T>
+void ParallelMatrix<T>::gemm(const ParallelMatrix<T>& a,
+                             const ParallelMatrix<T>& b, const char& trans1,
+                             const char& trans2, const T& alpha,
+                             const T& beta) {
+  blacsInt m = trans1 == transN ? a.numRows_ : a.numCols_;
+  blacsInt n = trans2 == transN ? b.numCols_ : b.numRows_;
+  blacsInt k = trans1 == transN ? a.numCols_ : a.numRows_;
+  // check on k being consistent
+  blacsInt kThat = trans2 == transN ? b.numRows_ : b.numCols_;
+  if (k != kThat) {
     Error("Cannot multiply matrices for which lhs.cols != rhs.rows.");
   }
-  int m;
-  if (trans1 == transN) {
-    m = numRows_;
-  } else {
-    m = numCols_;
+  if (m != numRows_ || n != numCols_) {
+    Error("gemm: the matrix doesn't have the size of the product");
   }
-  int n;
-  if (trans2 == transN) {
-    n = that.numCols_;
-  } else {
-    n = that.numRows_;
+  if (&a == this || &b == this) {
+    Error("gemm: the result cannot be one of the factors");
   }
-  int k;
-  if (trans1 == transN) {
-    k = numCols_;
-  } else {
-    k = numRows_;
+  if (a.blacsContext_ != blacsContext_ || b.blacsContext_ != blacsContext_) {
+    Error("gemm: the matrices must share one blacs context");
   }
-  // check on k being consistent
-  if (trans2 == transN) {
-    assert(k == that.numRows_);
-  } else {
-    assert(k == that.numCols_);
-  }
-  std::complex<double> alpha = {1., 0.};
-  std::complex<double> beta = {0., 0.};
-  int one = 1;
-  pzgemm_(&trans1, &trans2, &m, &n, &k, &alpha, mat, &one, &one, &descMat_[0],
-          that.mat, &one, &one, &that.descMat_[0], &beta, result.mat, &one,
-          &one, &result.descMat_[0]);
-  return result;
+  eigendecomposition_.reset();
+  T alpha_ = alpha;
+  T beta_ = beta;
+  blacsInt one = 1;
+  RegionTimer timer("prod", flopsGemm<T>(m, n, k) / mpi->getSize());
+  scalapack<T>::gemm(&trans1, &trans2, &m, &n, &k, &alpha_,
+                     const_cast<T*>(a.mat), &one, &one, &a.descMat_[0],
+                     const_cast<T*>(b.mat), &one, &one, &b.descMat_[0],
+                     &beta_, mat, &one, &one, &descMat_[0]);
 }
 
-template <>
-std::tuple<std::vector<double>, ParallelMatrix<double>>
-ParallelMatrix<double>::diagonalize() {
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+ParallelMatrix<T>::diagonalize() {
+  using R = typename scalapack<T>::real;
+  const std::string name = std::string(scalapack<T>::prefix)
+      + (isComplex<T>::value ? "HEEVD" : "SYEVD");
 
   if (numRows_ != numCols_) {
     Error("Cannot diagonalize non-square matrix");
@@ -104,61 +85,75 @@ ParallelMatrix<double>::diagonalize() {
     Error("Cannot diagonalize via scalapack with a non-square process grid!");
   }
 
-  double *eigenvalues;
+  R* eigenvalues;
   allocate(eigenvalues, numRows_);
 
-  // Make a new PMatrix to receive the output
-  // zeros here trigger a the default blacs process grid (a square one)
-  ParallelMatrix<double> eigenvectors(numRows_,numCols_,
-                              numBlocksRows_,numBlocksCols_, blacsContext_);
+  // scalapack overwrites the matrix
+  eigendecomposition_.reset();
+
+  // Make a new PMatrix to receive the output,
+  // which must share the blacs context of this matrix
+  ParallelMatrix<T> eigenvectors(numRows_, numCols_, numBlocksRows_,
+                                 numBlocksCols_, blacsContext_);
 
   char jobz = 'V';  // also eigenvectors
   char uplo = 'U';  // upper triangular
-  int ia = 1;       // row index from which we diagonalize
-  int ja = 1;       // row index from which we diagonalize
-
-  int info = 0;
-
-  // we will let pdseyv determine lwork for us. if we run it with
-  // lwork = -1 and work of length 1, it will fill work with
-  // an appropriate lwork number
-  double *work;
-  int lwork = -1;
-  allocate(work, 1);
-  // somehow autodetermination never works for liwork, so we compute this manually
-  // liwork ≥ 7n + 8npcol + 2
-  int liwork = 7*numRows_ + 8* numBlacsCols_ + 2;
-  int *iwork;
-  allocate(iwork, liwork);
-  // calculate lwork
-  pdsyevd_(&jobz, &uplo, &numRows_, mat, &ia, &ja, &descMat_[0], eigenvalues,
-          eigenvectors.mat, &ia, &ja, &eigenvectors.descMat_[0],
-          work, &lwork, iwork, &liwork, &info);
-
-  //size_t tempWork = int(work[0]);
-  // automatic detection finds the minimum needed,
-  // we actually pretty much always need way more than this!
-  //if(tempWork > 2147483640) { lwork = 2147483640; } // check for overflow
-  //else { lwork = tempWork; }
-
-  lwork = int(work[0]);
-  delete[] work;
-  try{ allocate(work, lwork); }
+  blacsInt ia = 1;  // row index from which we diagonalize
+  blacsInt ja = 1;  // row index from which we diagonalize
+  blacsInt info = 0;
+
+  // we let scalapack determine the workspaces for us: if we run it with
+  // lwork = lrwork = liwork = -1, it fills the first element of the work
+  // arrays with the size they need. rwork is only used by complex numbers.
+  blacsInt lwork = -1;
+  blacsInt lrwork = -1;
+  blacsInt liwork = -1;
+  T workQuery;
+  R rworkQuery = 0;
+  blacsInt iworkQuery = 0;
+  scalapack<T>::heevd(&jobz, &uplo, &numRows_, mat, &ia, &ja, &descMat_[0],
+                      eigenvalues, eigenvectors.mat, &ia, &ja,
+                      &eigenvectors.descMat_[0], &workQuery, &lwork,
+                      &rworkQuery, &lrwork, &iworkQuery, &liwork, &info);
+  lwork = workspaceSize(std::real(workQuery));
+  lrwork = workspaceSize(rworkQuery);
+  // somehow autodetermination doesn't always work for liwork,
+  // so we also check the documented minimum, liwork >= 7n + 8npcol + 2
+  liwork = std::max(iworkQuery, 7 * numRows_ + 8 * numBlacsCols_ + 2);
+
+  T* work = nullptr;
+  R* rwork = nullptr;
+  blacsInt* iwork = nullptr;
+  try {
+    allocate(work, lwork);
+    allocate(rwork, lrwork);
+    allocate(iwork, liwork);
+  }
   catch (std::bad_alloc& ba) {
-    Error("PDSYEVD lwork array allocation failed.");
+    Error(name + " work array allocation failed.");
   }
+  long workspaceBytes = lwork * sizeof(T) + lrwork * sizeof(R)
+      + liwork * sizeof(blacsInt);
+  trackMemory("eigensolver workspace", workspaceBytes);
 
   // call the function to now diagonalize
-  pdsyevd_(&jobz, &uplo, &numRows_, mat, &ia, &ja, &descMat_[0], eigenvalues,
-          eigenvectors.mat, &ia, &ja, &eigenvectors.descMat_[0],
-          work, &lwork, iwork, &liwork, &info);
+  {
+    double flops = isComplex<T>::value ? flopsHeevd(numRows_)
+                                       : flopsSyevd(numRows_);
+    RegionTimer timer("diagonalize", flops / mpi->getSize());
+    scalapack<T>::heevd(&jobz, &uplo, &numRows_, mat, &ia, &ja, &descMat_[0],
+                        eigenvalues, eigenvectors.mat, &ia, &ja,
+                        &eigenvectors.descMat_[0], work, &lwork, rwork,
+                        &lrwork, iwork, &liwork, &info);
+  }
 
   if(info != 0) {
-    if (mpi->mpiHead()) {
+    if (info < 0 && mpi->mpiHead()) {
       std::cout << "Developer Error: "
-                "One of the input params to PDSYEVD is wrong!" << std::endl;
+                "One of the input params to " << name << " is wrong!"
+                << std::endl;
     }
-    Error("PDSYEVD failed.", info);
+    Error(name + " failed.", info);
   }
 
   // copy things into output containers
@@ -168,73 +163,50 @@ ParallelMatrix<double>::diagonalize() {
   }
   delete[] eigenvalues;
   delete[] work;
+  delete[] rwork;
+  delete[] iwork;
+  trackMemory("eigensolver workspace", -workspaceBytes);
   // note that the scattering matrix now has different values
   return std::make_tuple(eigenvalues_, eigenvectors);
 }
 
-template <>
-std::tuple<std::vector<double>, ParallelMatrix<std::complex<double>>>
-ParallelMatrix<std::complex<double>>::diagonalize() {
+// function to only compute some eigenvectors/values
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+ParallelMatrix<T>::diagonalize(int numEigenvalues_,
+                               bool checkNegativeEigenvalues) {
+  (void) checkNegativeEigenvalues;
+  blacsInt numEigenvalues = std::min(numEigenvalues_, int(numRows_));
 
-  if (numRows_ != numCols_) {
-    Error("Can not diagonalize non-square matrix");
-  }
-  if ( numBlacsRows_ != numBlacsCols_ ) {
-    Error("Cannot diagonalize via scalapack with a non-square process grid!");
+  if(mpi->mpiHead()) mpi->time();
+  if(mpi->mpiHead()) {
+    std::cout << "Now computing first " << numEigenvalues <<
+        " eigenvalues and vectors of the scattering matrix." << std::endl;
   }
-  double* eigenvalues = nullptr;
-  eigenvalues = new double[numRows_];
-
-  // the two zeros here trigger the default square blacs process grid in initBlacs
-  ParallelMatrix<std::complex<double>> eigenvectors(
-      numRows_, numCols_, numBlocksRows_, numBlocksCols_);
-
-  // find the value of lwork and lrwork. These are internal "scratch" arrays
-  int NB = descMat_[5];
-  int aZero = 0;
-  int NN = std::max(std::max(numRows_, NB), 2);
-  int NP0 = numroc_(&NN, &NB, &aZero, &aZero, &numBlacsRows_);
-  int NQ0 = numroc_(&NN, &NB, &aZero, &aZero, &numBlacsCols_);
-  int lwork = (NP0 + NQ0 + NB) * NB + 3 * numRows_ + numRows_ * numRows_;
-  int lrwork = 2 * numRows_ + 2 * numRows_ - 2;
-
-  std::complex<double>* work = nullptr;
-  work = new std::complex<double>[lwork];
-  std::complex<double>* rwork = nullptr;
-  rwork = new std::complex<double>[lrwork];
-
-  char jobz = 'V';  // also eigenvectors
-  char uplo = 'U';  // upper triangular
-  int ia = 1;       // row index from which we diagonalize
-  int ja = 1;       // row index from which we diagonalize
-  int info = 0;
-  pzheev_(&jobz, &uplo, &numRows_, mat, &ia, &ja, &descMat_[0], eigenvalues,
-          eigenvectors.mat, &ia, &ja, &eigenvectors.descMat_[0], work, &lwork,
-          rwork, &lrwork, &info);
+  // compute a range (from smallest to largest) of the eigenvalues
+  auto result = diagonalizeSubset('I', -1., 0., 1, numEigenvalues);
+  if(mpi->mpiHead()) mpi->time();
+  return result;
+}
 
-  if (info != 0) {
-    Error("PZHEEV failed", info);
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+ParallelMatrix<T>::diagonalizeRange(const double& lowerBound,
+                                    const double& upperBound) {
+  if (lowerBound >= upperBound) {
+    Error("diagonalizeRange needs lowerBound < upperBound");
   }
-
-  std::vector<double> eigenvalues_(numRows_);
-  for (int i = 0; i < numRows_; i++) {
-    eigenvalues_[i] = *(eigenvalues + i);
-  }
-  delete[] eigenvalues;
-  delete[] work;
-  delete[] rwork;
-
-  // note that the scattering matrix now has different values
-  return std::make_tuple(eigenvalues_, eigenvectors);
+  return diagonalizeSubset('V', lowerBound, upperBound, 1, 1);
 }
 
-// function to only compute some eigenvectors/values
-template <>
-std::tuple<std::vector<double>, ParallelMatrix<double>>
-                ParallelMatrix<double>::diagonalize(int numEigenvalues_,
-                                                    bool checkNegativeEigenvalues) {
-
-  int numEigenvalues = numEigenvalues_;
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+ParallelMatrix<T>::diagonalizeSubset(const char& range_, const double& vl_,
+                                     const double& vu_, const blacsInt& il_,
+                                     const blacsInt& iu_) {
+  using R = typename scalapack<T>::real;
+  const std::string name = std::string(scalapack<T>::prefix)
+      + (isComplex<T>::value ? "HEEVR" : "SYEVR");
 
   if (numRows_ != numCols_) {
     Error("Cannot diagonalize non-square matrix");
@@ -242,12 +214,9 @@ std::tuple<std::vector<double>, ParallelMatrix<double>>
   if ( numBlacsRows_ != numBlacsCols_ ) {
     Error("Cannot diagonalize via scalapack with a non-square process grid!");
   }
-  if ( numRows_ < numEigenvalues) {
-    numEigenvalues = numRows_;
-  }
 
   // eigenvalue return container
-  double *eigenvalues;
+  R* eigenvalues;
   allocate(eigenvalues, numRows_);
 
   // NOTE even though we only need numEigenvalues + numEigenvalues worth of z matrix,
@@ -255,116 +224,730 @@ std::tuple<std::vector<double>, ParallelMatrix<double>>
   // It's a huge waste of memory, and we should check to see if another code
   // can get around this.
   // Make a new PMatrix to receive the output
-  ParallelMatrix<double> eigenvectors(numRows_, numCols_,
-                        numBlocksRows_,numBlocksCols_, blacsContext_);
+  ParallelMatrix<T> eigenvectors(numRows_, numCols_, numBlocksRows_,
+                                 numBlocksCols_, blacsContext_);
+  eigendecomposition_.reset();  // scalapack overwrites the matrix
 
   char jobz = 'V';  // also eigenvectors
   char uplo = 'U';  // upper triangular
-  int ia = 1;       // row index of start of A
-  int ja = 1;       // col index of start of A
-  int iz = 1;       // row index of start of Z
-  int jz = 1;       // row index of start of Z
-
-  int info = 0;     // error code on return
-  int m = 0;        // filled on return with number of eigenvalues found
-  int nz = 0;       // filled on return with number of eigenvectors found
-
-  char range = 'I'; // compute a range (from smallest to largest) of the eigenvalues
-  int il = 1;       // lower eigenvalue index (indexed from 1)
-  int iu = numEigenvalues;              // higher eigenvalue index (indexed from 1)
-  double vl = -1;                 // not used unless range = V
-  double vu = 0;                  // not used unless range = V
-
-  // we will let pdseyv determine lwork for us. if we run it with
-  // lwork = -1 and work of length 1, it will fill work with
-  // an appropriate lwork number
-  double *work;
-  int *iwork;
-  int lwork = -1;
-  int liwork = -1; // liwork seems not to be determined this way
-  allocate(work, 1);
-  allocate(iwork, 1);
-
-  pdsyevr_(&jobz, &range, &uplo,  &numRows_, mat, &ia, &ja, &descMat_[0],
-        &vl, &vu, &il, &iu, &m, &nz, eigenvalues,
-        eigenvectors.mat, &iz, &jz, &eigenvectors.descMat_[0],
-        work, &lwork, iwork, &liwork, &info);
-
-  lwork=int(work[0]);
-  delete[] work;
-  delete[] iwork;
-  allocate(work, lwork);
-
+  blacsInt ia = 1;  // row index of start of A
+  blacsInt ja = 1;  // col index of start of A
+  blacsInt iz = 1;  // row index of start of Z
+  blacsInt jz = 1;  // row index of start of Z
+
+  blacsInt info = 0;  // error code on return
+  blacsInt m = 0;     // filled on return with number of eigenvalues found
+  blacsInt nz = 0;    // filled on return with number of eigenvectors found
+
+  char range = range_;  // 'I': eigenvalues il to iu, 'V': in (vl, vu]
+  blacsInt il = il_;    // lower eigenvalue index (indexed from 1)
+  blacsInt iu = iu_;    // higher eigenvalue index (indexed from 1)
+  R vl = R(vl_);        // not used unless range = V
+  R vu = R(vu_);        // not used unless range = V
+
+  // workspace query, as in diagonalize()
+  blacsInt lwork = -1;
+  blacsInt lrwork = -1;
+  blacsInt liwork = -1;
+  T workQuery;
+  R rworkQuery = 0;
+  blacsInt iworkQuery = 0;
+  scalapack<T>::heevr(&jobz, &range, &uplo, &numRows_, mat, &ia, &ja,
+                      &descMat_[0], &vl, &vu, &il, &iu, &m, &nz, eigenvalues,
+                      eigenvectors.mat, &iz, &jz, &eigenvectors.descMat_[0],
+                      &workQuery, &lwork, &rworkQuery, &lrwork, &iworkQuery,
+                      &liwork, &info);
+  lwork = workspaceSize(std::real(workQuery));
+  lrwork = workspaceSize(rworkQuery);
   // for some reason scalapack won't fill liwork automatically:
   //Let nnp = max( n, nprow*npcol + 1, 4 ). Then:
   //liwork≥ 12*nnp + 2*n when the eigenvectors are desired
-  int nnp = std::max(std::max(numRows_, numBlacsRows_*numBlacsCols_ + 1), 4);
-  liwork = 12*nnp + 2*numRows_;
-  allocate(iwork, liwork);
-
-  // now we perform the regular call to get the largest ones ---------------------
-  if(mpi->mpiHead()) mpi->time();
-  if(mpi->mpiHead()) {
-    std::cout << "Now computing first " << numEigenvalues <<
-        " eigenvalues and vectors of the scattering matrix." << std::endl;
+  blacsInt nnp = std::max(std::max(numRows_, numBlacsRows_*numBlacsCols_ + 1),
+                          blacsInt(4));
+  liwork = std::max(iworkQuery, 12*nnp + 2*numRows_);
+
+  T* work = nullptr;
+  R* rwork = nullptr;
+  blacsInt* iwork = nullptr;
+  try {
+    allocate(work, lwork);
+    allocate(rwork, lrwork);
+    allocate(iwork, liwork);
   }
-
-  range = 'I';
-  jobz = 'V';
-  eigenvectors.zeros();
+  catch (std::bad_alloc& ba) {
+    Error(name + " work array allocation failed.");
+  }
+  long workspaceBytes = lwork * sizeof(T) + lrwork * sizeof(R)
+      + liwork * sizeof(blacsInt);
+  trackMemory("eigensolver workspace", workspaceBytes);
 
   // We could make sure these two matrices have identical blacsContexts.
   // However, as dim(Z) must = dim(A), we can just pass A's desc twice.
-  pdsyevr_(&jobz, &range, &uplo,  &numRows_, mat, &ia, &ja, &descMat_[0],
-        &vl, &vu, &il, &iu, &m, &nz, eigenvalues,
-        eigenvectors.mat, &iz, &jz, &eigenvectors.descMat_[0],
-        work, &lwork, iwork, &liwork, &info);
+  {
+    // the complex reduction and back transformation cost four times more.
+    // For a range of values, the count is only known afterwards: the model
+    // assumes all of them.
+    double flops = flopsSyevr(numRows_, range == 'I' ? iu - il + 1 : numRows_);
+    if (isComplex<T>::value) flops *= 4.;
+    RegionTimer timer("diagonalize partial", flops / mpi->getSize());
+    scalapack<T>::heevr(&jobz, &range, &uplo, &numRows_, mat, &ia, &ja,
+                        &descMat_[0], &vl, &vu, &il, &iu, &m, &nz, eigenvalues,
+                        eigenvectors.mat, &iz, &jz, &eigenvectors.descMat_[0],
+                        work, &lwork, rwork, &lrwork, iwork, &liwork, &info);
+  }
 
   if(info != 0) {
-    if (mpi->mpiHead()) {
+    if (info < 0 && mpi->mpiHead()) {
       std::cout << "Developer Error: "
-                "One of the input params to PDSYEVR is wrong!" << std::endl;
+                "One of the input params to " << name << " is wrong!"
+                << std::endl;
     }
-    Error("PDSYEVR failed.", info);
+    Error(name + " failed.", info);
   }
-  if(mpi->mpiHead()) mpi->time();
-
 
   // copy to return containers and free the no longer used containers.
-  std::vector<double> eigenvalues_(numEigenvalues);
-  for (int i = 0; i < numEigenvalues; i++) {
+  std::vector<double> eigenvalues_(m);
+  for (int i = 0; i < m; i++) {
     eigenvalues_[i] = *(eigenvalues + i);
   }
   delete[] eigenvalues;
-  delete[] work; delete[] iwork;
+  delete[] work; delete[] rwork; delete[] iwork;
+  trackMemory("eigensolver workspace", -workspaceBytes);
 
   // note that the scattering matrix now has different values
   // it's going to be the upper triangle and diagonal of A
   return std::make_tuple(eigenvalues_, eigenvectors);
 }
 
-// executes A + AT/2
-template <>
-void ParallelMatrix<double>::symmetrize() {
+// Spectrum slicing ------------------------------------------------------------
+
+// Number of eigenvalues below sigma of the real symmetric tridiagonal matrix
+// with diagonal d and off-diagonal e: by Sylvester's law of inertia, the
+// number of negative pivots of the LDL^T factorization of T - sigma.
+static int countEigenvaluesBelow(const std::vector<double>& d,
+                                 const std::vector<double>& e,
+                                 const double& sigma, const double& pivmin) {
+  int count = 0;
+  double pivot = 1.;
+  for (size_t i = 0; i < d.size(); i++) {
+    pivot = d[i] - sigma - (i > 0 ? e[i - 1] * e[i - 1] / pivot : 0.);
+    // as in LAPACK's dstebz, tiny pivots are replaced by -pivmin
+    if (std::abs(pivot) < pivmin) pivot = -pivmin;
+    if (pivot < 0.) count++;
+  }
+  return count;
+}
+
+// Eigenvalue k (from 0, ascending) of the tridiagonal matrix, by bisection of
+// the eigenvalue count within [lower, upper]
+static double tridiagonalEigenvalue(const std::vector<double>& d,
+                                    const std::vector<double>& e,
+                                    const int& k, double lower, double upper,
+                                    const double& pivmin) {
+  for (int iter = 0; iter < 200; iter++) {
+    double mid = 0.5 * (lower + upper);
+    if (mid <= lower || mid >= upper) break;
+    if (countEigenvaluesBelow(d, e, mid, pivmin) > k) {
+      upper = mid;
+    } else {
+      lower = mid;
+    }
+  }
+  return 0.5 * (lower + upper);
+}
 
-  // it seems scalapack will make us copy the matrix into a new one
-  ParallelMatrix<double> AT = *(this);
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+ParallelMatrix<T>::diagonalizeSlices() {
+  using R = typename scalapack<T>::real;
+
+  if (numRows_ != numCols_) {
+    Error("Cannot diagonalize non-square matrix");
+  }
+  int poolSize = mpi->getSize(mpi->intraPoolComm);
+  int numPools = mpi->getSize() / poolSize;
+  if (!mpi->hasPools() || numPools == 1) {
+    ParallelMatrix<T> copy = *this;
+    return copy.diagonalize();
+  }
+  blacsInt numPoolRows = blacsInt(std::sqrt(double(poolSize)) + 0.5);
+  if (numPoolRows * numPoolRows != poolSize) {
+    Error("Spectrum slicing needs a square number of processes per pool");
+  }
+  int myPool = mpi->getRank() / poolSize;
+  RegionTimer timer("diagonalize slices");
+
+  // a square blacs grid for each pool, of its MPI processes. The grids are
+  // made by all processes, and blacs returns -1 to those outside of them.
+  blacsInt poolContext = -1;
+  for (int p = 0; p < numPools; p++) {
+    std::vector<blacsInt> poolRanks(poolSize);
+    for (int r = 0; r < poolSize; r++) poolRanks[r] = p * poolSize + r;
+    blacsInt context;
+    blacsInt iZero = 0;
+    blacs_get_(&iZero, &iZero, &context);
+    blacs_gridmap_(&context, &poolRanks[0], &numPoolRows, &numPoolRows,
+                   &numPoolRows);
+    if (p == myPool) poolContext = context;
+  }
+  // descriptor of the matrices of the pools a process is not part of
+  blacsInt outsideDesc[9] = {1, -1, 0, 0, 1, 1, 0, 0, 1};
+  blacsInt one = 1;
+
+  // all processes reduce a copy of the matrix to tridiagonal form T, on the
+  // grid of the matrix, and the diagonal and first superdiagonal of T are
+  // then known by all of them
+  std::vector<double> d(numRows_, 0.), e(std::max(int(numRows_) - 1, 0), 0.);
+  {
+    ParallelMatrix<T> tridiagonal = *this;
+    std::vector<R> dLocal(tridiagonal.numLocalCols_ + 1);
+    std::vector<R> eLocal(tridiagonal.numLocalCols_ + 1);
+    std::vector<T> tau(tridiagonal.numLocalCols_ + 1);
+    char uplo = 'U';
+    blacsInt lwork = -1;
+    blacsInt info = 0;
+    T workQuery;
+    scalapack<T>::hetrd(&uplo, &numRows_, tridiagonal.mat, &one, &one,
+                        &tridiagonal.descMat_[0], &dLocal[0], &eLocal[0],
+                        &tau[0], &workQuery, &lwork, &info);
+    lwork = workspaceSize(std::real(workQuery));
+    std::vector<T> work(lwork);
+    {
+      RegionTimer hetrdTimer("tridiagonalize",
+                             (isComplex<T>::value ? 16. : 4.) / 3.
+                             * std::pow(double(numRows_), 3) / mpi->getSize());
+      scalapack<T>::hetrd(&uplo, &numRows_, tridiagonal.mat, &one, &one,
+                          &tridiagonal.descMat_[0], &dLocal[0], &eLocal[0],
+                          &tau[0], &work[0], &lwork, &info);
+    }
+    if (info != 0) Error("Tridiagonal reduction failed", info);
+    // T overwrites the diagonal and superdiagonal of the matrix; every
+    // element is owned by exactly one process
+    tridiagonal.forEachLocalDiagonal([&](const int64_t& k, const int& i) {
+      d[i] = std::real(tridiagonal.mat[k]);
+    });
+    for (int64_t k = 0; k < int64_t(tridiagonal.numLocalElements_); k++) {
+      auto [i, j] = tridiagonal.local2Global(k);
+      if (j == i + 1) e[i] = std::abs(*(tridiagonal.mat + k));
+    }
+  }
+  mpi->allReduceSum(&d);
+  mpi->allReduceSum(&e);
+
+  std::vector<double> eigenvalues(numRows_, 0.);
+  ParallelMatrix<T> eigenvectors(numRows_, numCols_, numBlocksRows_,
+                                 numBlocksCols_, blacsContext_);
+  {
+    // every pool gets a copy of the matrix, with the same blocks
+    ParallelMatrix<T> poolMatrix(numRows_, numCols_, numBlocksRows_,
+                                 numBlocksCols_, poolContext);
+    for (int p = 0; p < numPools; p++) {
+      scalapack<T>::gemr2d(&numRows_, &numCols_, mat, &one, &one,
+                           &descMat_[0], poolMatrix.mat, &one, &one,
+                           p == myPool ? &poolMatrix.descMat_[0] : outsideDesc,
+                           &blacsContext_);
+    }
+
+    // windows with equal numbers of eigenvalues, separated by the midpoints
+    // of the gaps between consecutive eigenvalues of T. Gershgorin bounds
+    // enclose the spectrum.
+    double lower = 0., upper = 0., maxE2 = 1.;
+    for (int i = 0; i < numRows_; i++) {
+      double radius = (i > 0 ? e[i - 1] : 0.) + (i < numRows_ - 1 ? e[i] : 0.);
+      lower = i == 0 ? d[i] - radius : std::min(lower, d[i] - radius);
+      upper = i == 0 ? d[i] + radius : std::max(upper, d[i] + radius);
+      if (i < numRows_ - 1) maxE2 = std::max(maxE2, e[i] * e[i]);
+    }
+    double pivmin = std::numeric_limits<double>::min() * maxE2;
+    double margin = 1e-3 * (upper - lower) + std::abs(upper) * 1e-12 + pivmin;
+    lower -= margin;
+    upper += margin;
+    double minGap = 1e3 * std::numeric_limits<R>::epsilon()
+        * std::max(std::abs(lower), std::abs(upper));
+    std::vector<double> bounds(numPools + 1);
+    bounds[0] = lower;
+    bounds[numPools] = upper;
+    for (int p = 1; p < numPools; p++) {
+      // the boundary is moved off clusters, which a window must contain
+      // whole; if there is no gap nearby, the window is left empty
+      int target = int((int64_t(numRows_) * p) / numPools);
+      bounds[p] = bounds[p - 1];
+      for (int shift = 0; shift < 64; shift++) {
+        int k = target + (shift % 2 == 0 ? -1 : 1) * ((shift + 1) / 2);
+        if (k < 1 || k >= numRows_) continue;
+        double gapLower = tridiagonalEigenvalue(d, e, k - 1, lower, upper,
+                                                pivmin);
+        double gapUpper = tridiagonalEigenvalue(d, e, k, lower, upper, pivmin);
+        if (gapUpper - gapLower > minGap) {
+          bounds[p] = std::max(0.5 * (gapLower + gapUpper), bounds[p - 1]);
+          break;
+        }
+      }
+    }
+
+    // each pool computes the eigenpairs of its window
+    std::vector<double> poolEigenvalues;
+    ParallelMatrix<T> poolEigenvectors;
+    if (bounds[myPool + 1] > bounds[myPool]) {
+      std::tie(poolEigenvalues, poolEigenvectors) =
+          poolMatrix.diagonalizeRange(bounds[myPool], bounds[myPool + 1]);
+    }
+
+    // and the results are assembled, ordered by pool
+    std::vector<int> counts(numPools, 0);
+    if (mpi->getRank(mpi->intraPoolComm) == 0) {
+      counts[myPool] = int(poolEigenvalues.size());
+    }
+    mpi->allReduceSum(&counts);
+    std::vector<int> offsets(numPools + 1, 0);
+    for (int p = 0; p < numPools; p++) offsets[p + 1] = offsets[p] + counts[p];
+    if (offsets[numPools] != numRows_) {
+      Error("Spectrum slicing found " + std::to_string(offsets[numPools])
+            + " eigenvalues instead of " + std::to_string(numRows_));
+    }
+    if (mpi->getRank(mpi->intraPoolComm) == 0) {
+      for (int i = 0; i < counts[myPool]; i++) {
+        eigenvalues[offsets[myPool] + i] = poolEigenvalues[i];
+      }
+    }
+    mpi->allReduceSum(&eigenvalues);
+    for (int p = 0; p < numPools; p++) {
+      if (counts[p] == 0) continue;
+      blacsInt numCols = counts[p];
+      blacsInt jb = offsets[p] + 1;
+      scalapack<T>::gemr2d(&numRows_, &numCols, poolEigenvectors.mat, &one,
+                           &one,
+                           p == myPool ? &poolEigenvectors.descMat_[0]
+                                       : outsideDesc,
+                           eigenvectors.mat, &one, &jb,
+                           &eigenvectors.descMat_[0], &blacsContext_);
+    }
+  }
+  blacs_gridexit_(&poolContext);
+  return std::make_tuple(eigenvalues, eigenvectors);
+}
+
+// executes (A + A^T)/2, or (A + A^H)/2 for complex numbers
+template <typename T>
+void ParallelMatrix<T>::symmetrize() {
 
   if (numRows_ != numCols_) {
     Error("Cannot currently symmetrize a non-square matrix.");
   }
 
-  int ia = 1;       // row index of start of A
-  int ja = 1;       // col index of start of A
-  int ic = 1;       // row index of start of C
-  int jc = 1;       // row index of start of C
-  double scale = 0.5; // 0.5 factors are for the 1/2 used in the sym (A + AT)/2.
+  // it seems scalapack will make us copy the matrix into a new one
+  ParallelMatrix<T> AT = *(this);
+  eigendecomposition_.reset();
+
+  blacsInt ia = 1;  // row index of start of A
+  blacsInt ja = 1;  // col index of start of A
+  blacsInt ic = 1;  // row index of start of C
+  blacsInt jc = 1;  // row index of start of C
+  T scale = 0.5; // 0.5 factors are for the 1/2 used in the sym (A + AT)/2.
 
   // C here is the current matrix object stored by this class -- it will be overwritten,
   // and the copy above will go out of scope.
   //      C = beta*C + alpha*( A )^T
-  pdtran_(&numRows_, &numRows_, &scale, AT.mat, &ia, &ja, &descMat_[0], &scale, mat, &ic, &jc, &descMat_[0]);
+  scalapack<T>::tran(&numRows_, &numRows_, &scale, AT.mat, &ia, &ja,
+                     &descMat_[0], &scale, mat, &ic, &jc, &descMat_[0]);
+}
+
+template <typename T>
+ParallelMatrix<T> ParallelMatrix<T>::applyFunction(
+    const std::function<double(double)>& f, const bool& keepDecomposition) {
+  using R = typename scalapack<T>::real;
+  using Decomposition = std::tuple<std::vector<double>, ParallelMatrix<T>>;
+  if (numRows_ != numCols_) {
+    Error("Cannot apply a function to a non-square matrix");
+  }
+  std::shared_ptr<const Decomposition> kept = eigendecomposition_;
+  std::unique_ptr<Decomposition> local;
+  if (kept == nullptr) {
+    // diagonalize() overwrites the matrix it is called on
+    ParallelMatrix<T> copy = *this;
+    local.reset(new Decomposition(copy.diagonalize()));
+    if (keepDecomposition) {
+      kept = std::move(local);
+      eigendecomposition_ = kept;
+    }
+  }
+  const auto& [eigenvalues, eigenvectors] = kept != nullptr ? *kept : *local;
+
+  std::vector<double> values(numRows_);
+  bool isPositive = true;
+  for (int i = 0; i < numRows_; i++) {
+    values[i] = f(eigenvalues[i]);
+    if (!std::isfinite(values[i])) {
+      Error("applyFunction: f is not finite at the eigenvalue "
+            + std::to_string(eigenvalues[i]));
+    }
+    isPositive = isPositive && values[i] >= 0.;
+  }
+
+  // V f(Lambda), scaling the columns of V in place, unless V is kept or,
+  // with p?gemm, still needed
+  bool inPlace = isPositive && local != nullptr;
+  std::unique_ptr<ParallelMatrix<T>> copyOfV;
+  if (!inPlace) copyOfV = std::make_unique<ParallelMatrix<T>>(eigenvectors);
+  ParallelMatrix<T>& scaled = inPlace ? std::get<1>(*local) : *copyOfV;
+  std::vector<T> factors(numCols_);
+  for (int j = 0; j < numCols_; j++) {
+    factors[j] = T(isPositive ? std::sqrt(values[j]) : values[j]);
+  }
+  scaled.scaleCols(factors);
+
+  if (!isPositive) {
+    return scaled.prod(eigenvectors, transN, transC);
+  }
+
+  // f(A) = W W^H, with W = V f(Lambda)^1/2: the rank-k update only computes
+  // the upper triangle, at half the cost of a product
+  ParallelMatrix<T> result(numRows_, numCols_, numBlocksRows_, numBlocksCols_,
+                           blacsContext_);
+  {
+    char uplo = 'U';
+    char trans = transN;
+    R alpha = 1.;
+    R beta = 0.;
+    blacsInt one = 1;
+    RegionTimer timer("syrk",
+                      flopsGemm<T>(numRows_, numRows_, numRows_) / 2.
+                          / mpi->getSize());
+    scalapack<T>::syrk(&uplo, &trans, &numRows_, &numRows_, &alpha,
+                       scaled.mat, &one, &one, &scaled.descMat_[0], &beta,
+                       result.mat, &one, &one, &result.descMat_[0]);
+  }
+  // the lower triangle is still zero: halving the diagonal, the matrix plus
+  // its adjoint is the whole f(A). W is no longer needed, and its buffer
+  // receives the adjoint.
+  result.forEachLocalDiagonal(
+      [&](const int64_t& k, const int&) { result.mat[k] *= 0.5; });
+  blacsInt one = 1;
+  T alpha = 1.;
+  T beta = 0.;
+  scalapack<T>::tran(&numRows_, &numRows_, &alpha, result.mat, &one, &one,
+                     &result.descMat_[0], &beta, scaled.mat, &one, &one,
+                     &scaled.descMat_[0]);
+  result += scaled;
+  return result;
+}
+
+template <typename T>
+std::vector<double> ParallelMatrix<T>::columnSumsAndDiagonal() const {
+  std::vector<double> sums(2 * size_t(numCols_), 0.);
+  for (size_t k = 0; k < numLocalElements_; k++) {
+    auto [i, j] = local2Global(int64_t(k));
+    sums[j] += std::abs(mat[k]);
+    if (i == j) sums[numCols_ + j] = std::real(mat[k]);
+  }
+  mpi->allReduceSum(&sums);
+  return sums;
+}
+
+template <typename T>
+ParallelMatrix<T> ParallelMatrix<T>::expm(const double& tolerance_,
+                                          int* numProducts) {
+  using R = typename scalapack<T>::real;
+  if (numRows_ != numCols_) {
+    Error("Cannot exponentiate a non-square matrix");
+  }
+  double tolerance = tolerance_ > 0.
+      ? tolerance_ : double(std::numeric_limits<R>::epsilon());
+
+  // scaling: |A / 2^s|_1 <= 1/2
+  std::vector<double> sums = columnSumsAndDiagonal();
+  double norm = *std::max_element(sums.begin(), sums.begin() + numCols_);
+  if (!std::isfinite(norm)) {
+    Error("expm: the matrix has non-finite elements");
+  }
+  int s = norm > 0.5 ? int(std::ceil(std::log2(norm / 0.5))) : 0;
+
+  // degree: 2^(3-2q) (q!)^2 / ((2q)! (2q+1)!) <= tolerance
+  int q = 1;
+  auto errorBound = [](const int& q) {
+    double bound = std::pow(2., 3 - 2 * q);
+    for (int k = 1; k <= q; k++) bound *= double(k) * double(k);
+    for (int k = 1; k <= 2 * q; k++) bound /= double(k) * double(k);
+    return bound / double(2 * q + 1);
+  };
+  while (q < 13 && errorBound(q) > tolerance) q++;
+
+  // N = sum_k c_k X^k and D = sum_k (-1)^k c_k X^k, with X = A / 2^s and
+  // c_k = c_k-1 (q - k + 1) / (k (2q - k + 1)). The powers of X alternate
+  // between two workspaces.
+  ParallelMatrix<T> x = *this;
+  x *= T(std::ldexp(1., -s));
+  ParallelMatrix<T> numerator(numRows_, numCols_, numBlocksRows_,
+                              numBlocksCols_, blacsContext_);
+  numerator.eye();
+  ParallelMatrix<T> denominator = numerator;
+  ParallelMatrix<T> power[2] = {x, x};
+  double c = 1.;
+  for (int k = 1; k <= q; k++) {
+    c *= double(q - k + 1) / (double(k) * double(2 * q - k + 1));
+    if (k > 1) power[k % 2].gemm(x, power[(k - 1) % 2]);
+    const T* xk = power[k % 2].mat;
+    T cn = T(c);
+    T cd = T(k % 2 == 0 ? c : -c);
+    for (size_t i = 0; i < numLocalElements_; i++) {
+      numerator.mat[i] += cn * xk[i];
+      denominator.mat[i] += cd * xk[i];
+    }
+  }
+
+  // exp(X) ~ D^-1 N, then exp(A) = exp(X)^(2^s), squaring between the
+  // two workspaces
+  power[0] = denominator.solve(numerator);
+  for (int i = 0; i < s; i++) {
+    power[(i + 1) % 2].gemm(power[i % 2], power[i % 2]);
+  }
+  if (numProducts != nullptr) *numProducts = q - 1 + s;
+  return power[s % 2];
+}
+
+template <typename T>
+ParallelMatrix<T> ParallelMatrix<T>::chebyshevFunction(
+    const std::function<double(double)>& f, const double& tolerance_,
+    const double& lowerBound, const double& upperBound, int* degree) {
+  using R = typename scalapack<T>::real;
+  if (numRows_ != numCols_) {
+    Error("Cannot apply a function to a non-square matrix");
+  }
+  double tolerance = tolerance_ > 0.
+      ? tolerance_ : 10. * double(std::numeric_limits<R>::epsilon());
+
+  double lower = lowerBound;
+  double upper = upperBound;
+  if (lower >= upper) {
+    // Gershgorin discs: centers a_jj, radii sum_i!=j |a_ij| (A is hermitian)
+    std::vector<double> sums = columnSumsAndDiagonal();
+    lower = std::numeric_limits<double>::max();
+    upper = -lower;
+    for (int j = 0; j < numCols_; j++) {
+      double center = sums[numCols_ + j];
+      double radius = sums[j] - std::abs(center);
+      lower = std::min(lower, center - radius);
+      upper = std::max(upper, center + radius);
+    }
+  }
+  double center = (lower + upper) / 2.;
+  double halfWidth = (upper - lower) / 2.;
+
+  ParallelMatrix<T> result(numRows_, numCols_, numBlocksRows_,
+                           numBlocksCols_, blacsContext_);
+  result.eye();
+  if (halfWidth <= 0.) {  // A is a multiple of the identity
+    result *= T(f(center));
+    if (degree != nullptr) *degree = 0;
+    return result;
+  }
 
+  // coefficients of f(center + halfWidth x) on n Chebyshev nodes, with n
+  // doubled until the last quarter of them is below the tolerance
+  const double pi = 3.14159265358979323846;
+  const int maxDegree = 1024;
+  std::vector<double> c;
+  double scale = 0.;
+  double tail = 0.;
+  bool converged = false;
+  for (int n = 16; n <= maxDegree; n *= 2) {
+    std::vector<double> values(n);
+    for (int j = 0; j < n; j++) {
+      values[j] = f(center + halfWidth * std::cos(pi * (j + 0.5) / n));
+      if (!std::isfinite(values[j])) {
+        Error("chebyshevFunction: f is not finite on the spectrum");
+      }
+    }
+    c.assign(n, 0.);
+    for (int k = 0; k < n; k++) {
+      for (int j = 0; j < n; j++) {
+        c[k] += values[j] * std::cos(pi * k * (j + 0.5) / n);
+      }
+      c[k] *= 2. / n;
+    }
+    c[0] /= 2.;
+    scale = 0.;
+    for (int k = 0; k < n; k++) scale = std::max(scale, std::abs(c[k]));
+    // coefficients at the level of the rounding errors of the sums are zero
+    double noise = n * std::numeric_limits<double>::epsilon() * scale;
+    for (int k = 0; k < n; k++) {
+      if (std::abs(c[k]) <= noise) c[k] = 0.;
+    }
+    tail = 0.;
+    for (int k = 3 * n / 4; k < n; k++) tail += std::abs(c[k]);
+    if (tail <= tolerance * scale) {
+      converged = true;
+      break;
+    }
+  }
+  if (!converged && mpi->mpiHead()) {
+    std::cout << "Warning: chebyshevFunction didn't converge at degree "
+              << maxDegree << ", relative accuracy " << tail / scale
+              << " instead of " << tolerance << ".\n";
+  }
+  // truncation, dropping the last coefficients up to the tolerance
+  int m = int(c.size()) - 1;
+  double dropped = std::abs(c[m]);
+  while (m > 0 && dropped <= tolerance * scale) {
+    m--;
+    dropped += std::abs(c[m]);
+  }
+  if (degree != nullptr) *degree = m;
+
+  // X = (A - center) / halfWidth, with its spectrum in [-1, 1]
+  ParallelMatrix<T> x = *this;
+  x.addToDiagonal(T(-center));
+  x /= T(halfWidth);
+
+  // T_0 = 1 and T_1 = X in two workspaces, then T_k overwrites T_k-2
+  ParallelMatrix<T> t[2] = {result, x};
+  result *= T(c[0]);
+  for (int k = 1; k <= m; k++) {
+    if (k > 1) {
+      t[k % 2].gemm(x, t[(k - 1) % 2], transN, transN, T(2.), T(-1.));
+    }
+    T ck = T(c[k]);
+    const T* tk = t[k % 2].mat;
+    for (size_t i = 0; i < numLocalElements_; i++) result.mat[i] += ck * tk[i];
+  }
+  return result;
 }
 
+template <typename T>
+ParallelMatrix<T> ParallelMatrix<T>::redistribute(const int& numBlocksRows,
+                                                  const int& numBlocksCols) {
+
+  ParallelMatrix<T> result(numRows_, numCols_, numBlocksRows, numBlocksCols,
+                           blacsContext_);
+  blacsInt one = 1;
+  RegionTimer timer("redistribute");
+  scalapack<T>::gemr2d(&numRows_, &numCols_, mat, &one, &one, &descMat_[0],
+                       result.mat, &one, &one, &result.descMat_[0],
+                       &blacsContext_);
+  return result;
+}
+
+template <typename T>
+ParallelMatrix<T> ParallelMatrix<T>::getColumns(const int& firstCol,
+                                                const int& numCols) const {
+  if (firstCol < 0 || numCols < 0 || firstCol + numCols > numCols_) {
+    Error("getColumns: columns out of range");
+  }
+  ParallelMatrix<T> result = newBlock(numCols);
+  if (numCols == 0) return result;
+  blacsInt m = numRows_;
+  blacsInt n = numCols;
+  blacsInt one = 1;
+  blacsInt ja = firstCol + 1;
+  scalapack<T>::gemr2d(&m, &n, mat, &one, &ja,
+                       const_cast<blacsInt*>(&descMat_[0]), result.mat, &one,
+                       &one, &result.descMat_[0],
+                       const_cast<blacsInt*>(&blacsContext_));
+  return result;
+}
+
+template <typename T>
+void ParallelMatrix<T>::setColumns(const int& firstCol,
+                                   const ParallelMatrix<T>& block) {
+  if (block.numRows_ != numRows_ || firstCol < 0 ||
+      firstCol + block.numCols_ > numCols_) {
+    Error("setColumns: the block doesn't fit in the matrix");
+  }
+  if (block.blacsContext_ != blacsContext_) {
+    Error("setColumns: the block must share the blacs context of the matrix");
+  }
+  if (block.numCols_ == 0) return;
+  eigendecomposition_.reset();
+  blacsInt one = 1;
+  blacsInt jb = firstCol + 1;
+  scalapack<T>::gemr2d(&numRows_, const_cast<blacsInt*>(&block.numCols_),
+                       block.mat, &one, &one,
+                       const_cast<blacsInt*>(&block.descMat_[0]), mat, &one,
+                       &jb, &descMat_[0], &blacsContext_);
+}
+
+// LU factorization and solve --------------------------------------------------
+
+template <typename T>
+int ParallelMatrix<T>::factorizeLU(std::vector<blacsInt>& pivots) {
+  // ipiv needs LOCr(M_A) + MB_A entries
+  pivots.resize(numLocalRows_ + blockSizeRows_);
+  blacsInt one = 1;
+  blacsInt info = 0;
+  eigendecomposition_.reset();  // overwritten with the LU factors
+  {
+    RegionTimer timer("LU factorization",
+                      flopsGetrf<T>(numRows_) / mpi->getSize());
+    scalapack<T>::getrf(&numRows_, &numCols_, mat, &one, &one, &descMat_[0],
+                        pivots.data(), &info);
+  }
+  if (info < 0) {
+    Error("Developer error: one of the input params to "
+          + std::string(scalapack<T>::prefix) + "GETRF is wrong!", info);
+  }
+  return info;
+}
+
+template <typename T>
+void ParallelMatrix<T>::solveLU(const std::vector<blacsInt>& pivots,
+                                ParallelMatrix<T>& rhs) {
+  char trans = transN;
+  blacsInt one = 1;
+  blacsInt info = 0;
+  rhs.eigendecomposition_.reset();  // overwritten with the solution
+  RegionTimer timer("LU solve",
+                    flopsGetrs<T>(numRows_, rhs.numCols_) / mpi->getSize());
+  scalapack<T>::getrs(&trans, &numRows_, &rhs.numCols_, mat, &one, &one,
+                      &descMat_[0], const_cast<blacsInt*>(pivots.data()), rhs.mat,
+                      &one, &one, &rhs.descMat_[0], &info);
+  if (info != 0) {
+    Error(std::string(scalapack<T>::prefix) + "GETRS failed.", info);
+  }
+}
+
+// Explicit instantiations, for every type of scalapack<T>
+#define INSTANTIATE_SCALAPACK_OPERATIONS(T)                                   \
+  template ParallelMatrix<T> ParallelMatrix<T>::prod(                         \
+      const ParallelMatrix<T>&, const char&, const char&);                    \
+  template std::tuple<std::vector<double>, ParallelMatrix<T>>                 \
+  ParallelMatrix<T>::diagonalize();                                           \
+  template std::tuple<std::vector<double>, ParallelMatrix<T>>                 \
+  ParallelMatrix<T>::diagonalize(int, bool);                                  \
+  template std::tuple<std::vector<double>, ParallelMatrix<T>>                 \
+  ParallelMatrix<T>::diagonalizeRange(const double&, const double&);          \
+  template std::tuple<std::vector<double>, ParallelMatrix<T>>                 \
+  ParallelMatrix<T>::diagonalizeSubset(const char&, const double&,            \
+                                       const double&, const blacsInt&,        \
+                                       const blacsInt&);                      \
+  template std::tuple<std::vector<double>, ParallelMatrix<T>>                 \
+  ParallelMatrix<T>::diagonalizeSlices();                                     \
+  template void ParallelMatrix<T>::symmetrize();                              \
+  template ParallelMatrix<T> ParallelMatrix<T>::applyFunction(                \
+      const std::function<double(double)>&, const bool&);                     \
+  template void ParallelMatrix<T>::gemm(                                      \
+      const ParallelMatrix<T>&, const ParallelMatrix<T>&, const char&,        \
+      const char&, const T&, const T&);                                       \
+  template std::vector<double> ParallelMatrix<T>::columnSumsAndDiagonal()     \
+      const;                                                                  \
+  template ParallelMatrix<T> ParallelMatrix<T>::expm(const double&, int*);    \
+  template ParallelMatrix<T> ParallelMatrix<T>::chebyshevFunction(            \
+      const std::function<double(double)>&, const double&, const double&,     \
+      const double&, int*);                                                   \
+  template ParallelMatrix<T> ParallelMatrix<T>::redistribute(const int&,      \
+                                                             const int&);     \
+  template ParallelMatrix<T> ParallelMatrix<T>::getColumns(const int&,        \
+                                                           const int&) const; \
+  template void ParallelMatrix<T>::setColumns(const int&,                     \
+                                              const ParallelMatrix<T>&);      \
+  template int ParallelMatrix<T>::factorizeLU(std::vector<blacsInt>&);        \
+  template void ParallelMatrix<T>::solveLU(const std::vector<blacsInt>&,      \
+                                           ParallelMatrix<T>&);
+
+INSTANTIATE_SCALAPACK_OPERATIONS(double)
+INSTANTIATE_SCALAPACK_OPERATIONS(float)
+INSTANTIATE_SCALAPACK_OPERATIONS(std::complex<double>)
+INSTANTIATE_SCALAPACK_OPERATIONS(std::complex<float>)
+
+#undef INSTANTIATE_SCALAPACK_OPERATIONS
+
 #endif  // MPI_AVAIL
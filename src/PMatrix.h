@@ -1,9 +1,13 @@
 #pragma once
 
+#include <algorithm>
+#include <functional>
+#include <memory>
 #include <tuple>
 #include <vector>
 #include "blacs.h"
 #include "mpi/mpiHelper.h"
+#include "profiler.h"
 #include "utilities.h"
 //#include "io.h"
 
@@ -12,6 +16,7 @@
 #endif
 #include <utility>
 #include <set>
+#include <limits>
 
 // https://www.ibm.com/docs/en/pessl/5.5?topic=programs-application-program-outline
 
@@ -19,37 +24,55 @@
  *
  * This class uses the Scalapack library for matrix-matrix multiplication and
  * matrix diagonalization. For the time being we don't use other scalapack
- * functionalities.
+ * functionalities. The scalapack routine of each precision is picked by
+ * scalapack<T> in scalapackTraits.h.
  *
- * Template specialization only valid for double or complex<double>.
+ * Template specialization only valid for double, complex<double>, float
+ * or complex<float>.
  */
+template <typename T>
+class SymmetricParallelMatrix;
+template <typename T>
+class BlockSparseParallelMatrix;
+template <typename T>
+class SparseParallelMatrix;
+
 template <typename T>
 class ParallelMatrix {
  private:
+  // matrices of different precision read each other's buffers in cast()
+  template <typename U>
+  friend class ParallelMatrix;
+  // packed and sparse matrices copy elements to and from the local buffer
+  friend class SymmetricParallelMatrix<T>;
+  friend class BlockSparseParallelMatrix<T>;
+  friend class SparseParallelMatrix<T>;
 
   /// Class variables
-  int numRows_ = 0;
-  int numCols_ = 0;
-  int numLocalRows_ = 0;
-  int numLocalCols_ = 0;
+  // integers passed to scalapack are blacsInt (see blacs.h), while indices
+  // into the local buffer are 64-bit, as it may hold more than 2^31 elements
+  blacsInt numRows_ = 0;
+  blacsInt numCols_ = 0;
+  blacsInt numLocalRows_ = 0;
+  blacsInt numLocalCols_ = 0;
   size_t numLocalElements_ = 0;
 
   // BLACS variables
   // numBlocksRows/Cols -- the number of units we divide nrows/ncols into
-  int numBlocksRows_ = 0;
-  int numBlocksCols_ = 0;
+  blacsInt numBlocksRows_ = 0;
+  blacsInt numBlocksCols_ = 0;
   // blockSizeRows/Cols -- the size of each unit we divide nrows/ncols into
-  int blockSizeRows_ = 0;
-  int blockSizeCols_ = 0;
+  blacsInt blockSizeRows_ = 0;
+  blacsInt blockSizeCols_ = 0;
   // numBlacsRows/Cols - the number of rows/cols in the process grid
-  int numBlacsRows_ = 0;
-  int numBlacsCols_ = 0;
+  blacsInt numBlacsRows_ = 0;
+  blacsInt numBlacsCols_ = 0;
   // myBlacsRow/Col - this process's row/col in the process grid
-  int myBlacsRow_ = 0;
-  int myBlacsCol_ = 0;
-  int descMat_[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
-  int blasRank_ = 0;
-  int blacsContext_ = 0;
+  blacsInt myBlacsRow_ = 0;
+  blacsInt myBlacsCol_ = 0;
+  blacsInt descMat_[9] = {0, 0, 0, 0, 0, 0, 0, 0, 0};
+  blacsInt blasRank_ = 0;
+  blacsInt blacsContext_ = 0;
   char blacsLayout_ = 'R';  // block cyclic, row major processor mapping
 
   // dummy values to return when accessing elements not available locally
@@ -58,26 +81,74 @@ class ParallelMatrix {
 
   T* mat = nullptr; // raw buffer
 
-  /** Converts a local one-dimensional storage index (MPI-dependent) into the
-   * row/column index of the global matrix.
-   */
-  std::tuple<int, int> local2Global(const int& k) const;
-  std::tuple<int, int> local2Global(const int& i, const int& j) const;
+  // eigenvalues and eigenvectors of this matrix, kept on request by
+  // applyFunction() for the next calls and shared by copies. Operations that modify the matrix,
+  // including the non-const operator(), drop them.
+  std::shared_ptr<const std::tuple<std::vector<double>, ParallelMatrix<T>>>
+      eigendecomposition_;
 
   /** Set the blacsContext for cases where two descriptors must share the same one */
   void setBlacsContext(int blacsContext);
 
+  /** LU factorization with partial pivoting (p?getrf), in place.
+   * @param pivots: filled on return with the local pivot indices.
+   * @return info: 0 on success, >0 if the matrix is exactly singular.
+   */
+  int factorizeLU(std::vector<blacsInt>& pivots);
+
+  /** Solves A X = B, where this matrix holds the LU factors of A (p?getrs).
+   * @param pivots: the pivots returned by factorizeLU.
+   * @param rhs: B on input, overwritten with X.
+   */
+  void solveLU(const std::vector<blacsInt>& pivots, ParallelMatrix<T>& rhs);
+
+  /** Checks that a right hand side can be used with this matrix in a
+   * linear solve, and errors out otherwise.
+   */
+  void checkLinearSystem(const ParallelMatrix<T>& rhs) const;
+
+  /** Partial diagonalization with p?syevr, for range = 'I' (eigenvalues il
+   * to iu, from 1) or range = 'V' (eigenvalues in (vl, vu]).
+   */
+  std::tuple<std::vector<double>, ParallelMatrix<T>>
+  diagonalizeSubset(const char& range, const double& vl, const double& vu,
+                    const blacsInt& il, const blacsInt& iu);
+
+  /** Returns the sums of the absolute values of the elements of each
+   * column, followed by the real part of the diagonal (2N values), with a
+   * single collective.
+   */
+  std::vector<double> columnSumsAndDiagonal() const;
+
+  /** Calls f(k, i) for each diagonal element (i,i) stored by this process,
+   * with k its index in the local buffer, in increasing order of i. Only the
+   * diagonal blocks of this process are visited, from the block-cyclic
+   * layout, without index conversions: about N / sqrt(numProcs) elements on
+   * a square process grid, instead of N lookups with global2Local().
+   */
+  template <typename F>
+  void forEachLocalDiagonal(F&& f) const;
+
  public:
+  /** Converts a local one-dimensional storage index (MPI-dependent) into the
+   * row/column index of the global matrix.
+   */
+  std::tuple<int, int> local2Global(const int64_t& k) const;
+  /** Converts a local row/column index (MPI-dependent) into the
+   * row/column index of the global matrix.
+   */
+  std::tuple<int, int> local2Global(const int& i, const int& j) const;
+
   /** Converts a global row/column index of the global matrix into a local
    * one-dimensional storage index (MPI-dependent),
    * with value ranging from  0 to numLocalElements_-1.
    * Returns -1 if the matrix element is not stored on the current MPI process.
    */
-  int global2Local(const int& row, const int& col) const;
+  int64_t global2Local(const int& row, const int& col) const;
 
-  static const char transN = 'N';  // no transpose nor adjoint
-  static const char transT = 'T';  // transpose
-  static const char transC = 'C';  // adjoint (for complex numbers)
+  static constexpr char transN = 'N';  // no transpose nor adjoint
+  static constexpr char transT = 'T';  // transpose
+  static constexpr char transC = 'C';  // adjoint (for complex numbers)
 
   /** Constructor of the matrix class.
    * Matrix elements are set to zero in the initialization.
@@ -123,12 +194,12 @@ class ParallelMatrix {
   /** Find the global indices of the rows that are stored locally
    * by the current MPI process.
    */
-  std::vector<int> getAllLocalRows();
+  std::vector<int> getAllLocalRows() const;
 
   /** Find the global indices of the cols that are stored locally
    * by the current MPI process.
    */
-  std::vector<int> getAllLocalCols();
+  std::vector<int> getAllLocalCols() const;
 
   /** Returns true if the global indices (row,col) identify a matrix element
    * stored by the MPI process.
@@ -203,7 +274,35 @@ class ParallelMatrix {
    */
   void zeros();
 
-  /** Diagonalize a complex-hermitian or real-symmetric matrix.
+  /** Multiplies the rows by factors[i], i.e. A <- D A with D diagonal,
+   * without forming D. Every process passes all the N factors.
+   */
+  void scaleRows(const std::vector<T>& factors);
+
+  /** Multiplies the columns by factors[j], i.e. A <- A D with D diagonal.
+   * Every process passes all the N factors.
+   */
+  void scaleCols(const std::vector<T>& factors);
+
+  /** Adds values[i] to the diagonal element (i,i), or the same value to
+   * all of them (a shift A + value * 1). Square matrices only.
+   */
+  void addToDiagonal(const std::vector<T>& values);
+  void addToDiagonal(const T& value);
+
+  /** Returns the diagonal of the matrix on every process, with a single
+   * collective. Square matrices only.
+   */
+  std::vector<T> getDiagonal() const;
+
+  /** Returns the trace of the matrix on every process, with a single
+   * collective. Square matrices only.
+   */
+  T trace() const;
+
+  /** Diagonalize a complex-hermitian or real-symmetric matrix, with the
+   * divide and conquer solver (p?syevd or p?heevd). The second version
+   * only computes the lowest numEigenvalues eigenpairs (p?syevr or p?heevr).
    * Nota bene: we don't check if the matrix is hermitian/symmetric or not.
    * By default, it operates on the upper-triangular part of the matrix.
    */
@@ -211,6 +310,77 @@ class ParallelMatrix {
   std::tuple<std::vector<double>, ParallelMatrix<T>> diagonalize(int numEigenvalues,
                                                 bool checkNegativeEigenvalues = true);
 
+  /** Computes the eigenpairs with eigenvalues in (lowerBound, upperBound],
+   * as diagonalize(numEigenvalues) but with p?syevr's range = 'V'. The
+   * eigenvectors are the first eigenvalues.size() columns of the N x N
+   * matrix returned.
+   */
+  std::tuple<std::vector<double>, ParallelMatrix<T>>
+  diagonalizeRange(const double& lowerBound, const double& upperBound);
+
+  /** Diagonalizes a complex-hermitian or real-symmetric matrix by slicing
+   * its spectrum across the MPI pools (-ps). The spectrum is split into one
+   * window per pool, holding equal numbers of eigenvalues: counts come from
+   * the Sylvester inertia of LDL^T factorizations of T - sigma, with T the
+   * tridiagonal form of the matrix (p?sytrd/p?hetrd, by all the processes,
+   * on the grid of the matrix).
+   * Each pool then computes the eigenpairs of its window concurrently, with
+   * p?syevr (range = 'V') on its own copy of the matrix, on a square grid of
+   * its processes. Eigenvalues and eigenvectors are assembled in ascending
+   * order, with the blacs context and blocks of this matrix, which is left
+   * unchanged. Without pools, the same as diagonalize().
+   * Nota bene: p?syevr reduces its copy to tridiagonal form again, so every
+   * pool repeats the O(N^3) reduction, after the one of the window counts,
+   * which runs on all the processes before the pools can start. The total
+   * work is larger than that of one p?syevd on all the processes, and the
+   * shared reduction doesn't scale with the pools: compare with the
+   * "slices" and "syevd" benchmarks before preferring it to diagonalize().
+   */
+  std::tuple<std::vector<double>, ParallelMatrix<T>> diagonalizeSlices();
+
+  /** Mixed precision diagonalization of a complex-hermitian or real-symmetric
+   * matrix: the eigenpairs are computed in single precision, then refined
+   * to double precision accuracy with the iterative refinement of
+   * Ogita and Aishima, which only uses matrix products in double precision.
+   * Valid for double and complex<double> matrices, and as diagonalize(),
+   * it only reads the upper triangle of the matrix in the single precision
+   * step. Degenerate or tightly clustered eigenvalues converge slower,
+   * their eigenvectors are only orthonormalized within the cluster.
+   * @param maxRefinements: maximum number of refinement iterations. Each
+   * one costs four matrix products.
+   */
+  std::tuple<std::vector<double>, ParallelMatrix<T>>
+  diagonalizeMixedPrecision(const int& maxRefinements = 3);
+
+  /** Solves the linear system A X = B, with A this matrix, by LU
+   * factorization in the precision of the matrix. This matrix is unchanged.
+   * @param rhs: the matrix B, with the same row distribution as A, on the
+   * same blacs context. A must be square, with square blocks.
+   * @return x: the solution X, distributed as B.
+   */
+  ParallelMatrix<T> solve(const ParallelMatrix<T>& rhs);
+
+  /** Solves the linear system A X = B with mixed precision iterative
+   * refinement: A is factorized in single precision, and the solution is
+   * corrected with residuals B - A X computed in double precision, until
+   * it is accurate to double precision. If the refinement doesn't converge
+   * (e.g. for an ill-conditioned A), the system is solved again with a
+   * double precision factorization, as in solve().
+   * Valid for double and complex<double> matrices; same arguments as solve().
+   * @param numIterations: if not null, set to the number of refinement
+   * iterations, or to -1 if the double precision fallback was used.
+   * @param maxIterations: maximum number of refinement iterations.
+   */
+  ParallelMatrix<T> solveMixedPrecision(const ParallelMatrix<T>& rhs,
+                                        int* numIterations = nullptr,
+                                        const int& maxIterations = 30);
+
+  /** Copies the matrix into a matrix with another element type (e.g. a
+   * different precision), with the same distribution.
+   */
+  template <typename U>
+  ParallelMatrix<U> cast() const;
+
   /** Computes the squared Frobenius norm of the matrix
    * (or Euclidean norm, or L2 norm of the matrix)
    */
@@ -231,10 +401,114 @@ class ParallelMatrix {
    */
   ParallelMatrix<T> operator-() const;
 
-  /** Symmetrize the matrix with pdtran for transpose, (A + A^T)/2
+  /** Computes the matrix function f(A) = V f(Lambda) V^H of a
+   * complex-hermitian or real-symmetric matrix A = V Lambda V^H, e.g.
+   * [](double x) { return 1. / std::sqrt(x); } for A^-1/2, or std::exp.
+   * f(A) is formed with a single product: p?syrk/p?herk if f >= 0 on the
+   * spectrum, with sqrt(f(Lambda)) on both sides, and the eigenvector
+   * columns scaled in place, otherwise p?gemm. This matrix is unchanged.
+   * @param f: real function of the eigenvalues, finite on the spectrum.
+   * @param keepDecomposition: if true, the eigendecomposition (p?syevd) is
+   * kept for the next calls until the matrix is modified, at the cost of
+   * one more N x N matrix, and the eigenvectors are scaled on a copy.
+   * @return result: f(A), distributed as A.
+   */
+  ParallelMatrix<T> applyFunction(const std::function<double(double)>& f,
+                                  const bool& keepDecomposition = false);
+
+  /** Releases the eigendecomposition kept by applyFunction(f, true).
+   */
+  void clearEigendecomposition();
+
+  /** Matrix product into this matrix, C = alpha trans1(A) trans2(B) + beta C
+   * (p?gemm). Unlike prod(), the storage of C is reused, e.g. as the
+   * workspace of a sequence of products. C must have the size of the
+   * product, must not be A or B, and must share their blacs context.
+   */
+  void gemm(const ParallelMatrix<T>& a, const ParallelMatrix<T>& b,
+            const char& trans1 = transN, const char& trans2 = transN,
+            const T& alpha = 1., const T& beta = 0.);
+
+  /** Matrix exponential exp(A) of a square matrix, by scaling and squaring
+   * with a diagonal Pade approximant (Golub and Van Loan, algorithm
+   * 11.3.1), without diagonalization. A is scaled by 2^-s so that
+   * |A|_1 / 2^s <= 1/2, and the Pade degree q is the lowest for which the
+   * relative backward error bound 2^(3-2q) (q!)^2 / ((2q)! (2q+1)!) is below
+   * the tolerance. This costs q - 1 products, one LU solve and s squarings,
+   * done in place on a fixed set of workspaces of the size of A. A must be
+   * distributed in square blocks, as for solve().
+   * @param tolerance: relative backward error; if 0, the epsilon of T.
+   * @param numProducts: if not null, set to the number of matrix products.
+   */
+  ParallelMatrix<T> expm(const double& tolerance = 0.,
+                         int* numProducts = nullptr);
+
+  /** Computes f(A) of a complex-hermitian or real-symmetric matrix from a
+   * Chebyshev expansion of f on an interval containing the spectrum,
+   * without diagonalization: the polynomials T_k(A) follow from the
+   * recurrence T_k+1 = 2 A T_k - T_k-1, one product per degree, which
+   * overwrites T_k-1 in place. The degree is the lowest for which the
+   * neglected coefficients add up to less than tolerance times the largest
+   * one, at most 1024: smooth f, such as a Fermi-Dirac function for
+   * density-matrix purification, need low degrees. The cost is one p?gemm
+   * per degree, so up to 1023 products; if the tolerance isn't reached at
+   * the maximum degree, the head process prints a warning with the
+   * accuracy achieved.
+   * @param f: real function, finite on the interval.
+   * @param tolerance: relative accuracy of the expansion; if 0, 10 times
+   * the epsilon of T.
+   * @param lowerBound, upperBound: interval containing the spectrum; if
+   * lowerBound >= upperBound (the default), the union of the Gershgorin
+   * discs of A.
+   * @param degree: if not null, set to the degree of the expansion.
+   */
+  ParallelMatrix<T> chebyshevFunction(const std::function<double(double)>& f,
+                                      const double& tolerance = 0.,
+                                      const double& lowerBound = 0.,
+                                      const double& upperBound = 0.,
+                                      int* degree = nullptr);
+
+  /** Symmetrize the matrix with p?tran for transpose, (A + A^T)/2,
+   * or make it hermitian with p?tranc for complex numbers, (A + A^H)/2.
   */
   void symmetrize();
 
+  /** Copies the matrix into a new one with a different block-cyclic
+   * distribution, on the same blacs process grid (p?gemr2d).
+   * @param numBlocksRows/Cols: number of blocks of the new distribution,
+   * with the same defaults as the constructor.
+   * @return result: the redistributed matrix.
+   */
+  ParallelMatrix<T> redistribute(const int& numBlocksRows = 0,
+                                 const int& numBlocksCols = 0);
+
+  /** Returns a zero matrix of numCols columns, with the rows, the row
+   * blocking and the blacs context of this matrix: e.g. a block of
+   * vectors that this matrix can multiply.
+   */
+  ParallelMatrix<T> newBlock(const int& numCols) const;
+
+  /** Copies the columns [firstCol, firstCol + numCols) into a new matrix
+   * made by newBlock(numCols) (p?gemr2d).
+   */
+  ParallelMatrix<T> getColumns(const int& firstCol, const int& numCols) const;
+
+  /** Overwrites the columns from firstCol with the columns of block, which
+   * has the rows of this matrix and shares its blacs context (p?gemr2d).
+   */
+  void setColumns(const int& firstCol, const ParallelMatrix<T>& block);
+
+  /** Returns a copy of the whole matrix on every MPI process, for small
+   * matrices such as projections on a subspace. Must be called by all
+   * processes.
+   */
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> toEigen() const;
+
+  /** Sets the local elements from a matrix of the same size held by every
+   * MPI process, the inverse of toEigen().
+   */
+  void fromEigen(const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& that);
+
 };
 
 template <typename T>
@@ -274,21 +548,27 @@ ParallelMatrix<T>::ParallelMatrix(const int& numRows, const int& numCols,
   if (numCols_ % numBlocksCols_ != 0) blockSizeCols_ += 1;
 
   // determine the number of local rows and columns
-  int iZero = 0;  // helper variable
+  blacsInt iZero = 0;  // helper variable
 
   // numroc function takes information about the process grid and returns the number of
   // rows and cols which are local to this process
   numLocalRows_ = numroc_(&numRows_, &blockSizeRows_, &myBlacsRow_, &iZero, &numBlacsRows_);
   numLocalCols_ = numroc_(&numCols_, &blockSizeCols_, &myBlacsCol_, &iZero, &numBlacsCols_);
-  numLocalElements_ = numLocalRows_ * numLocalCols_;
+  // size_t product, so that it can't overflow before the check below
+  numLocalElements_ = size_t(numLocalRows_) * size_t(numLocalCols_);
 
-  if(numLocalElements_ < 0) { // probably overflowed
+#ifndef SCALAPACK_ILP64
+  // a 32-bit scalapack indexes the local buffer with int
+  if(numLocalElements_ > size_t(std::numeric_limits<int>::max())) {
     Error("The number of matrix elements local to this process overflows int\n"
-  		    "increase the number of MPI processes.");
+          "increase the number of MPI processes, or build with an ILP64\n"
+          "scalapack (cmake -DSCALAPACK_ILP64=ON).");
   }
+#endif
 
   // allocate the matrix
   mat = new T[numLocalElements_];
+  trackMemory("ParallelMatrix", numLocalElements_ * sizeof(T));
 
   // Memory could not be allocated, end program
   assert(mat != nullptr);
@@ -297,8 +577,8 @@ ParallelMatrix<T>::ParallelMatrix(const int& numRows, const int& numCols,
   for (size_t i = 0; i < numLocalElements_; ++i) *(mat + i) = 0.;
 
   // Create descriptor for block cyclic distribution of matrix
-  int info;  // error code
-  int lddA =
+  blacsInt info;  // error code
+  blacsInt lddA =
       numLocalRows_ > 1 ? numLocalRows_ : 1;  // if mpA>1, ldda=mpA, else 1
 
   descinit_(descMat_, &numRows_, &numCols_, &blockSizeRows_, &blockSizeCols_,
@@ -331,6 +611,7 @@ ParallelMatrix<T>::ParallelMatrix(const ParallelMatrix<T>& that) {
   myBlacsCol_ = that.myBlacsCol_;
   blasRank_ = that.blasRank_;
   blacsContext_ = that.blacsContext_;
+  eigendecomposition_ = that.eigendecomposition_;
 
   for (int i = 0; i < 9; i++) {
     descMat_[i] = that.descMat_[i];
@@ -340,6 +621,7 @@ ParallelMatrix<T>::ParallelMatrix(const ParallelMatrix<T>& that) {
   }
   // matrix allocation
   mat = new T[numLocalElements_];
+  trackMemory("ParallelMatrix", numLocalElements_ * sizeof(T));
   // Memory could not be allocated, end program
   assert(mat != nullptr);
   for (size_t i = 0; i < numLocalElements_; i++) {
@@ -350,6 +632,9 @@ ParallelMatrix<T>::ParallelMatrix(const ParallelMatrix<T>& that) {
 template <typename T>
 ParallelMatrix<T>& ParallelMatrix<T>::operator=(const ParallelMatrix<T>& that) {
   if (this != &that) {
+    if ( mat != nullptr ) {
+      trackMemory("ParallelMatrix", -long(numLocalElements_ * sizeof(T)));
+    }
     numRows_ = that.numRows_;
     numCols_ = that.numCols_;
     numLocalRows_ = that.numLocalRows_;
@@ -365,6 +650,7 @@ ParallelMatrix<T>& ParallelMatrix<T>::operator=(const ParallelMatrix<T>& that) {
     myBlacsCol_ = that.myBlacsCol_;
     blasRank_ = that.blasRank_;
     blacsContext_ = that.blacsContext_;
+    eigendecomposition_ = that.eigendecomposition_;
 
     for (int i = 0; i < 9; i++) {
       descMat_[i] = that.descMat_[i];
@@ -374,6 +660,7 @@ ParallelMatrix<T>& ParallelMatrix<T>::operator=(const ParallelMatrix<T>& that) {
     }
     // matrix allocation
     mat = new T[numLocalElements_];
+    trackMemory("ParallelMatrix", numLocalElements_ * sizeof(T));
     // Memory could not be allocated, end program
     assert(mat != nullptr);
     for (size_t i = 0; i < numLocalElements_; i++) {
@@ -387,6 +674,7 @@ template <typename T>
 ParallelMatrix<T>::~ParallelMatrix() {
   if ( mat != nullptr ) {
     delete[] mat;
+    trackMemory("ParallelMatrix", -long(numLocalElements_ * sizeof(T)));
   }
 }
 
@@ -394,7 +682,7 @@ template <typename T>
 void ParallelMatrix<T>::initBlacs(const int& numBlacsRows, const int& numBlacsCols,
                                                         const int& inputBlacsContext) {
 
-  int size = mpi->getSize(); // temp variable for mpi world size, used in setup
+  blacsInt size = mpi->getSize(); // temp variable for mpi world size, used in setup
 
   // TODO if we only give this the nearest square number of processors,
   // will it disregard the others for us? Could this fix the
@@ -404,7 +692,7 @@ void ParallelMatrix<T>::initBlacs(const int& numBlacsRows, const int& numBlacsCo
   //  IF (MYROW .LT. NPROW .AND. MYCOL .LT. NPCOL) THEN
   //  https://www.ibm.com/docs/en/pessl/5.5?topic=programs-application-program-outline
   blacs_pinfo_(&blasRank_, &size);
-  int iZero = 0;
+  blacsInt iZero = 0;
   if( inputBlacsContext == -1) { // no context has been created/supplied
     blacs_get_(&iZero, &iZero, &blacsContext_);  // -> get default system context
   }
@@ -415,7 +703,9 @@ void ParallelMatrix<T>::initBlacs(const int& numBlacsRows, const int& numBlacsCo
   }
 
   // Cases for a blacs grid where we specified rows, cols, both,
-  // or the default, neither, which results in a square proc grid
+  // or the default, neither, which results in a square proc grid.
+  // With neither and a supplied context, the shape of the grid is read
+  // from that context below
   if(numBlacsRows != 0 && numBlacsCols == 0) {
     numBlacsRows_ = numBlacsRows;
     numBlacsCols_ = mpi->getSize()/numBlacsRows;
@@ -428,7 +718,7 @@ void ParallelMatrix<T>::initBlacs(const int& numBlacsRows, const int& numBlacsCo
     numBlacsRows_ = numBlacsRows;
     numBlacsCols_ = numBlacsCols;
   }
-  else {
+  else if(inputBlacsContext == -1) {
     // set up a square procs grid, as the default
     numBlacsRows_ = (int)(sqrt(size)); // int does rounding down (intentional!)
     numBlacsCols_ = numBlacsRows_;
@@ -482,7 +772,8 @@ size_t ParallelMatrix<T>::size() const {
 template <typename T>
 T& ParallelMatrix<T>::operator()(const int &row, const int &col) {
   if(row > numRows_ || col > numCols_) DeveloperError("Tried to fill a PMatrix state out of bounds: " + std::to_string(row) + " " + std::to_string(col));
-  int localIndex = global2Local(row, col);
+  eigendecomposition_.reset();  // the element may be written
+  int64_t localIndex = global2Local(row, col);
   if (localIndex == -1) {
     dummyZero = 0.;
     return dummyZero;
@@ -493,7 +784,7 @@ T& ParallelMatrix<T>::operator()(const int &row, const int &col) {
 
 template <typename T>
 const T& ParallelMatrix<T>::operator()(const int &row, const int &col) const {
-  int localIndex = global2Local(row, col);
+  int64_t localIndex = global2Local(row, col);
   if (localIndex == -1) {
     return dummyConstZero;
   } else {
@@ -503,7 +794,7 @@ const T& ParallelMatrix<T>::operator()(const int &row, const int &col) const {
 
 template <typename T>
 bool ParallelMatrix<T>::indicesAreLocal(const int& row, const int& col) {
-  int localIndex = global2Local(row, col);
+  int64_t localIndex = global2Local(row, col);
   if (localIndex == -1) {
     return false;
   } else {
@@ -513,21 +804,22 @@ bool ParallelMatrix<T>::indicesAreLocal(const int& row, const int& col) {
 
 template <typename T>
 std::tuple<int,int> ParallelMatrix<T>::local2Global(const int& i, const int& j) const {
-  int il = (int)i;
-  int jl = (int)j;
-  int iZero = 0;
+  // indxl2g_ uses fortran indices, running from 1 to N
+  blacsInt il = i + 1;
+  blacsInt jl = j + 1;
+  blacsInt iZero = 0;
   int ig = indxl2g_( &il, &blockSizeRows_, &myBlacsRow_, &iZero, &numBlacsRows_ );
   int jg = indxl2g_( &jl, &blockSizeCols_, &myBlacsCol_, &iZero, &numBlacsCols_ );
-  return std::make_tuple(ig,jg);
+  return std::make_tuple(ig - 1, jg - 1);
 }
 
 template <typename T>
-std::tuple<int, int> ParallelMatrix<T>::local2Global(const int& k) const {
+std::tuple<int, int> ParallelMatrix<T>::local2Global(const int64_t& k) const {
   // first, we convert this combined local index k
   // into local row / col indices
   // k = j * numLocalRows_ + i
-  int j = k / numLocalRows_;
-  int i = k - j * numLocalRows_;
+  int j = int(k / numLocalRows_);
+  int i = int(k - int64_t(j) * numLocalRows_);
 
   // TODO this might need to be converted into a indxl2g version!
   // should just be able to uncomment the below two lines and comment the rest over
@@ -553,14 +845,14 @@ std::tuple<int, int> ParallelMatrix<T>::local2Global(const int& k) const {
 }
 
 template <typename T>
-int ParallelMatrix<T>::global2Local(const int& row, const int& col) const {
+int64_t ParallelMatrix<T>::global2Local(const int& row, const int& col) const {
   // note: row and col indices use the c++ convention of running from 0 to N-1
   // fortran (infog2l_) wants indices from 1 to N.
-  int row_ = int(row) + 1;
-  int col_ = int(col) + 1;
+  blacsInt row_ = row + 1;
+  blacsInt col_ = col + 1;
 
   // use infog2l_ to check that the current process owns this matrix element
-  int iia, jja, iarow, iacol;
+  blacsInt iia, jja, iarow, iacol;
   infog2l_(&row_, &col_, &descMat_[0], &numBlacsRows_, &numBlacsCols_,
            &myBlacsRow_, &myBlacsCol_, &iia, &jja, &iarow, &iacol);
 
@@ -569,10 +861,11 @@ int ParallelMatrix<T>::global2Local(const int& row, const int& col) const {
     return -1;
   } else {
     // get the local indices, (il,jl) of the globally indexed element
-    int iZero = 0;
-    int il = indxg2l_( &row_, &blockSizeRows_, &myBlacsRow_, &iZero, &numBlacsRows_ );
-    int jl = indxg2l_( &col_, &blockSizeCols_, &myBlacsCol_, &iZero, &numBlacsCols_ );
-    return il + (jl - 1) * descMat_[8] - 1;
+    blacsInt iZero = 0;
+    blacsInt il = indxg2l_( &row_, &blockSizeRows_, &myBlacsRow_, &iZero, &numBlacsRows_ );
+    blacsInt jl = indxg2l_( &col_, &blockSizeCols_, &myBlacsCol_, &iZero, &numBlacsCols_ );
+    // 64-bit, as (jl - 1) * lld may overflow int
+    return int64_t(il - 1) + int64_t(jl - 1) * int64_t(descMat_[8]);
   }
 }
 
@@ -587,29 +880,31 @@ std::vector<std::tuple<int, int>> ParallelMatrix<T>::getAllLocalElements() {
 }
 
 template <typename T>
-std::vector<int> ParallelMatrix<T>::getAllLocalRows() {
-  int iZero = 0;
+std::vector<int> ParallelMatrix<T>::getAllLocalRows() const {
+  blacsInt iZero = 0;
   std::vector<int> x;
-  for (int k = 0; k < numLocalRows_; k++) {
+  // indxl2g_ uses fortran indices, running from 1 to N
+  for (blacsInt k = 1; k <= numLocalRows_; k++) {
     int gr = indxl2g_( &k, &blockSizeRows_, &myBlacsRow_, &iZero, &numBlacsRows_ );
-    x.push_back(gr);
+    x.push_back(gr - 1);
   }
   return x;
 }
 
 template <typename T>
-std::vector<int> ParallelMatrix<T>::getAllLocalCols() {
+std::vector<int> ParallelMatrix<T>::getAllLocalCols() const {
   std::vector<int> x;
-  int iZero = 0;
-  for (int k = 0; k < numLocalCols_; k++) {
+  blacsInt iZero = 0;
+  for (blacsInt k = 1; k <= numLocalCols_; k++) {
     int gc = indxl2g_( &k, &blockSizeCols_, &myBlacsCol_, &iZero, &numBlacsCols_ );
-    x.push_back(gc);
+    x.push_back(gc - 1);
   }
   return x;
 }
 
 template <typename T>
 ParallelMatrix<T>& ParallelMatrix<T>::operator*=(const T& that) {
+  eigendecomposition_.reset();
   for (size_t i = 0; i < numLocalElements_; i++) {
     *(mat + i) *= that;
   }
@@ -618,6 +913,7 @@ ParallelMatrix<T>& ParallelMatrix<T>::operator*=(const T& that) {
 
 template <typename T>
 ParallelMatrix<T>& ParallelMatrix<T>::operator/=(const T& that) {
+  eigendecomposition_.reset();
   for (size_t i = 0; i < numLocalElements_; i++) {
     *(mat + i) /= that;
   }
@@ -629,6 +925,7 @@ ParallelMatrix<T>& ParallelMatrix<T>::operator+=(const ParallelMatrix<T>& that)
   if(numRows_ != that.rows() || numCols_ != that.cols()) {
     Error("Cannot adds matrices of different sizes.");
   }
+  eigendecomposition_.reset();
   for (size_t i = 0; i < numLocalElements_; i++) {
     *(mat + i) += *(that.mat + i);
   }
@@ -640,6 +937,7 @@ ParallelMatrix<T>& ParallelMatrix<T>::operator-=(const ParallelMatrix<T>& that)
   if(numRows_ != that.rows() || numCols_ != that.cols()) {
     Error("Cannot subtract matrices of different sizes.");
   }
+  eigendecomposition_.reset();
   for (size_t i = 0; i < numLocalElements_; i++) {
     *(mat + i) -= *(that.mat + i);
   }
@@ -651,19 +949,120 @@ void ParallelMatrix<T>::eye() {
   if (numRows_ != numCols_) {
     Error("Cannot build an identity matrix with non-square matrix");
   }
+  eigendecomposition_.reset();
   for (size_t i = 0; i < numLocalElements_; i++) {
     *(mat + i) = 0.;
   }
-  for (int i = 0; i < numRows_; i++) {
-    operator()(i, i) = 1.;
+  forEachLocalDiagonal([&](const int64_t& k, const int&) { mat[k] = 1.; });
+}
+
+template <typename T>
+template <typename F>
+void ParallelMatrix<T>::forEachLocalDiagonal(F&& f) const {
+  int64_t n = std::min(numRows_, numCols_);
+  int64_t mb = blockSizeRows_;
+  int64_t nb = blockSizeCols_;
+  int64_t lld = descMat_[8];
+  // the row blocks of this process row and, within each one, the column
+  // blocks of this process column that cross the diagonal
+  for (int64_t rowBlock = myBlacsRow_; rowBlock * mb < n;
+       rowBlock += numBlacsRows_) {
+    int64_t rowStart = rowBlock * mb;
+    int64_t rowEnd = std::min(rowStart + mb, n);
+    int64_t localRow = rowBlock / numBlacsRows_ * mb - rowStart;
+    for (int64_t colBlock = rowStart / nb; colBlock * nb < rowEnd;
+         colBlock++) {
+      if (colBlock % numBlacsCols_ != myBlacsCol_) continue;
+      int64_t colStart = colBlock * nb;
+      int64_t localCol = colBlock / numBlacsCols_ * nb - colStart;
+      int64_t end = std::min(rowEnd, colStart + nb);
+      for (int64_t i = std::max(rowStart, colStart); i < end; i++) {
+        f((localRow + i) + (localCol + i) * lld, int(i));
+      }
+    }
   }
 }
 
 template <typename T>
 void ParallelMatrix<T>::zeros() {
+  eigendecomposition_.reset();
   for (size_t i = 0; i < numLocalElements_; ++i) *(mat + i) = 0.;
 }
 
+template <typename T>
+void ParallelMatrix<T>::scaleRows(const std::vector<T>& factors) {
+  if (int(factors.size()) != numRows_) {
+    Error("scaleRows needs one factor per row");
+  }
+  eigendecomposition_.reset();
+  std::vector<int> localRows = getAllLocalRows();
+  for (int j = 0; j < numLocalCols_; j++) {
+    T* column = mat + size_t(j) * size_t(descMat_[8]);
+    for (int i = 0; i < numLocalRows_; i++) column[i] *= factors[localRows[i]];
+  }
+}
+
+template <typename T>
+void ParallelMatrix<T>::scaleCols(const std::vector<T>& factors) {
+  if (int(factors.size()) != numCols_) {
+    Error("scaleCols needs one factor per column");
+  }
+  eigendecomposition_.reset();
+  std::vector<int> localCols = getAllLocalCols();
+  for (int j = 0; j < numLocalCols_; j++) {
+    T factor = factors[localCols[j]];
+    T* column = mat + size_t(j) * size_t(descMat_[8]);
+    for (int i = 0; i < numLocalRows_; i++) column[i] *= factor;
+  }
+}
+
+template <typename T>
+void ParallelMatrix<T>::addToDiagonal(const std::vector<T>& values) {
+  if (numRows_ != numCols_ || int(values.size()) != numRows_) {
+    Error("addToDiagonal needs a square matrix and one value per row");
+  }
+  eigendecomposition_.reset();
+  forEachLocalDiagonal(
+      [&](const int64_t& k, const int& i) { mat[k] += values[i]; });
+}
+
+template <typename T>
+void ParallelMatrix<T>::addToDiagonal(const T& value) {
+  if (numRows_ != numCols_) {
+    Error("addToDiagonal needs a square matrix");
+  }
+  eigendecomposition_.reset();
+  forEachLocalDiagonal([&](const int64_t& k, const int&) { mat[k] += value; });
+}
+
+template <typename T>
+std::vector<T> ParallelMatrix<T>::getDiagonal() const {
+  if (numRows_ != numCols_) {
+    Error("getDiagonal needs a square matrix");
+  }
+  std::vector<T> diagonal(numRows_, T(0.));
+  forEachLocalDiagonal(
+      [&](const int64_t& k, const int& i) { diagonal[i] = mat[k]; });
+  mpi->allReduceSum(&diagonal);
+  return diagonal;
+}
+
+template <typename T>
+T ParallelMatrix<T>::trace() const {
+  if (numRows_ != numCols_) {
+    Error("trace needs a square matrix");
+  }
+  T sum = T(0.);
+  forEachLocalDiagonal([&](const int64_t& k, const int&) { sum += mat[k]; });
+  mpi->allReduceSum(&sum);
+  return sum;
+}
+
+template <typename T>
+void ParallelMatrix<T>::clearEigendecomposition() {
+  eigendecomposition_.reset();
+}
+
 template <typename T>
 T ParallelMatrix<T>::squaredNorm() {
   return dot(*this);
@@ -693,9 +1092,241 @@ ParallelMatrix<T> ParallelMatrix<T>::operator-() const {
   }
   return result;
 }
+template <typename T>
+template <typename U>
+ParallelMatrix<U> ParallelMatrix<T>::cast() const {
+  ParallelMatrix<U> result(numRows_, numCols_, numBlocksRows_, numBlocksCols_,
+                           blacsContext_);
+  for (size_t i = 0; i < numLocalElements_; i++) {
+    *(result.mat + i) = static_cast<U>(*(mat + i));
+  }
+  return result;
+}
+
+// single precision type used by diagonalizeMixedPrecision
+template <typename T>
+struct lowerPrecision {};
+template <>
+struct lowerPrecision<double> { using type = float; };
+template <>
+struct lowerPrecision<std::complex<double>> {
+  using type = std::complex<float>;
+};
+
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+ParallelMatrix<T>::diagonalizeMixedPrecision(const int& maxRefinements) {
+
+  if (numRows_ != numCols_) {
+    Error("Cannot diagonalize non-square matrix");
+  }
+  int n = numRows_;
+
+  // diagonalize in single precision. The copy is overwritten by scalapack,
+  // this matrix is left untouched for the refinement.
+  auto lowPrecision = cast<typename lowerPrecision<T>::type>();
+  auto [eigenvalues, lowEigenvectors] = lowPrecision.diagonalize();
+  ParallelMatrix<T> x = lowEigenvectors.template cast<T>();
+
+  // spectral norm of A, to scale the threshold for clustered eigenvalues
+  double normA = 0.;
+  for (double e : eigenvalues) normA = std::max(normA, std::abs(e));
+
+  // Refinement of Ogita and Aishima (Japan J. Indust. Appl. Math. 35, 2018).
+  // With R = I - X^H X and S = X^H A X, the eigenvalues are estimated as
+  // s_ii / (1 - r_ii), and X is corrected as X + X E, with
+  // E_ij = (s_ij + lambda_j r_ij) / (lambda_j - lambda_i) for separated
+  // eigenvalues and E_ij = r_ij / 2 within a cluster.
+  for (int iter = 0; iter < maxRefinements; iter++) {
+    RegionTimer timer("eigenpair refinement");
+
+    ParallelMatrix<T> ax = prod(x);
+    ParallelMatrix<T> s = x.prod(ax, transC, transN);
+    ParallelMatrix<T> r = x.prod(x, transC, transN);
+
+    std::vector<double> sDiagonal(n, 0.), rDiagonal(n, 0.);
+    for (size_t k = 0; k < numLocalElements_; k++) {
+      auto [i, j] = local2Global(k);
+      *(r.mat + k) = (i == j ? T(1.) : T(0.)) - *(r.mat + k);
+      if (i == j) {
+        sDiagonal[i] = std::real(*(s.mat + k));
+        rDiagonal[i] = std::real(*(r.mat + k));
+      }
+    }
+    mpi->allReduceSum(&sDiagonal);
+    mpi->allReduceSum(&rDiagonal);
+    for (int i = 0; i < n; i++) {
+      eigenvalues[i] = sDiagonal[i] / (1. - rDiagonal[i]);
+    }
+
+    // eigenvalues closer than delta are treated as a cluster
+    double norms[2] = {0., 0.};  // |S - diag(lambda)|^2, |R|^2
+    for (size_t k = 0; k < numLocalElements_; k++) {
+      auto [i, j] = local2Global(k);
+      T offDiagonal = *(s.mat + k) - (i == j ? T(eigenvalues[i]) : T(0.));
+      norms[0] += std::norm(offDiagonal);
+      norms[1] += std::norm(*(r.mat + k));
+    }
+    mpi->allReduceSum(&norms[0]);
+    mpi->allReduceSum(&norms[1]);
+    double delta = 2. * (sqrt(norms[0]) + normA * sqrt(norms[1]));
+
+    // the correction E overwrites S
+    double correctionNorm = 0.;
+    for (size_t k = 0; k < numLocalElements_; k++) {
+      auto [i, j] = local2Global(k);
+      T e;
+      if (i != j && std::abs(eigenvalues[j] - eigenvalues[i]) > delta) {
+        e = (*(s.mat + k) + T(eigenvalues[j]) * *(r.mat + k)) /
+            T(eigenvalues[j] - eigenvalues[i]);
+      } else {
+        e = *(r.mat + k) / T(2.);
+      }
+      *(s.mat + k) = e;
+      correctionNorm += std::norm(e);
+    }
+    mpi->allReduceSum(&correctionNorm);
+    x += x.prod(s);
+
+    // converged to double precision
+    if (sqrt(correctionNorm) < n * std::numeric_limits<double>::epsilon()) {
+      break;
+    }
+  }
+  return std::make_tuple(eigenvalues, x);
+}
+
+template <typename T>
+void ParallelMatrix<T>::checkLinearSystem(const ParallelMatrix<T>& rhs) const {
+  if (numRows_ != numCols_) {
+    Error("Cannot solve a linear system with a non-square matrix");
+  }
+  if (blockSizeRows_ != blockSizeCols_) {
+    Error("Linear solves need a matrix distributed in square blocks");
+  }
+  if (rhs.numRows_ != numRows_ || rhs.blockSizeRows_ != blockSizeRows_) {
+    Error("The right hand side must have the rows and row blocks of the matrix");
+  }
+  if (rhs.blacsContext_ != blacsContext_) {
+    Error("The right hand side must share the blacs context of the matrix");
+  }
+}
+
+template <typename T>
+ParallelMatrix<T> ParallelMatrix<T>::solve(const ParallelMatrix<T>& rhs) {
+  checkLinearSystem(rhs);
+  // the factorization overwrites the matrix
+  ParallelMatrix<T> lu = *this;
+  std::vector<blacsInt> pivots;
+  if (lu.factorizeLU(pivots) != 0) {
+    Error("Cannot solve a linear system with a singular matrix");
+  }
+  ParallelMatrix<T> x = rhs;
+  lu.solveLU(pivots, x);
+  return x;
+}
+
+template <typename T>
+ParallelMatrix<T> ParallelMatrix<T>::solveMixedPrecision(
+    const ParallelMatrix<T>& rhs, int* numIterations,
+    const int& maxIterations) {
+  using LowT = typename lowerPrecision<T>::type;
+  checkLinearSystem(rhs);
+
+  // Frobenius norm, as the matrix norm() doesn't conjugate complex numbers
+  auto frobeniusNorm = [](const ParallelMatrix<T>& m) {
+    double norm = 0.;
+    for (size_t i = 0; i < m.numLocalElements_; i++) {
+      norm += std::norm(*(m.mat + i));
+    }
+    mpi->allReduceSum(&norm);
+    return sqrt(norm);
+  };
+
+  // stopping criterion of LAPACK's dsgesv:
+  // |r| < |x| |A| eps sqrt(n), here with Frobenius norms
+  double tolerance = frobeniusNorm(*this) *
+                     std::numeric_limits<double>::epsilon() * sqrt(numRows_);
+
+  ParallelMatrix<LowT> lu = cast<LowT>();
+  std::vector<blacsInt> pivots;
+  bool converged = false;
+  ParallelMatrix<T> x;
+
+  // a matrix which is singular in single precision goes to the fallback
+  if (lu.factorizeLU(pivots) == 0) {
+    ParallelMatrix<LowT> correction = rhs.template cast<LowT>();
+    lu.solveLU(pivots, correction);
+    x = correction.template cast<T>();
+
+    double previousResidual = std::numeric_limits<double>::max();
+    for (int iter = 0; iter < maxIterations; iter++) {
+      RegionTimer timer("solve refinement");
+      // residual in double precision
+      ParallelMatrix<T> residual = rhs;
+      residual -= prod(x);
+      double residualNorm = frobeniusNorm(residual);
+      if (residualNorm < frobeniusNorm(x) * tolerance) {
+        converged = true;
+        if (numIterations != nullptr) *numIterations = iter;
+        break;
+      }
+      // the residual must at least halve at each step, or the refinement
+      // has stalled (it also catches NaNs)
+      if (!(residualNorm < 0.5 * previousResidual)) break;
+      previousResidual = residualNorm;
+
+      correction = residual.template cast<LowT>();
+      lu.solveLU(pivots, correction);
+      x += correction.template cast<T>();
+    }
+  }
+  if (converged) return x;
+
+  // fall back to the double precision solution
+  if (mpi->mpiHead()) {
+    std::cout << "Mixed precision refinement did not converge, "
+                 "solving in double precision." << std::endl;
+  }
+  if (numIterations != nullptr) *numIterations = -1;
+  return solve(rhs);
+}
+
 // function to make sure two matrices share a blacs context...
 template <typename T>
 void ParallelMatrix<T>::setBlacsContext(int blacsContext) {
   blacsContext_ = blacsContext;
 }
 
+template <typename T>
+ParallelMatrix<T> ParallelMatrix<T>::newBlock(const int& numCols) const {
+  return ParallelMatrix<T>(numRows_, numCols, numBlocksRows_, 0,
+                           blacsContext_);
+}
+
+template <typename T>
+Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>
+ParallelMatrix<T>::toEigen() const {
+  Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic> result =
+      Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>::Zero(numRows_,
+                                                            numCols_);
+  for (size_t k = 0; k < numLocalElements_; k++) {
+    auto [i, j] = local2Global(int64_t(k));
+    result(i, j) = *(mat + k);
+  }
+  mpi->allReduceSum(&result);
+  return result;
+}
+
+template <typename T>
+void ParallelMatrix<T>::fromEigen(
+    const Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>& that) {
+  if (that.rows() != numRows_ || that.cols() != numCols_) {
+    Error("fromEigen needs a matrix of the same size.");
+  }
+  eigendecomposition_.reset();
+  for (size_t k = 0; k < numLocalElements_; k++) {
+    auto [i, j] = local2Global(int64_t(k));
+    *(mat + k) = that(i, j);
+  }
+}
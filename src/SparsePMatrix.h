@@ -0,0 +1,539 @@
+#pragma once
+
+#include <Eigen/Core>
+#include <algorithm>
+#include <complex>
+#include <tuple>
+#include <vector>
+#include "PMatrix.h"
+
+/** Class for a sparse matrix, MPI-distributed by rows.
+ *
+ * Each MPI process owns the contiguous range of rows given by
+ * mpi->divideWork(numRows), stored in compressed sparse row (CSR) format
+ * with global column indices. Blocks of vectors multiplied by the matrix
+ * are distributed in the same way, by rows, with the ranges given by
+ * mpi->divideWork(numCols). Before a product, each process receives the
+ * rows of the vectors that its nonzeros reference but other processes own
+ * (the halo), with a single allToAllv whose pattern is set up once, when
+ * the matrix is assembled.
+ *
+ * Conversions to and from the block-cyclic ParallelMatrix send every
+ * element directly to the process that owns it in the other layout.
+ */
+template <typename T>
+class SparseParallelMatrix {
+ public:
+  // (row, column, value) of a nonzero element
+  using Triplet = std::tuple<int, int, T>;
+  // local rows of a block of vectors, one vector per column
+  using Block = Eigen::Matrix<T, Eigen::Dynamic, Eigen::Dynamic>;
+
+ private:
+  int numRows_ = 0;
+  int numCols_ = 0;
+  // first row and number of rows of the matrix owned by each MPI process,
+  // rowStarts_[r] for process r, and rowStarts_[numProcs] = numRows_
+  std::vector<int> rowStarts_;
+  // same for the rows of the vectors, which are the columns of the matrix
+  std::vector<int> colStarts_;
+  int firstRow_ = 0;
+  int numLocalRows_ = 0;
+  int firstCol_ = 0;
+  int numLocalCols_ = 0;
+
+  // CSR storage of the local rows: the nonzeros of local row i are
+  // values_[p] at column colIndices_[p], for rowPointers_[i] <= p <
+  // rowPointers_[i+1]
+  std::vector<size_t> rowPointers_;
+  std::vector<int> colIndices_;
+  std::vector<T> values_;
+
+  // halo exchange pattern: the global indices of the vector rows received
+  // (sorted, hence grouped by owner) with their count from each process,
+  // and the local indices of the vector rows sent with their count to
+  // each process
+  std::vector<int> haloRows_;
+  std::vector<int> haloCounts_;
+  std::vector<int> sendRows_;
+  std::vector<int> sendCounts_;
+  // column of each nonzero in the local vector rows followed by the halo
+  std::vector<int> localColIndices_;
+
+  /** Returns the MPI process owning index, given the starts of the ranges.
+   */
+  static int owner(const std::vector<int>& starts, const int& index) {
+    return int(std::upper_bound(starts.begin(), starts.end(), index) -
+               starts.begin()) - 1;
+  }
+
+  /** Computes the row ranges of all the processes from divideWork.
+   */
+  static std::vector<int> partition(const int& numTasks);
+
+  /** Sets up haloRows_, sendRows_ and localColIndices_ from the nonzeros.
+   */
+  void initHalo();
+
+  size_t trackedBytes() const {
+    return values_.size() * sizeof(T) + colIndices_.size() * sizeof(int) +
+           localColIndices_.size() * sizeof(int);
+  }
+
+  /** Collects the local rows of a block-cyclic matrix with numCols_ rows.
+   */
+  Block rowsFromParallelMatrix(const ParallelMatrix<T>& that) const;
+
+  /** Sends elements to the process owning them in the block-cyclic
+   * layout of result, and writes them there.
+   * @param indices: global (row, col) of the elements, two ints each.
+   * @param values: the element values.
+   */
+  static void sendToParallelMatrix(const std::vector<int>& indices,
+                                   const std::vector<T>& values,
+                                   ParallelMatrix<T>& result);
+
+ public:
+  /** Assembles the matrix from triplets, as Eigen::setFromTriplets:
+   * duplicate elements are summed. Each process may provide any triplets,
+   * which are sent to the owner of their row. Must be called by all
+   * processes.
+   */
+  SparseParallelMatrix(const int& numRows, const int& numCols,
+                       const std::vector<Triplet>& triplets);
+
+  /** Copy constructor
+   */
+  SparseParallelMatrix(const SparseParallelMatrix<T>& that);
+
+  /** Copy assignment
+   */
+  SparseParallelMatrix& operator=(const SparseParallelMatrix<T>& that);
+
+  ~SparseParallelMatrix();
+
+  /** Find global number of rows and columns
+   */
+  int rows() const { return numRows_; }
+  int cols() const { return numCols_; }
+
+  /** Range of matrix rows owned by this MPI process.
+   */
+  int firstLocalRow() const { return firstRow_; }
+  int localRows() const { return numLocalRows_; }
+
+  /** Range of vector rows (matrix columns) owned by this MPI process,
+   * i.e. the rows of the blocks passed to prod().
+   */
+  int firstLocalCol() const { return firstCol_; }
+  int localCols() const { return numLocalCols_; }
+
+  /** Number of nonzeros stored by this MPI process, and in total.
+   */
+  size_t localNonzeros() const { return values_.size(); }
+  size_t numNonzeros() const;
+
+  /** Sparse matrix - dense block product Y = A X (SpMV for one column).
+   * @param x: local rows of X, localCols() x k.
+   * @return y: local rows of Y, localRows() x k.
+   */
+  Block prod(const Block& x) const;
+
+  /** Sparse matrix - dense matrix product with a block-cyclic X, of
+   * numCols rows. X is redistributed by rows, and the product is returned
+   * on the context and with the column blocking of X.
+   */
+  ParallelMatrix<T> prod(const ParallelMatrix<T>& x) const;
+
+  /** Expands the matrix into a dense ParallelMatrix, with arguments as for
+   * the ParallelMatrix constructor. Must be called by all processes.
+   */
+  ParallelMatrix<T> toParallelMatrix(const int& numBlocksRows = 0,
+                                     const int& numBlocksCols = 0,
+                                     const int& blacsContext = -1) const;
+};
+
+template <typename T>
+std::vector<int> SparseParallelMatrix<T>::partition(const int& numTasks) {
+  std::vector<size_t> divs = mpi->divideWork(numTasks);
+  std::vector<size_t> starts(mpi->getSize());
+  mpi->allGather(&divs[0], &starts);
+  std::vector<int> result(starts.begin(), starts.end());
+  result.push_back(numTasks);
+  return result;
+}
+
+template <typename T>
+SparseParallelMatrix<T>::SparseParallelMatrix(
+    const int& numRows, const int& numCols,
+    const std::vector<Triplet>& triplets)
+    : numRows_(numRows), numCols_(numCols) {
+  int rank = mpi->getRank();
+  int numProcs = mpi->getSize();
+  rowStarts_ = partition(numRows_);
+  colStarts_ = partition(numCols_);
+  firstRow_ = rowStarts_[rank];
+  numLocalRows_ = rowStarts_[rank + 1] - firstRow_;
+  firstCol_ = colStarts_[rank];
+  numLocalCols_ = colStarts_[rank + 1] - firstCol_;
+
+  // send each triplet to the owner of its row
+  std::vector<int> sendCounts(numProcs, 0);
+  for (auto [row, col, value] : triplets) {
+    if (row < 0 || row >= numRows_ || col < 0 || col >= numCols_) {
+      Error("Element " + std::to_string(row) + " " + std::to_string(col) +
+            " is outside of the sparse matrix.");
+    }
+    sendCounts[owner(rowStarts_, row)]++;
+  }
+  std::vector<int> offsets(numProcs, 0);
+  for (int r = 1; r < numProcs; r++) {
+    offsets[r] = offsets[r - 1] + sendCounts[r - 1];
+  }
+  std::vector<int> sendIndices(2 * triplets.size());
+  std::vector<T> sendValues(triplets.size());
+  for (auto [row, col, value] : triplets) {
+    int position = offsets[owner(rowStarts_, row)]++;
+    sendIndices[2 * position] = row;
+    sendIndices[2 * position + 1] = col;
+    sendValues[position] = value;
+  }
+  std::vector<int> ones(numProcs, 1);
+  std::vector<int> receiveCounts(numProcs);
+  mpi->allToAllv(&sendCounts, ones, &receiveCounts, ones);
+  int numReceived = 0;
+  for (int count : receiveCounts) numReceived += count;
+  std::vector<int> receiveIndices(2 * numReceived);
+  std::vector<T> receiveValues(numReceived);
+  mpi->allToAllv(&sendValues, sendCounts, &receiveValues, receiveCounts);
+  for (int r = 0; r < numProcs; r++) {
+    sendCounts[r] *= 2;
+    receiveCounts[r] *= 2;
+  }
+  mpi->allToAllv(&sendIndices, sendCounts, &receiveIndices, receiveCounts);
+
+  // sort by row and column, and sum the duplicates
+  std::vector<int> order(numReceived);
+  for (int t = 0; t < numReceived; t++) order[t] = t;
+  std::sort(order.begin(), order.end(), [&](const int& a, const int& b) {
+    return std::make_tuple(receiveIndices[2 * a], receiveIndices[2 * a + 1]) <
+           std::make_tuple(receiveIndices[2 * b], receiveIndices[2 * b + 1]);
+  });
+  rowPointers_.assign(numLocalRows_ + 1, 0);
+  int lastRow = -1, lastCol = -1;
+  for (int t : order) {
+    int row = receiveIndices[2 * t];
+    int col = receiveIndices[2 * t + 1];
+    if (row == lastRow && col == lastCol) {
+      values_.back() += receiveValues[t];
+      continue;
+    }
+    colIndices_.push_back(col);
+    values_.push_back(receiveValues[t]);
+    rowPointers_[row - firstRow_ + 1] = colIndices_.size();
+    lastRow = row;
+    lastCol = col;
+  }
+  // rows without nonzeros end where the previous row ends
+  for (int i = 0; i < numLocalRows_; i++) {
+    rowPointers_[i + 1] = std::max(rowPointers_[i + 1], rowPointers_[i]);
+  }
+  initHalo();
+  trackMemory("SparseParallelMatrix", trackedBytes());
+}
+
+template <typename T>
+void SparseParallelMatrix<T>::initHalo() {
+  int numProcs = mpi->getSize();
+  haloRows_.clear();
+  for (int col : colIndices_) {
+    if (col < firstCol_ || col >= firstCol_ + numLocalCols_) {
+      haloRows_.push_back(col);
+    }
+  }
+  std::sort(haloRows_.begin(), haloRows_.end());
+  haloRows_.erase(std::unique(haloRows_.begin(), haloRows_.end()),
+                  haloRows_.end());
+  haloCounts_.assign(numProcs, 0);
+  for (int row : haloRows_) haloCounts_[owner(colStarts_, row)]++;
+
+  // tell the owners which of their rows are needed here
+  std::vector<int> ones(numProcs, 1);
+  sendCounts_.assign(numProcs, 0);
+  mpi->allToAllv(&haloCounts_, ones, &sendCounts_, ones);
+  int numSent = 0;
+  for (int count : sendCounts_) numSent += count;
+  sendRows_.assign(numSent, 0);
+  mpi->allToAllv(&haloRows_, haloCounts_, &sendRows_, sendCounts_);
+  for (int& row : sendRows_) row -= firstCol_;
+
+  localColIndices_.resize(colIndices_.size());
+  for (size_t p = 0; p < colIndices_.size(); p++) {
+    int col = colIndices_[p];
+    if (col >= firstCol_ && col < firstCol_ + numLocalCols_) {
+      localColIndices_[p] = col - firstCol_;
+    } else {
+      localColIndices_[p] = numLocalCols_ + int(std::lower_bound(
+          haloRows_.begin(), haloRows_.end(), col) - haloRows_.begin());
+    }
+  }
+}
+
+template <typename T>
+SparseParallelMatrix<T>::SparseParallelMatrix(
+    const SparseParallelMatrix<T>& that)
+    : numRows_(that.numRows_), numCols_(that.numCols_),
+      rowStarts_(that.rowStarts_), colStarts_(that.colStarts_),
+      firstRow_(that.firstRow_), numLocalRows_(that.numLocalRows_),
+      firstCol_(that.firstCol_), numLocalCols_(that.numLocalCols_),
+      rowPointers_(that.rowPointers_), colIndices_(that.colIndices_),
+      values_(that.values_), haloRows_(that.haloRows_),
+      haloCounts_(that.haloCounts_), sendRows_(that.sendRows_),
+      sendCounts_(that.sendCounts_), localColIndices_(that.localColIndices_) {
+  trackMemory("SparseParallelMatrix", trackedBytes());
+}
+
+template <typename T>
+SparseParallelMatrix<T>& SparseParallelMatrix<T>::operator=(
+    const SparseParallelMatrix<T>& that) {
+  if (this != &that) {
+    trackMemory("SparseParallelMatrix", -long(trackedBytes()));
+    numRows_ = that.numRows_;
+    numCols_ = that.numCols_;
+    rowStarts_ = that.rowStarts_;
+    colStarts_ = that.colStarts_;
+    firstRow_ = that.firstRow_;
+    numLocalRows_ = that.numLocalRows_;
+    firstCol_ = that.firstCol_;
+    numLocalCols_ = that.numLocalCols_;
+    rowPointers_ = that.rowPointers_;
+    colIndices_ = that.colIndices_;
+    values_ = that.values_;
+    haloRows_ = that.haloRows_;
+    haloCounts_ = that.haloCounts_;
+    sendRows_ = that.sendRows_;
+    sendCounts_ = that.sendCounts_;
+    localColIndices_ = that.localColIndices_;
+    trackMemory("SparseParallelMatrix", trackedBytes());
+  }
+  return *this;
+}
+
+template <typename T>
+SparseParallelMatrix<T>::~SparseParallelMatrix() {
+  trackMemory("SparseParallelMatrix", -long(trackedBytes()));
+}
+
+template <typename T>
+size_t SparseParallelMatrix<T>::numNonzeros() const {
+  size_t count = values_.size();
+  size_t countOut = 0;
+  mpi->allReduceSum(&count, &countOut);
+  return countOut;
+}
+
+template <typename T>
+typename SparseParallelMatrix<T>::Block SparseParallelMatrix<T>::prod(
+    const Block& x) const {
+  if (x.rows() != numLocalCols_) {
+    Error("The block multiplied by a sparse matrix must hold the local "
+          "rows given by localCols().");
+  }
+  int k = int(x.cols());
+  int numProcs = mpi->getSize();
+
+  // halo exchange, k values per vector row
+  std::vector<T> sendBuffer(sendRows_.size() * k);
+  for (size_t s = 0; s < sendRows_.size(); s++) {
+    for (int c = 0; c < k; c++) {
+      sendBuffer[s * k + c] = x(sendRows_[s], c);
+    }
+  }
+  std::vector<int> sendCounts(numProcs), receiveCounts(numProcs);
+  for (int r = 0; r < numProcs; r++) {
+    sendCounts[r] = sendCounts_[r] * k;
+    receiveCounts[r] = haloCounts_[r] * k;
+  }
+  std::vector<T> halo(haloRows_.size() * k);
+  mpi->allToAllv(&sendBuffer, sendCounts, &halo, receiveCounts);
+
+  // one multiply-add per nonzero and vector
+  RegionTimer timer("spmm", flopsGemm<T>(values_.size(), k, 1));
+  Block y = Block::Zero(numLocalRows_, k);
+  for (int c = 0; c < k; c++) {
+    const T* xColumn = x.data() + size_t(c) * numLocalCols_;
+    for (int i = 0; i < numLocalRows_; i++) {
+      T sum = 0.;
+      for (size_t p = rowPointers_[i]; p < rowPointers_[i + 1]; p++) {
+        int j = localColIndices_[p];
+        sum += values_[p] * (j < numLocalCols_
+            ? xColumn[j] : halo[size_t(j - numLocalCols_) * k + c]);
+      }
+      y(i, c) = sum;
+    }
+  }
+  return y;
+}
+
+template <typename T>
+typename SparseParallelMatrix<T>::Block
+SparseParallelMatrix<T>::rowsFromParallelMatrix(
+    const ParallelMatrix<T>& that) const {
+  int numProcs = mpi->getSize();
+  int nb = that.blockSizeRows_;
+  int mb = that.blockSizeCols_;
+  size_t lld = that.descMat_[8];
+
+  // send each local element of that to the owner of its row
+  std::vector<int> sendCounts(numProcs, 0);
+  std::vector<int> rows(that.numLocalRows_), cols(that.numLocalCols_);
+  for (int i = 0; i < that.numLocalRows_; i++) {
+    rows[i] = ((i / nb) * that.numBlacsRows_ + that.myBlacsRow_) * nb + i % nb;
+    sendCounts[owner(colStarts_, rows[i])] += that.numLocalCols_;
+  }
+  for (int j = 0; j < that.numLocalCols_; j++) {
+    cols[j] = ((j / mb) * that.numBlacsCols_ + that.myBlacsCol_) * mb + j % mb;
+  }
+  std::vector<int> offsets(numProcs, 0);
+  for (int r = 1; r < numProcs; r++) {
+    offsets[r] = offsets[r - 1] + sendCounts[r - 1];
+  }
+  std::vector<int> sendIndices(2 * that.numLocalElements_);
+  std::vector<T> sendValues(that.numLocalElements_);
+  for (int j = 0; j < that.numLocalCols_; j++) {
+    for (int i = 0; i < that.numLocalRows_; i++) {
+      int position = offsets[owner(colStarts_, rows[i])]++;
+      sendIndices[2 * position] = rows[i];
+      sendIndices[2 * position + 1] = cols[j];
+      sendValues[position] = that.mat[j * lld + i];
+    }
+  }
+
+  std::vector<int> ones(numProcs, 1);
+  std::vector<int> receiveCounts(numProcs);
+  mpi->allToAllv(&sendCounts, ones, &receiveCounts, ones);
+  int numReceived = 0;
+  for (int count : receiveCounts) numReceived += count;
+  std::vector<T> receiveValues(numReceived);
+  mpi->allToAllv(&sendValues, sendCounts, &receiveValues, receiveCounts);
+  for (int r = 0; r < numProcs; r++) {
+    sendCounts[r] *= 2;
+    receiveCounts[r] *= 2;
+  }
+  std::vector<int> receiveIndices(2 * numReceived);
+  mpi->allToAllv(&sendIndices, sendCounts, &receiveIndices, receiveCounts);
+
+  Block x(numLocalCols_, that.numCols_);
+  for (int t = 0; t < numReceived; t++) {
+    x(receiveIndices[2 * t] - firstCol_, receiveIndices[2 * t + 1]) =
+        receiveValues[t];
+  }
+  return x;
+}
+
+template <typename T>
+void SparseParallelMatrix<T>::sendToParallelMatrix(
+    const std::vector<int>& indices, const std::vector<T>& values,
+    ParallelMatrix<T>& result) {
+  int numProcs = mpi->getSize();
+  blacsInt nb = result.blockSizeRows_;
+  blacsInt mb = result.blockSizeCols_;
+  blacsInt numBlacsRows = result.numBlacsRows_;
+  blacsInt numBlacsCols = result.numBlacsCols_;
+
+  // MPI rank of each process of the grid
+  std::vector<int> ranks(numBlacsRows * numBlacsCols);
+  for (blacsInt pRow = 0; pRow < numBlacsRows; pRow++) {
+    for (blacsInt pCol = 0; pCol < numBlacsCols; pCol++) {
+      ranks[pRow * numBlacsCols + pCol] =
+          blacs_pnum_(&result.blacsContext_, &pRow, &pCol);
+    }
+  }
+  auto ownerOf = [&](const int& row, const int& col) {
+    return ranks[((row / nb) % numBlacsRows) * numBlacsCols +
+                 (col / mb) % numBlacsCols];
+  };
+
+  size_t numElements = values.size();
+  std::vector<int> sendCounts(numProcs, 0);
+  for (size_t t = 0; t < numElements; t++) {
+    sendCounts[ownerOf(indices[2 * t], indices[2 * t + 1])]++;
+  }
+  std::vector<int> offsets(numProcs, 0);
+  for (int r = 1; r < numProcs; r++) {
+    offsets[r] = offsets[r - 1] + sendCounts[r - 1];
+  }
+  std::vector<int> sendIndices(2 * numElements);
+  std::vector<T> sendValues(numElements);
+  for (size_t t = 0; t < numElements; t++) {
+    int position = offsets[ownerOf(indices[2 * t], indices[2 * t + 1])]++;
+    sendIndices[2 * position] = indices[2 * t];
+    sendIndices[2 * position + 1] = indices[2 * t + 1];
+    sendValues[position] = values[t];
+  }
+
+  std::vector<int> ones(numProcs, 1);
+  std::vector<int> receiveCounts(numProcs);
+  mpi->allToAllv(&sendCounts, ones, &receiveCounts, ones);
+  int numReceived = 0;
+  for (int count : receiveCounts) numReceived += count;
+  std::vector<T> receiveValues(numReceived);
+  mpi->allToAllv(&sendValues, sendCounts, &receiveValues, receiveCounts);
+  for (int r = 0; r < numProcs; r++) {
+    sendCounts[r] *= 2;
+    receiveCounts[r] *= 2;
+  }
+  std::vector<int> receiveIndices(2 * numReceived);
+  mpi->allToAllv(&sendIndices, sendCounts, &receiveIndices, receiveCounts);
+
+  // local position of the received elements in the block-cyclic layout
+  size_t lld = result.descMat_[8];
+  for (int t = 0; t < numReceived; t++) {
+    int row = receiveIndices[2 * t];
+    int col = receiveIndices[2 * t + 1];
+    size_t i = size_t(row / (nb * numBlacsRows)) * nb + row % nb;
+    size_t j = size_t(col / (mb * numBlacsCols)) * mb + col % mb;
+    result.mat[j * lld + i] = receiveValues[t];
+  }
+}
+
+template <typename T>
+ParallelMatrix<T> SparseParallelMatrix<T>::prod(
+    const ParallelMatrix<T>& x) const {
+  if (x.numRows_ != numCols_) {
+    Error("Cannot multiply matrices for which lhs.cols != rhs.rows.");
+  }
+  Block y = prod(rowsFromParallelMatrix(x));
+
+  ParallelMatrix<T> result(numRows_, x.numCols_, x.numBlocksRows_,
+                           x.numBlocksCols_, x.blacsContext_);
+  std::vector<int> indices(2 * y.size());
+  std::vector<T> values(y.size());
+  size_t t = 0;
+  for (int c = 0; c < y.cols(); c++) {
+    for (int i = 0; i < numLocalRows_; i++) {
+      indices[2 * t] = firstRow_ + i;
+      indices[2 * t + 1] = c;
+      values[t++] = y(i, c);
+    }
+  }
+  sendToParallelMatrix(indices, values, result);
+  return result;
+}
+
+template <typename T>
+ParallelMatrix<T> SparseParallelMatrix<T>::toParallelMatrix(
+    const int& numBlocksRows, const int& numBlocksCols,
+    const int& blacsContext) const {
+  ParallelMatrix<T> result(numRows_, numCols_, numBlocksRows, numBlocksCols,
+                           blacsContext);
+  std::vector<int> indices(2 * values_.size());
+  for (int i = 0; i < numLocalRows_; i++) {
+    for (size_t p = rowPointers_[i]; p < rowPointers_[i + 1]; p++) {
+      indices[2 * p] = firstRow_ + i;
+      indices[2 * p + 1] = colIndices_[p];
+    }
+  }
+  sendToParallelMatrix(indices, values_, result);
+  return result;
+}
@@ -0,0 +1,514 @@
+#pragma once
+
+#include <cmath>
+#include <complex>
+#include <vector>
+#include "PMatrix.h"
+#include "scalapackTraits.h"
+
+/** Class for a real-symmetric or complex-hermitian matrix, MPI-distributed
+ * like a square ParallelMatrix with square blocks, which only stores the
+ * blocks intersecting the upper triangle.
+ *
+ * As with uplo = 'U' in scalapack, elements below the diagonal are never
+ * referenced and are implied by symmetry. Locally, column j keeps the
+ * leading local rows that belong to blocks on or above the diagonal block
+ * of the column, so that the packed buffer is about half of the dense one.
+ * Blocks on the diagonal are stored whole, their lower part is ignored.
+ *
+ * Element-wise operations, dot and norm work on the packed buffer.
+ * Scalapack calls need the dense matrix, which is expanded just in time
+ * (e.g. diagonalize()) and freed afterwards. The saving is in storage:
+ * the peak memory of diagonalize() is that of ParallelMatrix::diagonalize().
+ */
+template <typename T>
+class SymmetricParallelMatrix {
+ private:
+  int numRows_ = 0;
+  int numBlocks_ = 0;
+  int blockSize_ = 0;
+  int numLocalRows_ = 0;
+  int numLocalCols_ = 0;
+
+  // BLACS process grid, as in ParallelMatrix
+  blacsInt numBlacsRows_ = 0;
+  blacsInt numBlacsCols_ = 0;
+  blacsInt myBlacsRow_ = 0;
+  blacsInt myBlacsCol_ = 0;
+  blacsInt blacsContext_ = 0;
+
+  // packed buffer: local column j stores its first colRows_[j] local rows,
+  // starting at mat[colOffsets_[j]]
+  std::vector<int> colRows_;
+  std::vector<size_t> colOffsets_;
+  std::vector<T> mat;
+
+  // dummy values to return when accessing elements not available locally
+  T dummyZero = 0;
+
+  /** Computes the packed layout of the local columns and allocates the
+   * (zeroed) buffer, once the grid and the blocking are set.
+   */
+  void initLayout();
+
+  /** Converts a local row/column index into the global one, given the
+   * coordinate of this process and the size of the grid along that axis.
+   */
+  int local2Global(const int& i, const blacsInt& myProc,
+                   const blacsInt& numProcs) const;
+
+  /** Returns the position in the packed buffer of the element (row,col),
+   * with row <= col, or -1 if it isn't stored by this MPI process.
+   */
+  int64_t global2Local(const int& row, const int& col) const;
+
+  /** Copies the stored upper triangle into a zeroed dense matrix with the
+   * same distribution, leaving out the diagonal if strictUpper is true.
+   */
+  void copyUpperTo(ParallelMatrix<T>& result, const bool& strictUpper) const;
+
+  /** Diagonalizes the dense expansion, for all the eigenpairs if
+   * numEigenvalues is negative.
+   */
+  std::tuple<std::vector<double>, ParallelMatrix<T>> diagonalizeDense(
+      const int& numEigenvalues);
+
+  /** Errors out if the two matrices don't have the same packed layout.
+   */
+  void checkSameLayout(const SymmetricParallelMatrix<T>& that) const;
+
+  static T conjugate(const T& x) {
+    if constexpr (isComplex<T>::value) {
+      return std::conj(x);
+    } else {
+      return x;
+    }
+  }
+
+ public:
+  /** Constructor of a zero matrix.
+   * @param numRows: global number of matrix rows (and columns).
+   * @param numBlocks: number of blocks along rows and columns, with the
+   * same default as ParallelMatrix (the number of rows of the process grid).
+   * @param blacsContext: blacs context of the process grid, or -1 to
+   * create a default square grid.
+   */
+  SymmetricParallelMatrix(const int& numRows, const int& numBlocks = 0,
+                          const int& blacsContext = -1);
+
+  /** Packs the upper triangle of a dense matrix, which must be square and
+   * distributed with square blocks. The packed matrix uses the same
+   * blacs context and blocking.
+   */
+  explicit SymmetricParallelMatrix(const ParallelMatrix<T>& that);
+
+  /** Copy constructor
+   */
+  SymmetricParallelMatrix(const SymmetricParallelMatrix<T>& that);
+
+  /** Copy assignment
+   */
+  SymmetricParallelMatrix& operator=(const SymmetricParallelMatrix<T>& that);
+
+  ~SymmetricParallelMatrix();
+
+  /** Find global number of rows (equal to the number of columns)
+   */
+  int rows() const { return numRows_; }
+  int cols() const { return numRows_; }
+
+  /** Number of elements stored by this MPI process.
+   */
+  size_t localSize() const { return mat.size(); }
+
+  /** Returns true if the element (row,col), or (col,row) if row > col,
+   * is stored by this MPI process.
+   */
+  bool indicesAreLocal(const int& row, const int& col) const;
+
+  /** Get and set operator, for elements of the upper triangle (row <= col).
+   * Returns a dummy zero if the element isn't stored by this MPI process.
+   */
+  T& operator()(const int& row, const int& col);
+
+  /** Returns any element of the matrix stored by this MPI process,
+   * reading (col,row) for elements below the diagonal, and zero otherwise.
+   */
+  T get(const int& row, const int& col) const;
+
+  /** Expands the matrix into a dense ParallelMatrix, on the same context
+   * and with the same blocking.
+   * @param fullMatrix: if false, only the upper triangle is set, which is
+   * what scalapack reads with uplo = 'U'. If true, the lower triangle is
+   * also filled, at the cost of a distributed transposition from a second
+   * dense buffer.
+   */
+  ParallelMatrix<T> toParallelMatrix(const bool& fullMatrix = false) const;
+
+  /** Diagonalizes the matrix, as ParallelMatrix::diagonalize(): the dense
+   * matrix only lives for the duration of the call, during which the packed
+   * buffer is released. As ParallelMatrix::diagonalize(), it overwrites the
+   * matrix, which is left zero.
+   */
+  std::tuple<std::vector<double>, ParallelMatrix<T>> diagonalize();
+  std::tuple<std::vector<double>, ParallelMatrix<T>> diagonalize(
+      int numEigenvalues);
+
+  /** Matrix-matrix addition and subtraction, with a matrix of the same
+   * size and distribution.
+   */
+  SymmetricParallelMatrix<T>& operator+=(const SymmetricParallelMatrix<T>& that);
+  SymmetricParallelMatrix<T>& operator-=(const SymmetricParallelMatrix<T>& that);
+
+  /** Matrix-scalar multiplication and division.
+   * The scalar should be real to keep a complex matrix hermitian.
+   */
+  SymmetricParallelMatrix<T>& operator*=(const T& that);
+  SymmetricParallelMatrix<T>& operator/=(const T& that);
+
+  /** Computes \sum_ij A_ij * B_ij over the full matrix, as
+   * ParallelMatrix::dot(), from the upper triangles only.
+   */
+  T dot(const SymmetricParallelMatrix<T>& that) const;
+
+  /** Computes the squared Frobenius norm of the matrix, as
+   * ParallelMatrix::squaredNorm().
+   */
+  T squaredNorm() const;
+
+  /** Computes the Frobenius norm of the matrix, as ParallelMatrix::norm().
+   */
+  T norm() const;
+};
+
+template <typename T>
+SymmetricParallelMatrix<T>::SymmetricParallelMatrix(const int& numRows,
+                                                    const int& numBlocks,
+                                                    const int& blacsContext) {
+  // let ParallelMatrix set up (or read) the process grid
+  ParallelMatrix<T> grid;
+  grid.initBlacs(0, 0, blacsContext);
+  numBlacsRows_ = grid.numBlacsRows_;
+  numBlacsCols_ = grid.numBlacsCols_;
+  myBlacsRow_ = grid.myBlacsRow_;
+  myBlacsCol_ = grid.myBlacsCol_;
+  blacsContext_ = grid.blacsContext_;
+
+  numRows_ = numRows;
+  numBlocks_ = numBlocks == 0 ? int(numBlacsRows_) : numBlocks;
+  // same block size as the ParallelMatrix constructor
+  blockSize_ = numRows_ / numBlocks_;
+  if (numRows_ % numBlocks_ != 0) blockSize_ += 1;
+  initLayout();
+}
+
+template <typename T>
+SymmetricParallelMatrix<T>::SymmetricParallelMatrix(
+    const ParallelMatrix<T>& that) {
+  if (that.numRows_ != that.numCols_) {
+    Error("Cannot pack the upper triangle of a non-square matrix.");
+  }
+  if (that.numBlocksRows_ != that.numBlocksCols_ ||
+      that.blockSizeRows_ != that.blockSizeCols_) {
+    Error("Packing the upper triangle needs square blocks.");
+  }
+  numBlacsRows_ = that.numBlacsRows_;
+  numBlacsCols_ = that.numBlacsCols_;
+  myBlacsRow_ = that.myBlacsRow_;
+  myBlacsCol_ = that.myBlacsCol_;
+  blacsContext_ = that.blacsContext_;
+  numRows_ = that.numRows_;
+  numBlocks_ = that.numBlocksRows_;
+  blockSize_ = that.blockSizeRows_;
+  initLayout();
+
+  // the columns of the dense buffer start every lld elements
+  size_t lld = that.descMat_[8];
+  for (int j = 0; j < numLocalCols_; j++) {
+    for (int i = 0; i < colRows_[j]; i++) {
+      mat[colOffsets_[j] + i] = that.mat[j * lld + i];
+    }
+  }
+}
+
+template <typename T>
+SymmetricParallelMatrix<T>::SymmetricParallelMatrix(
+    const SymmetricParallelMatrix<T>& that)
+    : numRows_(that.numRows_), numBlocks_(that.numBlocks_),
+      blockSize_(that.blockSize_), numLocalRows_(that.numLocalRows_),
+      numLocalCols_(that.numLocalCols_), numBlacsRows_(that.numBlacsRows_),
+      numBlacsCols_(that.numBlacsCols_), myBlacsRow_(that.myBlacsRow_),
+      myBlacsCol_(that.myBlacsCol_), blacsContext_(that.blacsContext_),
+      colRows_(that.colRows_), colOffsets_(that.colOffsets_), mat(that.mat) {
+  trackMemory("SymmetricParallelMatrix", mat.size() * sizeof(T));
+}
+
+template <typename T>
+SymmetricParallelMatrix<T>& SymmetricParallelMatrix<T>::operator=(
+    const SymmetricParallelMatrix<T>& that) {
+  if (this != &that) {
+    trackMemory("SymmetricParallelMatrix", -long(mat.size() * sizeof(T)));
+    numRows_ = that.numRows_;
+    numBlocks_ = that.numBlocks_;
+    blockSize_ = that.blockSize_;
+    numLocalRows_ = that.numLocalRows_;
+    numLocalCols_ = that.numLocalCols_;
+    numBlacsRows_ = that.numBlacsRows_;
+    numBlacsCols_ = that.numBlacsCols_;
+    myBlacsRow_ = that.myBlacsRow_;
+    myBlacsCol_ = that.myBlacsCol_;
+    blacsContext_ = that.blacsContext_;
+    colRows_ = that.colRows_;
+    colOffsets_ = that.colOffsets_;
+    mat = that.mat;
+    trackMemory("SymmetricParallelMatrix", mat.size() * sizeof(T));
+  }
+  return *this;
+}
+
+template <typename T>
+SymmetricParallelMatrix<T>::~SymmetricParallelMatrix() {
+  trackMemory("SymmetricParallelMatrix", -long(mat.size() * sizeof(T)));
+}
+
+template <typename T>
+void SymmetricParallelMatrix<T>::initLayout() {
+  blacsInt n = numRows_;
+  blacsInt nb = blockSize_;
+  blacsInt iZero = 0;
+  numLocalRows_ = numroc_(&n, &nb, &myBlacsRow_, &iZero, &numBlacsRows_);
+  numLocalCols_ = numroc_(&n, &nb, &myBlacsCol_, &iZero, &numBlacsCols_);
+
+  // local column j, in the block column jb, stores the local row blocks
+  // ib*numBlacsRows + myBlacsRow <= jb, which come first in local storage
+  colRows_.resize(numLocalCols_);
+  colOffsets_.resize(numLocalCols_ + 1);
+  colOffsets_[0] = 0;
+  for (int j = 0; j < numLocalCols_; j++) {
+    int jb = local2Global(j, myBlacsCol_, numBlacsCols_) / blockSize_;
+    int numRowBlocks = myBlacsRow_ > jb
+        ? 0 : (jb - int(myBlacsRow_)) / int(numBlacsRows_) + 1;
+    colRows_[j] = std::min(numLocalRows_, numRowBlocks * blockSize_);
+    colOffsets_[j + 1] = colOffsets_[j] + colRows_[j];
+  }
+  mat.assign(colOffsets_[numLocalCols_], T(0.));
+  trackMemory("SymmetricParallelMatrix", mat.size() * sizeof(T));
+}
+
+template <typename T>
+int SymmetricParallelMatrix<T>::local2Global(const int& i,
+                                             const blacsInt& myProc,
+                                             const blacsInt& numProcs) const {
+  int block = i / blockSize_;
+  return (block * int(numProcs) + int(myProc)) * blockSize_ + i % blockSize_;
+}
+
+template <typename T>
+int64_t SymmetricParallelMatrix<T>::global2Local(const int& row,
+                                                 const int& col) const {
+  int rowBlock = row / blockSize_;
+  int colBlock = col / blockSize_;
+  if (rowBlock % numBlacsRows_ != myBlacsRow_ ||
+      colBlock % numBlacsCols_ != myBlacsCol_) {
+    return -1;
+  }
+  int i = (rowBlock / numBlacsRows_) * blockSize_ + row % blockSize_;
+  int j = (colBlock / numBlacsCols_) * blockSize_ + col % blockSize_;
+  return int64_t(colOffsets_[j]) + i;
+}
+
+template <typename T>
+void SymmetricParallelMatrix<T>::checkSameLayout(
+    const SymmetricParallelMatrix<T>& that) const {
+  if (numRows_ != that.numRows_ || blockSize_ != that.blockSize_ ||
+      blacsContext_ != that.blacsContext_) {
+    Error("Cannot combine symmetric matrices of different distributions.");
+  }
+}
+
+template <typename T>
+bool SymmetricParallelMatrix<T>::indicesAreLocal(const int& row,
+                                                 const int& col) const {
+  return global2Local(std::min(row, col), std::max(row, col)) != -1;
+}
+
+template <typename T>
+T& SymmetricParallelMatrix<T>::operator()(const int& row, const int& col) {
+  if (row > col) {
+    DeveloperError("Only the upper triangle of a SymmetricParallelMatrix "
+                   "can be set: " + std::to_string(row) + " " +
+                   std::to_string(col));
+  }
+  int64_t localIndex = global2Local(row, col);
+  if (localIndex == -1) {
+    dummyZero = 0.;
+    return dummyZero;
+  } else {
+    return mat[localIndex];
+  }
+}
+
+template <typename T>
+T SymmetricParallelMatrix<T>::get(const int& row, const int& col) const {
+  if (row > col) return conjugate(get(col, row));
+  int64_t localIndex = global2Local(row, col);
+  if (localIndex == -1) {
+    return T(0.);
+  } else {
+    return mat[localIndex];
+  }
+}
+
+template <typename T>
+void SymmetricParallelMatrix<T>::copyUpperTo(ParallelMatrix<T>& result,
+                                             const bool& strictUpper) const {
+  size_t lld = result.descMat_[8];
+  for (int j = 0; j < numLocalCols_; j++) {
+    int col = local2Global(j, myBlacsCol_, numBlacsCols_);
+    for (int i = 0; i < colRows_[j]; i++) {
+      // the lower part of the diagonal blocks is not referenced
+      int row = local2Global(i, myBlacsRow_, numBlacsRows_);
+      if (row > col || (strictUpper && row == col)) continue;
+      result.mat[j * lld + i] = mat[colOffsets_[j] + i];
+    }
+  }
+}
+
+template <typename T>
+ParallelMatrix<T> SymmetricParallelMatrix<T>::toParallelMatrix(
+    const bool& fullMatrix) const {
+  ParallelMatrix<T> result(numRows_, numRows_, numBlocks_, numBlocks_,
+                           blacsContext_);
+  if (!fullMatrix) {
+    copyUpperTo(result, false);
+    return result;
+  }
+
+  // the strictly lower triangle is U^H, with U the strictly upper one,
+  // transposed from a dense copy of U. Then the upper triangle and the
+  // diagonal are added from the packed buffer
+  {
+    ParallelMatrix<T> upper(numRows_, numRows_, numBlocks_, numBlocks_,
+                            blacsContext_);
+    copyUpperTo(upper, true);
+    blacsInt n = numRows_;
+    blacsInt one = 1;
+    T alpha = 1.;
+    T beta = 0.;
+    scalapack<T>::tran(&n, &n, &alpha, upper.mat, &one, &one,
+                       &upper.descMat_[0], &beta, result.mat, &one, &one,
+                       &result.descMat_[0]);
+  }
+  size_t lld = result.descMat_[8];
+  for (int j = 0; j < numLocalCols_; j++) {
+    int col = local2Global(j, myBlacsCol_, numBlacsCols_);
+    for (int i = 0; i < colRows_[j]; i++) {
+      if (local2Global(i, myBlacsRow_, numBlacsRows_) > col) continue;
+      result.mat[j * lld + i] += mat[colOffsets_[j] + i];
+    }
+  }
+  return result;
+}
+
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+SymmetricParallelMatrix<T>::diagonalizeDense(const int& numEigenvalues) {
+  auto dense = std::make_unique<ParallelMatrix<T>>(
+      numRows_, numRows_, numBlocks_, numBlocks_, blacsContext_);
+  copyUpperTo(*dense, false);
+
+  // without the packed buffer, the peak memory is that of the dense solver
+  trackMemory("SymmetricParallelMatrix", -long(mat.size() * sizeof(T)));
+  std::vector<T>().swap(mat);
+  auto result = numEigenvalues < 0 ? dense->diagonalize()
+                                   : dense->diagonalize(numEigenvalues);
+  dense.reset();
+
+  mat.assign(colOffsets_[numLocalCols_], T(0.));
+  trackMemory("SymmetricParallelMatrix", mat.size() * sizeof(T));
+  return result;
+}
+
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+SymmetricParallelMatrix<T>::diagonalize() {
+  return diagonalizeDense(-1);
+}
+
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>>
+SymmetricParallelMatrix<T>::diagonalize(int numEigenvalues) {
+  return diagonalizeDense(numEigenvalues);
+}
+
+template <typename T>
+SymmetricParallelMatrix<T>& SymmetricParallelMatrix<T>::operator+=(
+    const SymmetricParallelMatrix<T>& that) {
+  checkSameLayout(that);
+  for (size_t i = 0; i < mat.size(); i++) {
+    mat[i] += that.mat[i];
+  }
+  return *this;
+}
+
+template <typename T>
+SymmetricParallelMatrix<T>& SymmetricParallelMatrix<T>::operator-=(
+    const SymmetricParallelMatrix<T>& that) {
+  checkSameLayout(that);
+  for (size_t i = 0; i < mat.size(); i++) {
+    mat[i] -= that.mat[i];
+  }
+  return *this;
+}
+
+template <typename T>
+SymmetricParallelMatrix<T>& SymmetricParallelMatrix<T>::operator*=(
+    const T& that) {
+  for (size_t i = 0; i < mat.size(); i++) {
+    mat[i] *= that;
+  }
+  return *this;
+}
+
+template <typename T>
+SymmetricParallelMatrix<T>& SymmetricParallelMatrix<T>::operator/=(
+    const T& that) {
+  for (size_t i = 0; i < mat.size(); i++) {
+    mat[i] /= that;
+  }
+  return *this;
+}
+
+template <typename T>
+T SymmetricParallelMatrix<T>::dot(const SymmetricParallelMatrix<T>& that) const {
+  checkSameLayout(that);
+  // an element above the diagonal and its mirror contribute
+  // a b + conj(a) conj(b) = 2 Re(a b), the diagonal counts once
+  T scalar = 0.;
+  for (int j = 0; j < numLocalCols_; j++) {
+    int col = local2Global(j, myBlacsCol_, numBlacsCols_);
+    for (int i = 0; i < colRows_[j]; i++) {
+      int row = local2Global(i, myBlacsRow_, numBlacsRows_);
+      if (row > col) continue;
+      T ab = mat[colOffsets_[j] + i] * that.mat[colOffsets_[j] + i];
+      if (row == col) {
+        scalar += ab;
+      } else {
+        scalar += T(2. * std::real(ab));
+      }
+    }
+  }
+  T scalarOut = 0.;
+  mpi->allReduceSum(&scalar, &scalarOut);
+  return scalarOut;
+}
+
+template <typename T>
+T SymmetricParallelMatrix<T>::squaredNorm() const {
+  return dot(*this);
+}
+
+template <typename T>
+T SymmetricParallelMatrix<T>::norm() const {
+  return sqrt(squaredNorm());
+}
@@ -0,0 +1,469 @@
+#include "benchmark.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <utility>
+#include "BlockSparsePMatrix.h"
+#include "blacs.h"
+#include "eigensolvers.h"
+#include "mpi/mpiHelper.h"
+#include "profiler.h"
+#include "utilities.h"
+
+// Parsing helpers -------------------------------------------------------
+
+static std::vector<std::string> splitList(const std::string& value) {
+  std::vector<std::string> items;
+  std::stringstream stream(value);
+  std::string item;
+  while (std::getline(stream, item, ',')) {
+    if (!item.empty()) items.push_back(item);
+  }
+  return items;
+}
+
+static std::vector<int> splitIntList(const std::string& value) {
+  std::vector<int> items;
+  for (auto& item : splitList(value)) items.push_back(std::stoi(item));
+  return items;
+}
+
+static std::vector<double> splitDoubleList(const std::string& value) {
+  std::vector<double> items;
+  for (auto& item : splitList(value)) items.push_back(std::stod(item));
+  return items;
+}
+
+static void setConfigValue(BenchmarkConfig& config, const std::string& key,
+                           const std::string& value) {
+  if (key == "ops") {
+    config.operations = splitList(value);
+  } else if (key == "sizes") {
+    config.sizes = splitIntList(value);
+  } else if (key == "blocks") {
+    config.blockSizes = splitIntList(value);
+  } else if (key == "grid") {
+    size_t x = value.find('x');
+    if (x == std::string::npos) {
+      Error("The benchmark grid must be given as <rows>x<cols>.");
+    }
+    config.numBlacsRows = std::stoi(value.substr(0, x));
+    config.numBlacsCols = std::stoi(value.substr(x + 1));
+  } else if (key == "reps") {
+    config.repetitions = std::stoi(value);
+  } else if (key == "warmups") {
+    config.warmups = std::stoi(value);
+  } else if (key == "nev") {
+    config.numEigenvalues = std::stoi(value);
+  } else if (key == "tilefills") {
+    config.tileFills = splitDoubleList(value);
+  } else if (key == "out") {
+    config.outputFile = value;
+  } else {
+    Error("Unknown benchmark setting " + key);
+  }
+}
+
+BenchmarkConfig parseBenchmarkConfig(int argc, char** argv) {
+  BenchmarkConfig config;
+  const std::vector<std::string> keys = {
+      "ops", "sizes", "blocks", "grid", "reps", "warmups", "nev", "tilefills",
+      "out"};
+
+  std::string fileName = getArgument(argc, argv, "-config", "");
+  if (!fileName.empty()) {
+    std::ifstream file(fileName);
+    if (!file.is_open()) Error("Cannot open benchmark config " + fileName);
+    std::string line;
+    while (std::getline(file, line)) {
+      line = line.substr(0, line.find('#'));
+      size_t equal = line.find('=');
+      if (equal == std::string::npos) continue;
+      std::string key = line.substr(0, equal);
+      std::string value = line.substr(equal + 1);
+      // strip blanks
+      key.erase(std::remove_if(key.begin(), key.end(), ::isspace), key.end());
+      value.erase(std::remove_if(value.begin(), value.end(), ::isspace),
+                  value.end());
+      setConfigValue(config, key, value);
+    }
+  }
+  for (auto& key : keys) {
+    std::string value = getArgument(argc, argv, "-" + key, "");
+    if (!value.empty()) setConfigValue(config, key, value);
+  }
+
+  const std::vector<std::string> knownOps = {
+      "fill", "gemm", "syevd", "syevr", "heev", "slices", "redistribute",
+      "collectives",
+      "ssyevd", "syevd_mixed", "gesv", "gesv_mixed", "bsgemm", "lobpcg",
+      "chebyshev", "expm", "eye"};
+  for (auto& op : config.operations) {
+    if (std::find(knownOps.begin(), knownOps.end(), op) == knownOps.end()) {
+      Error("Unknown benchmark operation " + op);
+    }
+  }
+  if (config.repetitions < 1 || config.warmups < 0) {
+    Error("The benchmark needs at least one repetition.");
+  }
+  for (double tileFill : config.tileFills) {
+    if (tileFill <= 0. || tileFill > 1.) {
+      Error("Tile fill ratios must be in (0,1].");
+    }
+  }
+  return config;
+}
+
+// Test matrix -------------------------------------------------------------
+
+template <typename T>
+static T testElement(const int& i, const int& j);
+
+template <>
+double testElement(const int& i, const int& j) {
+  if (i == j) return double(i) + 1.;
+  return 1. / (1. + std::abs(i - j));
+}
+
+template <>
+float testElement(const int& i, const int& j) {
+  return float(testElement<double>(i, j));
+}
+
+template <>
+std::complex<double> testElement(const int& i, const int& j) {
+  double imaginary = i < j ? 0.5 : (i > j ? -0.5 : 0.);
+  return {testElement<double>(i, j), imaginary / (1. + std::abs(i - j))};
+}
+
+template <typename T>
+void fillTestMatrix(ParallelMatrix<T>& matrix) {
+  for (auto [i, j] : matrix.getAllLocalElements()) {
+    matrix(i, j) = testElement<T>(i, j);
+  }
+}
+
+template void fillTestMatrix(ParallelMatrix<double>& matrix);
+template void fillTestMatrix(ParallelMatrix<float>& matrix);
+template void fillTestMatrix(ParallelMatrix<std::complex<double>>& matrix);
+
+// Benchmark runs ------------------------------------------------------------
+
+// timings of one repetition, maximum over processes
+struct RepetitionTimes {
+  double fill = 0.;
+  double compute = 0.;
+  double comm = 0.;
+  double dense = 0.;     // bsgemm, lobpcg, expm, eye: time of the reference
+  double tileFill = 1.;  // bsgemm: actual fraction of nonzero tiles
+};
+
+static double secondsSince(const std::chrono::steady_clock::time_point& t0) {
+  std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - t0;
+  return elapsed.count();
+}
+
+/** Runs one repetition of an operation, on matrices of size n distributed
+ * with blocks of size block on the given blacs context.
+ */
+template <typename T>
+static RepetitionTimes runRepetition(const std::string& op, const int& n,
+                                     const int& block, const int& context,
+                                     const int& numEigenvalues,
+                                     const double& tileFill) {
+  RepetitionTimes times;
+  int numBlocks = (n + block - 1) / block;
+
+  mpi->barrier();
+  double commStart = mpi->getCommStats().time;
+  auto t0 = std::chrono::steady_clock::now();
+  ParallelMatrix<T> a(n, n, numBlocks, numBlocks, context);
+  {
+    RegionTimer timer("fill");
+    fillTestMatrix(a);
+  }
+  times.fill = secondsSince(t0);
+
+  mpi->barrier();
+  t0 = std::chrono::steady_clock::now();
+  if (op == "gemm") {
+    ParallelMatrix<T> b = a;
+    t0 = std::chrono::steady_clock::now();
+    ParallelMatrix<T> c = a.prod(b);
+    times.compute = secondsSince(t0);
+  } else if (op == "syevd" || op == "heev" || op == "ssyevd") {
+    auto [eigenvalues, eigenvectors] = a.diagonalize();
+    times.compute = secondsSince(t0);
+  } else if (op == "slices") {
+    auto [eigenvalues, eigenvectors] = a.diagonalizeSlices();
+    times.compute = secondsSince(t0);
+  } else if (op == "syevd_mixed") {
+    if constexpr (std::is_same_v<T, double>) {
+      auto [eigenvalues, eigenvectors] = a.diagonalizeMixedPrecision();
+    }
+    times.compute = secondsSince(t0);
+  } else if (op == "syevr") {
+    if constexpr (std::is_same_v<T, double>) {
+      auto [eigenvalues, eigenvectors] = a.diagonalize(numEigenvalues);
+    }
+    times.compute = secondsSince(t0);
+  } else if (op == "gesv" || op == "gesv_mixed") {
+    // one right hand side of ones
+    ParallelMatrix<T> b(n, 1, numBlocks, 1, context);
+    for (auto [i, j] : b.getAllLocalElements()) b(i, j) = 1.;
+    t0 = std::chrono::steady_clock::now();
+    if (op == "gesv") {
+      ParallelMatrix<T> x = a.solve(b);
+    } else if constexpr (std::is_same_v<T, double>) {
+      ParallelMatrix<T> x = a.solveMixedPrecision(b);
+    }
+    times.compute = secondsSince(t0);
+  } else if (op == "bsgemm") {
+    // zero all but a random subset of the tiles (and the diagonal ones),
+    // drawn alike on all processes
+    int tileSize = (n + numBlocks - 1) / numBlocks;
+    int numTiles = (n + tileSize - 1) / tileSize;
+    std::mt19937 generator(12345);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    std::vector<char> keepTile(size_t(numTiles) * numTiles);
+    for (int jb = 0; jb < numTiles; jb++) {
+      for (int ib = 0; ib < numTiles; ib++) {
+        keepTile[ib + size_t(jb) * numTiles] =
+            ib == jb || uniform(generator) < tileFill;
+      }
+    }
+    for (auto [i, j] : a.getAllLocalElements()) {
+      if (!keepTile[i / tileSize + size_t(j / tileSize) * numTiles]) {
+        a(i, j) = 0.;
+      }
+    }
+    BlockSparseParallelMatrix<T> sparse(a);
+    times.tileFill = sparse.fillRatio();
+
+    mpi->barrier();
+    t0 = std::chrono::steady_clock::now();
+    ParallelMatrix<T> c = a.prod(a);
+    times.dense = secondsSince(t0);
+    mpi->barrier();
+    t0 = std::chrono::steady_clock::now();
+    BlockSparseParallelMatrix<T> sparseC = sparse.prod(sparse);
+    times.compute = secondsSince(t0);
+  } else if (op == "lobpcg" || op == "chebyshev") {
+    // a step of a self-consistent loop: the eigenvectors of the matrix are
+    // known, then its diagonal changes slightly. Times the warm-started
+    // solver against the dense diagonalization it replaces.
+    if constexpr (std::is_same_v<T, double>) {
+      MatrixOperator<T> matrixOp(a);
+      int numVectors = std::max(std::min(numEigenvalues, n / 4), 1);
+      // the Chebyshev filter converges faster with a few extra vectors
+      int numGuards = op == "chebyshev" ? std::max(numVectors / 5, 2) : 0;
+      LobpcgOptions options;
+      options.diagonal = a.getDiagonal();
+      auto [eigenvalues, eigenvectors] =
+          lobpcg(matrixOp, numVectors + numGuards, nullptr, nullptr, options);
+      auto [lowerBound, upperBound] = spectralBounds(matrixOp);
+      std::vector<double> change(n);
+      for (int i = 0; i < n; i++) {
+        change[i] = 1.e-3 * std::sin(double(i));
+        options.diagonal[i] += change[i];
+      }
+      a.addToDiagonal(change);
+
+      ParallelMatrix<T> b = a;
+      mpi->barrier();
+      t0 = std::chrono::steady_clock::now();
+      auto [denseEigenvalues, denseEigenvectors] = b.diagonalize(numVectors);
+      times.dense = secondsSince(t0);
+      mpi->barrier();
+      t0 = std::chrono::steady_clock::now();
+      if (op == "lobpcg") {
+        auto [newEigenvalues, newEigenvectors] =
+            lobpcg(matrixOp, numVectors, &eigenvectors, nullptr, options);
+      } else {
+        // the bound of the previous step, with a margin for the change
+        auto [newEigenvalues, newEigenvectors] = chebyshevFilteredSubspace(
+            matrixOp, numVectors, eigenvectors, upperBound + 1.e-2);
+      }
+      times.compute = secondsSince(t0);
+    }
+  } else if (op == "expm") {
+    ParallelMatrix<T> b = a;
+    t0 = std::chrono::steady_clock::now();
+    ParallelMatrix<T> denseExp =
+        b.applyFunction([](double x) { return std::exp(x); });
+    times.dense = secondsSince(t0);
+    mpi->barrier();
+    t0 = std::chrono::steady_clock::now();
+    ParallelMatrix<T> padeExp = a.expm();
+    times.compute = secondsSince(t0);
+  } else if (op == "eye") {
+    // diagonal shift and trace on the local diagonal blocks, timed against
+    // the same through operator(), i.e. N index lookups on every process.
+    // eye() costs the same plus the zeroing of the local buffer.
+    a.addToDiagonal(T(1.));
+    T trace = a.trace();
+    times.compute = secondsSince(t0);
+    mpi->barrier();
+    t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) a(i, i) += 1.;
+    T globalTrace = 0.;
+    for (int i = 0; i < n; i++) globalTrace += std::as_const(a)(i, i);
+    mpi->allReduceSum(&globalTrace);
+    times.dense = secondsSince(t0);
+    // the second shift adds n to the trace
+    if (std::abs(globalTrace - trace - T(n)) > 1.e-6 * std::abs(globalTrace)) {
+      Error("Benchmark eye: the two traces differ");
+    }
+  } else if (op == "redistribute") {
+    ParallelMatrix<T> b = a.redistribute();
+    times.compute = secondsSince(t0);
+  } else if (op == "collectives") {
+    // gather and sum a buffer of the size of the global matrix
+    size_t numElements = size_t(n) * size_t(n);
+    std::vector<size_t> divs = mpi->divideWork(numElements);
+    std::vector<T> localPart(divs[1] - divs[0], T(1.));
+    std::vector<T> buffer(numElements);
+    t0 = std::chrono::steady_clock::now();
+    mpi->allGatherv(&localPart, &buffer);
+    mpi->allReduceSum(&buffer);
+    times.compute = secondsSince(t0);
+  }
+  times.comm = mpi->getCommStats().time - commStart;
+
+  mpi->allReduceMax(&times.fill);
+  mpi->allReduceMax(&times.compute);
+  mpi->allReduceMax(&times.comm);
+  mpi->allReduceMax(&times.dense);
+  return times;
+}
+
+static std::string statistics(const std::vector<double>& values) {
+  double minValue = *std::min_element(values.begin(), values.end());
+  double maxValue = *std::max_element(values.begin(), values.end());
+  double mean = 0.;
+  for (double v : values) mean += v / values.size();
+  char buffer[200];
+  snprintf(buffer, sizeof(buffer),
+           "{\"min\": %.6e, \"mean\": %.6e, \"max\": %.6e}", minValue, mean,
+           maxValue);
+  return std::string(buffer);
+}
+
+void runBenchmarks(const BenchmarkConfig& config) {
+
+  // create the blacs process grid
+  blacsInt context = -1;
+  blacsInt numBlacsRows = config.numBlacsRows;
+  blacsInt numBlacsCols = config.numBlacsCols;
+  if (numBlacsRows == 0 || numBlacsCols == 0) {
+    numBlacsRows = int(sqrt(mpi->getSize()));
+    numBlacsCols = mpi->getSize() / numBlacsRows;
+  }
+  if (numBlacsRows * numBlacsCols != mpi->getSize()) {
+    Error("The benchmark grid must use all MPI processes.");
+  }
+  blacsInt iZero = 0;
+  char layout = 'R';
+  blacs_get_(&iZero, &iZero, &context);
+  blacs_gridinit_(&context, &layout, &numBlacsRows, &numBlacsCols);
+
+  std::ofstream outputFile;
+  if (mpi->mpiHead() && !config.outputFile.empty()) {
+    outputFile.open(config.outputFile, std::ios::app);
+  }
+
+  for (auto& op : config.operations) {
+    for (int n : config.sizes) {
+      for (int block : config.blockSizes) {
+        // bsgemm is run for every tile fill ratio, the others once
+        std::vector<double> tileFills = {1.};
+        if (op == "bsgemm") tileFills = config.tileFills;
+        for (double tileFill : tileFills) {
+          int numEigenvalues = config.numEigenvalues > 0
+              ? std::min(config.numEigenvalues, n) : std::max(n / 10, 1);
+
+          std::vector<double> fillTimes, computeTimes, commTimes, denseTimes;
+          double actualTileFill = 1.;
+          for (int rep = 0; rep < config.warmups + config.repetitions; rep++) {
+            RepetitionTimes times;
+            if (op == "heev") {
+              times = runRepetition<std::complex<double>>(
+                  op, n, block, context, numEigenvalues, tileFill);
+            } else if (op == "ssyevd") {
+              times = runRepetition<float>(op, n, block, context,
+                                           numEigenvalues, tileFill);
+            } else {
+              times = runRepetition<double>(op, n, block, context,
+                                            numEigenvalues, tileFill);
+            }
+            if (rep < config.warmups) continue;
+            fillTimes.push_back(times.fill);
+            computeTimes.push_back(times.compute);
+            commTimes.push_back(times.comm);
+            denseTimes.push_back(times.dense);
+            actualTileFill = times.tileFill;
+          }
+
+          double flops = 0.;
+          // bsgemm: rate of the dense product it replaces
+          if (op == "gemm" || op == "bsgemm") flops = flopsGemm<double>(n, n, n);
+          // slices, expm: rate of the syevd they replace
+          if (op == "syevd" || op == "ssyevd" || op == "slices" ||
+              op == "expm") {
+            flops = flopsSyevd(n);
+          }
+          // lobpcg, chebyshev: rate of the syevr they replace
+          if (op == "syevr" || op == "lobpcg" || op == "chebyshev") {
+            flops = flopsSyevr(n, numEigenvalues);
+          }
+          if (op == "heev") flops = flopsHeevd(n);
+          if (op == "gesv" || op == "gesv_mixed") {
+            flops = flopsGetrf<double>(n) + flopsGetrs<double>(n, 1);
+          }
+          double bestTime =
+              *std::min_element(computeTimes.begin(), computeTimes.end());
+          double gflops = bestTime > 0. ? flops / bestTime * 1.e-9 : 0.;
+
+          double peakMemory = double(std::get<1>(residentSetSize()));
+          mpi->allReduceMax(&peakMemory);
+
+          if (!mpi->mpiHead()) continue;
+          std::stringstream line;
+          line << "{\"op\": \"" << op << "\", \"n\": " << n
+               << ", \"block\": " << block << ", \"grid\": [" << numBlacsRows
+               << ", " << numBlacsCols << "], \"procs\": " << mpi->getSize()
+               << ", \"nev\": "
+               << (op == "syevr" || op == "lobpcg" || op == "chebyshev"
+                   ? numEigenvalues : n)
+               << ", \"reps\": " << config.repetitions
+               << ", \"warmups\": " << config.warmups
+               << ", \"fill_s\": " << statistics(fillTimes)
+               << ", \"compute_s\": " << statistics(computeTimes)
+               << ", \"comm_s\": " << statistics(commTimes);
+          if (op == "bsgemm" || op == "lobpcg" || op == "chebyshev" ||
+              op == "expm" || op == "eye") {
+            double denseMean = 0., sparseMean = 0.;
+            for (double t : denseTimes) denseMean += t / denseTimes.size();
+            for (double t : computeTimes) sparseMean += t / computeTimes.size();
+            if (op == "bsgemm") line << ", \"tile_fill\": " << actualTileFill;
+            line << ", \"dense_s\": " << statistics(denseTimes)
+                 << ", \"speedup\": "
+                 << (sparseMean > 0. ? denseMean / sparseMean : 0.);
+          }
+          line << ", \"gflops\": " << gflops
+               << ", \"peak_rss_mb\": " << peakMemory / 1.e6 << "}";
+          if (outputFile.is_open()) {
+            outputFile << line.str() << std::endl;
+          } else {
+            std::cout << line.str() << std::endl;
+          }
+        }
+      }
+    }
+  }
+  blacs_gridexit_(&context);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "PMatrix.h"
+
+/** Settings of a benchmark run of the PMatrix executable.
+ * Every operation is run for every combination of size and block size.
+ */
+struct BenchmarkConfig {
+  // any of "fill", "gemm", "syevd", "syevr", "heev" (complex diagonalize,
+  // with p?heevd), "slices" (syevd by spectrum slicing across the MPI pools
+  // given with -ps), "redistribute",
+  // "collectives" (allGatherv and allReduceSum of n*n doubles),
+  // "ssyevd" (single precision syevd), "syevd_mixed" (single precision
+  // syevd refined to double precision), "gesv" (linear solve with one
+  // right hand side), "gesv_mixed" (mixed precision linear solve),
+  // "bsgemm" (block-sparse product, timed against the dense one, for each
+  // tile fill ratio), "lobpcg" (warm-started LOBPCG for nev eigenpairs of a
+  // slightly changed matrix, timed against syevr), "chebyshev" (same, with
+  // the Chebyshev-filtered subspace iteration), "expm" (matrix exponential
+  // by Pade scaling and squaring, timed against applyFunction, i.e. syevd),
+  // "eye" (diagonal shift and trace, as done by eye(), timed against the
+  // same with operator(); meant for large sizes, e.g. 100000)
+  std::vector<std::string> operations = {"syevd"};
+  std::vector<int> sizes = {1024};
+  std::vector<int> blockSizes = {64};
+  // shape of the blacs process grid, 0 for the default square grid
+  int numBlacsRows = 0;
+  int numBlacsCols = 0;
+  int repetitions = 3;
+  int warmups = 1;
+  // used by syevr, lobpcg and chebyshev, 0 means 10% of the size
+  int numEigenvalues = 0;
+  // fractions of nonzero tiles used by bsgemm
+  std::vector<double> tileFills = {0.05, 0.1, 0.25, 0.5, 1.};
+  std::string outputFile;  // results are appended here, or printed if empty
+};
+
+/** Reads the benchmark settings.
+ * Settings are first read from the file given with -config, with one
+ * "key = value" per line ('#' starts a comment), and then from command line
+ * flags, which take precedence. Keys and flags are:
+ *   ops (-ops)        comma separated list of operations
+ *   sizes (-sizes)    comma separated list of matrix sizes
+ *   blocks (-blocks)  comma separated list of block sizes
+ *   grid (-grid)      process grid as <rows>x<cols>
+ *   reps (-reps)      number of timed repetitions
+ *   warmups (-warmups) number of untimed repetitions
+ *   nev (-nev)        number of eigenvalues (syevr, lobpcg, chebyshev)
+ *   tilefills (-tilefills) comma separated list of tile fill ratios (bsgemm)
+ *   out (-out)        file where results are appended
+ */
+BenchmarkConfig parseBenchmarkConfig(int argc, char** argv);
+
+/** Runs all the benchmarks of a configuration.
+ * Results are written as one JSON object per line, containing the
+ * settings, the statistics over repetitions of the fill, compute and
+ * communication times (slowest process), the flop rate and the peak memory.
+ * bsgemm also reports the tile fill ratio, the dense product times and the
+ * speedup of the block-sparse product (dense over block-sparse mean time),
+ * with the flop rate of the dense product it replaces; lobpcg and chebyshev
+ * likewise report the syevr times and their speedup over them, expm
+ * the times of the eigendecomposition-based exponential, and eye those of
+ * the element-wise diagonal loops.
+ */
+void runBenchmarks(const BenchmarkConfig& config);
+
+/** Fills a matrix with a symmetric (hermitian, for complex numbers) test
+ * matrix with a well spread spectrum: A_ij = 1 / (1 + |i-j|) off the
+ * diagonal, plus i on the diagonal, plus an antisymmetric imaginary part
+ * for complex numbers. Only local elements are visited.
+ */
+template <typename T>
+void fillTestMatrix(ParallelMatrix<T>& matrix);
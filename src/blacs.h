@@ -6,62 +6,245 @@
  */
 
 #include <complex>
+#include <cstdint>
+
+// Integer type of the BLAS/BLACS/ScaLAPACK interface: 64-bit when linking
+// an ILP64 build of the libraries (cmake -DSCALAPACK_ILP64=ON, e.g. MKL's
+// *_ilp64 libraries), and the default 32-bit int otherwise.
+#ifdef SCALAPACK_ILP64
+typedef int64_t blacsInt;
+#else
+typedef int blacsInt;
+#endif
 
 extern "C" {
 
-void blacs_get_(int *, int *, int *);
-void blacs_pinfo_(int *, int *);
-void blacs_gridinit_(int *, char *, int *, int *);
-void blacs_gridinfo_(int *, int *, int *, int *, int *);
-void descinit_(int *, int *, int *, int *, int *, int *, int *, int *, int *,
-               int *);
-void blacs_gridexit_(const int *);
-int numroc_(int *, int *, int *, int *, int *);
-
-//void pdelset_(double *, int *, int *, int *, double *);
-//void pdelget_(char *, char *, double *, double *, const int *, const int *,
-//              const int *);
-void infog2l_(const int *, const int *, const int *, const int *, const int *,
-              const int *, const int *, int *, int *, int *, int *);
-
-int indxg2p_(int *, int *, int *, int *, int *);
-
-int indxg2l_(const int *, const int *, const int *, const int *, const int *);
-
-int indxl2g_(const int *, const int *, const int *, const int *, const int *);
-
-void pdgemm_(const char *, const char *, int *, int *, const int *, double *,
-             double *, int *, int *, const int *, double *, int *, int *,
-             const int *, double *, double *, int *, int *, int *);
-void pdsyev_(char *, char *, int *, double *, int *, int *, int *, double *,
-             double *, int *, int *, int *, double *, int *, int *);
-//void pzelset_(std::complex<double> *, int *, int *, int *,
+void blacs_get_(blacsInt *, blacsInt *, blacsInt *);
+void blacs_pinfo_(blacsInt *, blacsInt *);
+void blacs_gridinit_(blacsInt *, char *, blacsInt *, blacsInt *);
+void blacs_gridinfo_(blacsInt *, blacsInt *, blacsInt *, blacsInt *,
+                     blacsInt *);
+void descinit_(blacsInt *, blacsInt *, blacsInt *, blacsInt *, blacsInt *,
+               blacsInt *, blacsInt *, blacsInt *, blacsInt *, blacsInt *);
+void blacs_gridexit_(const blacsInt *);
+// grid of the processes listed (column-major) in usermap, -1 for the others
+void blacs_gridmap_(blacsInt *, blacsInt *, blacsInt *, blacsInt *,
+                    blacsInt *);
+// MPI rank of the process at (prow,pcol) of the grid of a context
+blacsInt blacs_pnum_(const blacsInt *, const blacsInt *, const blacsInt *);
+blacsInt numroc_(blacsInt *, blacsInt *, blacsInt *, blacsInt *, blacsInt *);
+
+//void pdelset_(double *, blacsInt *, blacsInt *, blacsInt *, double *);
+//void pdelget_(char *, char *, double *, double *, const blacsInt *,
+//              const blacsInt *, const blacsInt *);
+void infog2l_(const blacsInt *, const blacsInt *, const blacsInt *,
+              const blacsInt *, const blacsInt *, const blacsInt *,
+              const blacsInt *, blacsInt *, blacsInt *, blacsInt *, blacsInt *);
+
+blacsInt indxg2p_(blacsInt *, blacsInt *, blacsInt *, blacsInt *, blacsInt *);
+
+blacsInt indxg2l_(const blacsInt *, const blacsInt *, const blacsInt *,
+                  const blacsInt *, const blacsInt *);
+
+blacsInt indxl2g_(const blacsInt *, const blacsInt *, const blacsInt *,
+                  const blacsInt *, const blacsInt *);
+
+void pdgemm_(const char *, const char *, blacsInt *, blacsInt *,
+             const blacsInt *, double *, double *, blacsInt *, blacsInt *,
+             const blacsInt *, double *, blacsInt *, blacsInt *,
+             const blacsInt *, double *, double *, blacsInt *, blacsInt *,
+             blacsInt *);
+void pdsyev_(char *, char *, blacsInt *, double *, blacsInt *, blacsInt *,
+             blacsInt *, double *, double *, blacsInt *, blacsInt *, blacsInt *,
+             double *, blacsInt *, blacsInt *);
+//void pzelset_(std::complex<double> *, blacsInt *, blacsInt *, blacsInt *,
 //              std::complex<double> *);
 //void pzelget_(char *, char *, std::complex<double> *, std::complex<double> *,
-//              int *, int *, int *);
-void pzgemm_(const char *, const char *, int *, int *, const int *,
-             std::complex<double> *, std::complex<double> *, int *, int *,
-             const int *, std::complex<double> *, int *, int *, const int *,
-             std::complex<double> *, std::complex<double> *, int *, int *,
-             int *);
-void pzheev_(char *, char *, int *, std::complex<double> *, int *, int *, int *,
-             double *, std::complex<double> *, int *, int *, int *,
-             std::complex<double> *, int *, std::complex<double> *, int *,
-             int *);
-void pdsygvx_(const int *, const char*, const char*, const char*, const int*,
-                double*, int*, int*, int*, double*, int*, int*, int*, double*,
-                double*, int*, int*, double*, int*, int*,
-                double*, double*, double*, int*, int*, int*, double*,
-                int*, int*, int*, int*, int*, double*, int*);
+//              blacsInt *, blacsInt *, blacsInt *);
+void pzgemm_(const char *, const char *, blacsInt *, blacsInt *,
+             const blacsInt *, std::complex<double> *, std::complex<double> *,
+             blacsInt *, blacsInt *, const blacsInt *, std::complex<double> *,
+             blacsInt *, blacsInt *, const blacsInt *, std::complex<double> *,
+             std::complex<double> *, blacsInt *, blacsInt *, blacsInt *);
+void pzheev_(char *, char *, blacsInt *, std::complex<double> *, blacsInt *,
+             blacsInt *, blacsInt *, double *, std::complex<double> *,
+             blacsInt *, blacsInt *, blacsInt *, std::complex<double> *,
+             blacsInt *, std::complex<double> *, blacsInt *, blacsInt *);
+void pdsygvx_(const blacsInt *, const char*, const char*, const char*,
+              const blacsInt*, double*, blacsInt*, blacsInt*, blacsInt*,
+              double*, blacsInt*, blacsInt*, blacsInt*, double*, double*,
+              blacsInt*, blacsInt*, double*, blacsInt*, blacsInt*, double*,
+              double*, double*, blacsInt*, blacsInt*, blacsInt*, double*,
+              blacsInt*, blacsInt*, blacsInt*, blacsInt*, blacsInt*, double*,
+              blacsInt*);
 // calculate some eigenvalues of a parallel matrix of doubles
-void pdsyevr_(const char*, const char*, const char*, const int*, double*, int*, int*, int*,
-        double*, double*, int*, int*, int*, int*,
-        double*, double*, int*, int*, int*,
-        double*, int*, int*, int*, int*);
+void pdsyevr_(const char*, const char*, const char*, const blacsInt*, double*,
+              blacsInt*, blacsInt*, blacsInt*, double*, double*, blacsInt*,
+              blacsInt*, blacsInt*, blacsInt*, double*, double*, blacsInt*,
+              blacsInt*, blacsInt*, double*, blacsInt*, blacsInt*, blacsInt*,
+              blacsInt*);
 // calculate all eigenvalues and vectors by divide and conquer algorithm
-void pdsyevd_(char *, char *, int *, double *, int *, int *, int *, double *,
-             double *, int *, int *, int *, double *, int *, int *, int *, int *);
+void pdsyevd_(char *, char *, blacsInt *, double *, blacsInt *, blacsInt *,
+              blacsInt *, double *, double *, blacsInt *, blacsInt *,
+              blacsInt *, double *, blacsInt *, blacsInt *, blacsInt *,
+              blacsInt *);
 // take the transpose of a real matrix
-void pdtran_(int * m, int * n, double * alpha, double * a, int * ia, int * ja, int * desc_a, double * beta, double * c, int * ic, int * jc, int * desc_c);
+void pdtran_(blacsInt * m, blacsInt * n, double * alpha, double * a,
+             blacsInt * ia, blacsInt * ja, blacsInt * desc_a, double * beta,
+             double * c, blacsInt * ic, blacsInt * jc, blacsInt * desc_c);
+
+// copy a matrix between two block-cyclic distributions
+void pdgemr2d_(blacsInt *, blacsInt *, double *, blacsInt *, blacsInt *,
+               blacsInt *, double *, blacsInt *, blacsInt *, blacsInt *,
+               blacsInt *);
+void pzgemr2d_(blacsInt *, blacsInt *, std::complex<double> *, blacsInt *,
+               blacsInt *, blacsInt *, std::complex<double> *, blacsInt *,
+               blacsInt *, blacsInt *, blacsInt *);
+
+// single precision versions of the above
+void psgemm_(const char *, const char *, blacsInt *, blacsInt *,
+             const blacsInt *, float *, float *, blacsInt *, blacsInt *,
+             const blacsInt *, float *, blacsInt *, blacsInt *,
+             const blacsInt *, float *, float *, blacsInt *, blacsInt *,
+             blacsInt *);
+void pcgemm_(const char *, const char *, blacsInt *, blacsInt *,
+             const blacsInt *, std::complex<float> *, std::complex<float> *,
+             blacsInt *, blacsInt *, const blacsInt *, std::complex<float> *,
+             blacsInt *, blacsInt *, const blacsInt *, std::complex<float> *,
+             std::complex<float> *, blacsInt *, blacsInt *, blacsInt *);
+void pssyevd_(char *, char *, blacsInt *, float *, blacsInt *, blacsInt *,
+              blacsInt *, float *, float *, blacsInt *, blacsInt *, blacsInt *,
+              float *, blacsInt *, blacsInt *, blacsInt *, blacsInt *);
+void pssyevr_(const char*, const char*, const char*, const blacsInt*, float*,
+              blacsInt*, blacsInt*, blacsInt*, float*, float*, blacsInt*,
+              blacsInt*, blacsInt*, blacsInt*, float*, float*, blacsInt*,
+              blacsInt*, blacsInt*, float*, blacsInt*, blacsInt*, blacsInt*,
+              blacsInt*);
+// complex hermitian eigensolver by divide and conquer
+void pcheevd_(char *, char *, blacsInt *, std::complex<float> *, blacsInt *,
+              blacsInt *, blacsInt *, float *, std::complex<float> *,
+              blacsInt *, blacsInt *, blacsInt *, std::complex<float> *,
+              blacsInt *, float *, blacsInt *, blacsInt *, blacsInt *,
+              blacsInt *);
+void pstran_(blacsInt * m, blacsInt * n, float * alpha, float * a,
+             blacsInt * ia, blacsInt * ja, blacsInt * desc_a, float * beta,
+             float * c, blacsInt * ic, blacsInt * jc, blacsInt * desc_c);
+void psgemr2d_(blacsInt *, blacsInt *, float *, blacsInt *, blacsInt *,
+               blacsInt *, float *, blacsInt *, blacsInt *, blacsInt *,
+               blacsInt *);
+void pcgemr2d_(blacsInt *, blacsInt *, std::complex<float> *, blacsInt *,
+               blacsInt *, blacsInt *, std::complex<float> *, blacsInt *,
+               blacsInt *, blacsInt *, blacsInt *);
+
+// LU factorization of a general matrix, and solution of A X = B with it
+void pdgetrf_(blacsInt *, blacsInt *, double *, blacsInt *, blacsInt *,
+              blacsInt *, blacsInt *, blacsInt *);
+void psgetrf_(blacsInt *, blacsInt *, float *, blacsInt *, blacsInt *,
+              blacsInt *, blacsInt *, blacsInt *);
+void pzgetrf_(blacsInt *, blacsInt *, std::complex<double> *, blacsInt *,
+              blacsInt *, blacsInt *, blacsInt *, blacsInt *);
+void pcgetrf_(blacsInt *, blacsInt *, std::complex<float> *, blacsInt *,
+              blacsInt *, blacsInt *, blacsInt *, blacsInt *);
+void pdgetrs_(char *, blacsInt *, blacsInt *, double *, blacsInt *, blacsInt *,
+              blacsInt *, blacsInt *, double *, blacsInt *, blacsInt *,
+              blacsInt *, blacsInt *);
+void psgetrs_(char *, blacsInt *, blacsInt *, float *, blacsInt *, blacsInt *,
+              blacsInt *, blacsInt *, float *, blacsInt *, blacsInt *,
+              blacsInt *, blacsInt *);
+void pzgetrs_(char *, blacsInt *, blacsInt *, std::complex<double> *,
+              blacsInt *, blacsInt *, blacsInt *, blacsInt *,
+              std::complex<double> *, blacsInt *, blacsInt *, blacsInt *,
+              blacsInt *);
+void pcgetrs_(char *, blacsInt *, blacsInt *, std::complex<float> *, blacsInt *,
+              blacsInt *, blacsInt *, blacsInt *, std::complex<float> *,
+              blacsInt *, blacsInt *, blacsInt *, blacsInt *);
+
+// complex versions of pzheevd, pdsyevr and pdtran
+void pzheevd_(char *, char *, blacsInt *, std::complex<double> *, blacsInt *,
+              blacsInt *, blacsInt *, double *, std::complex<double> *,
+              blacsInt *, blacsInt *, blacsInt *, std::complex<double> *,
+              blacsInt *, double *, blacsInt *, blacsInt *, blacsInt *,
+              blacsInt *);
+void pzheevr_(const char*, const char*, const char*, const blacsInt*,
+              std::complex<double>*, blacsInt*, blacsInt*, blacsInt*, double*,
+              double*, blacsInt*, blacsInt*, blacsInt*, blacsInt*, double*,
+              std::complex<double>*, blacsInt*, blacsInt*, blacsInt*,
+              std::complex<double>*, blacsInt*, double*, blacsInt*, blacsInt*,
+              blacsInt*, blacsInt*);
+void pcheevr_(const char*, const char*, const char*, const blacsInt*,
+              std::complex<float>*, blacsInt*, blacsInt*, blacsInt*, float*,
+              float*, blacsInt*, blacsInt*, blacsInt*, blacsInt*, float*,
+              std::complex<float>*, blacsInt*, blacsInt*, blacsInt*,
+              std::complex<float>*, blacsInt*, float*, blacsInt*, blacsInt*,
+              blacsInt*, blacsInt*);
+// conjugate transpose
+void pztranc_(blacsInt *, blacsInt *, std::complex<double> *,
+              std::complex<double> *, blacsInt *, blacsInt *, blacsInt *,
+              std::complex<double> *, std::complex<double> *, blacsInt *,
+              blacsInt *, blacsInt *);
+void pctranc_(blacsInt *, blacsInt *, std::complex<float> *,
+              std::complex<float> *, blacsInt *, blacsInt *, blacsInt *,
+              std::complex<float> *, std::complex<float> *, blacsInt *,
+              blacsInt *, blacsInt *);
+
+// reduction of a symmetric (hermitian) matrix to real tridiagonal form
+void pdsytrd_(char *, blacsInt *, double *, blacsInt *, blacsInt *,
+              blacsInt *, double *, double *, double *, double *, blacsInt *,
+              blacsInt *);
+void pssytrd_(char *, blacsInt *, float *, blacsInt *, blacsInt *, blacsInt *,
+              float *, float *, float *, float *, blacsInt *, blacsInt *);
+void pzhetrd_(char *, blacsInt *, std::complex<double> *, blacsInt *,
+              blacsInt *, blacsInt *, double *, double *,
+              std::complex<double> *, std::complex<double> *, blacsInt *,
+              blacsInt *);
+void pchetrd_(char *, blacsInt *, std::complex<float> *, blacsInt *,
+              blacsInt *, blacsInt *, float *, float *, std::complex<float> *,
+              std::complex<float> *, blacsInt *, blacsInt *);
+// rank-k update of one triangle, C = alpha A A^T + beta C (A A^H, with
+// real alpha and beta, for the complex p?herk)
+void pdsyrk_(const char *, const char *, blacsInt *, blacsInt *, double *,
+             double *, blacsInt *, blacsInt *, blacsInt *, double *, double *,
+             blacsInt *, blacsInt *, blacsInt *);
+void pssyrk_(const char *, const char *, blacsInt *, blacsInt *, float *,
+             float *, blacsInt *, blacsInt *, blacsInt *, float *, float *,
+             blacsInt *, blacsInt *, blacsInt *);
+void pzherk_(const char *, const char *, blacsInt *, blacsInt *, double *,
+             std::complex<double> *, blacsInt *, blacsInt *, blacsInt *,
+             double *, std::complex<double> *, blacsInt *, blacsInt *,
+             blacsInt *);
+void pcherk_(const char *, const char *, blacsInt *, blacsInt *, float *,
+             std::complex<float> *, blacsInt *, blacsInt *, blacsInt *,
+             float *, std::complex<float> *, blacsInt *, blacsInt *,
+             blacsInt *);
+
+// BLACS broadcasts of a general m x n matrix, sent with ?gebs2d_ and
+// received with ?gebr2d_ from process (rsrc,csrc), within a scope of the
+// grid ("Row", "Column" or "All")
+void dgebs2d_(const blacsInt *, const char *, const char *, const blacsInt *,
+              const blacsInt *, double *, const blacsInt *);
+void dgebr2d_(const blacsInt *, const char *, const char *, const blacsInt *,
+              const blacsInt *, double *, const blacsInt *, const blacsInt *,
+              const blacsInt *);
+void sgebs2d_(const blacsInt *, const char *, const char *, const blacsInt *,
+              const blacsInt *, float *, const blacsInt *);
+void sgebr2d_(const blacsInt *, const char *, const char *, const blacsInt *,
+              const blacsInt *, float *, const blacsInt *, const blacsInt *,
+              const blacsInt *);
+void zgebs2d_(const blacsInt *, const char *, const char *, const blacsInt *,
+              const blacsInt *, std::complex<double> *, const blacsInt *);
+void zgebr2d_(const blacsInt *, const char *, const char *, const blacsInt *,
+              const blacsInt *, std::complex<double> *, const blacsInt *,
+              const blacsInt *, const blacsInt *);
+void cgebs2d_(const blacsInt *, const char *, const char *, const blacsInt *,
+              const blacsInt *, std::complex<float> *, const blacsInt *);
+void cgebr2d_(const blacsInt *, const char *, const char *, const blacsInt *,
+              const blacsInt *, std::complex<float> *, const blacsInt *,
+              const blacsInt *, const blacsInt *);
+
+// serial BLAS matrix product, used to calibrate the machine peak
+void dgemm_(const char *, const char *, const blacsInt *, const blacsInt *,
+            const blacsInt *, const double *, const double *, const blacsInt *,
+            const double *, const blacsInt *, const double *, double *,
+            const blacsInt *);
 
 }
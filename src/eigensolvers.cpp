@@ -0,0 +1,604 @@
+#include "eigensolvers.h"
+
+#include <Eigen/Dense>
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <iostream>
+#include <limits>
+#include <type_traits>
+#include "mpi/mpiHelper.h"
+#include "profiler.h"
+#include "utilities.h"
+
+#ifdef MPI_AVAIL
+
+namespace {
+
+// machine epsilon of the (real) precision of T
+template <typename T>
+double epsilonOf() {
+  using Real = decltype(std::real(T()));
+  return double(std::numeric_limits<Real>::epsilon());
+}
+
+// Fills a block with pseudo-random numbers in [-0.5, 0.5), hashed from the
+// global indices and the seed: the same on any number of processes.
+template <typename T>
+void fillRandom(ParallelMatrix<T>& x, const uint64_t& seed) {
+  for (auto [i, j] : x.getAllLocalElements()) {
+    uint64_t h = (uint64_t(i) + 1) * 0x9E3779B97F4A7C15ULL;
+    h ^= (uint64_t(j) + 1 + (seed << 20)) * 0xC2B2AE3D27D4EB4FULL;
+    h ^= h >> 29;
+    h *= 0xBF58476D1CE4E5B9ULL;
+    h ^= h >> 32;
+    x(i, j) = T(double(h >> 11) * 0x1.0p-53 - 0.5);
+  }
+}
+
+// 2-norm of a N x 1 block
+template <typename T>
+double vectorNorm(ParallelMatrix<T>& x) {
+  auto xx = x.prod(x, ParallelMatrix<T>::transC, ParallelMatrix<T>::transN);
+  return std::sqrt(std::abs(std::real(xx.toEigen()(0, 0))));
+}
+
+// Removes from w its components on the columns of an orthonormal basis,
+// and returns the (distributed) coefficients basis^H w
+template <typename T>
+ParallelMatrix<T> orthogonalize(ParallelMatrix<T>& basis,
+                                ParallelMatrix<T>& w) {
+  auto h = basis.prod(w, ParallelMatrix<T>::transC, ParallelMatrix<T>::transN);
+  w -= basis.prod(h);
+  return h;
+}
+
+// double precision scalar of the kind of T, for the projected problems
+template <typename T>
+using ProjectedScalar =
+    std::conditional_t<isComplex<T>::value, std::complex<double>, double>;
+
+// Rayleigh-Ritz on the columns of s, with as = A s: sets theta and the
+// s.cols() x numVectors coefficients of the lowest Ritz vectors, and the
+// Gram matrix s^H s, whose layout fits the coefficients. Directions that are
+// numerically linearly dependent are dropped; returns false if fewer than
+// numVectors remain.
+template <typename T>
+bool rayleighRitz(ParallelMatrix<T>& s, ParallelMatrix<T>& as,
+                  const int& numVectors, Eigen::VectorXd& theta,
+                  Eigen::Matrix<ProjectedScalar<T>, -1, -1>& coefficients,
+                  ParallelMatrix<T>& gram) {
+  using Matrix = Eigen::Matrix<ProjectedScalar<T>, -1, -1>;
+  gram = s.prod(s, ParallelMatrix<T>::transC, ParallelMatrix<T>::transN);
+  Matrix g = gram.toEigen().template cast<ProjectedScalar<T>>();
+  Matrix h = s.prod(as, ParallelMatrix<T>::transC, ParallelMatrix<T>::transN)
+                 .toEigen()
+                 .template cast<ProjectedScalar<T>>();
+
+  // columns scaled to unit norm, so that small directions aren't dropped
+  // only for their scale
+  Eigen::VectorXd columnScales(g.rows());
+  for (int i = 0; i < g.rows(); i++) {
+    double norm2 = std::real(g(i, i));
+    columnScales(i) = norm2 > 0. ? 1. / std::sqrt(norm2) : 0.;
+  }
+  g = columnScales.asDiagonal() * g * columnScales.asDiagonal();
+
+  // orthonormal combinations from the eigenvectors of the Gram matrix
+  Eigen::SelfAdjointEigenSolver<Matrix> gramSolver(g);
+  const Eigen::VectorXd& lambda = gramSolver.eigenvalues();
+  double threshold =
+      lambda(lambda.size() - 1) * 100. * double(s.cols()) * epsilonOf<T>();
+  int numDropped = 0;
+  while (numDropped < lambda.size() && lambda(numDropped) <= threshold) {
+    numDropped++;
+  }
+  int rank = int(lambda.size()) - numDropped;
+  if (rank < numVectors) return false;
+  Matrix q = gramSolver.eigenvectors().rightCols(rank);
+  for (int i = 0; i < rank; i++) q.col(i) /= std::sqrt(lambda(numDropped + i));
+  q = columnScales.asDiagonal() * q;
+
+  Matrix hq = q.adjoint() * h * q;
+  hq = (0.5 * (hq + hq.adjoint())).eval();
+  Eigen::SelfAdjointEigenSolver<Matrix> solver(hq);
+  theta = solver.eigenvalues().head(numVectors);
+  coefficients = q * solver.eigenvectors().leftCols(numVectors);
+  return true;
+}
+
+// Overwrites r = A X with the residuals A X - X Theta, and returns their
+// norms, reduced with a single collective
+template <typename T>
+std::vector<double> residuals(ParallelMatrix<T>& x, ParallelMatrix<T>& r,
+                              const Eigen::VectorXd& theta) {
+  std::vector<double> norms(r.cols(), 0.);
+  for (auto [i, j] : r.getAllLocalElements()) {
+    r(i, j) -= x(i, j) * T(theta(j));
+    norms[j] += std::norm(r(i, j));
+  }
+  mpi->allReduceSum(&norms);
+  for (double& norm : norms) norm = std::sqrt(norm);
+  return norms;
+}
+
+}  // namespace
+
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>> lanczos(
+    const LinearOperator<T>& op, const int& numEigenvalues,
+    const std::type_identity_t<ParallelMatrix<T>>* startVector,
+    const LanczosOptions& options) {
+
+  const int n = op.rows();
+  const int k = numEigenvalues;
+  if (k < 1 || k > n) {
+    Error("lanczos: the number of eigenvalues must be between 1 and N.");
+  }
+  int m = options.basisSize > 0 ? options.basisSize : std::max(2 * k, k + 20);
+  m = std::min(m, n);
+  if (m <= k && m < n) {
+    Error("lanczos: the basis must be larger than the number of eigenvalues.");
+  }
+  RegionTimer timer("lanczos");
+
+  const double eps = epsilonOf<T>();
+  const double sqrtEps = std::sqrt(eps);
+
+  // Lanczos vectors are the columns of basis, the last one being the
+  // residual vector of the cycle. Unused columns are zero, so that
+  // projections on the basis are a single product.
+  ParallelMatrix<T> basis = op.newBlock(m + 1);
+  ParallelMatrix<T> v = op.newBlock(1);
+  if (startVector != nullptr) {
+    if (startVector->rows() != n || startVector->cols() != 1) {
+      Error("lanczos: the start vector must be a N x 1 block.");
+    }
+    v = *startVector;
+  } else {
+    fillRandom(v, 0);
+  }
+  double startNorm = vectorNorm(v);
+  if (startNorm == 0.) Error("lanczos: the start vector is zero.");
+  v /= T(startNorm);
+  basis.setColumns(0, v);
+  // (m+1) x (m+1) coefficients, with the column blocking of basis
+  ParallelMatrix<T> rotation =
+      basis.prod(v, ParallelMatrix<T>::transC, ParallelMatrix<T>::transN)
+          .newBlock(m + 1);
+
+  // projected matrix: diagonal of Ritz values and arrowhead couplings for the
+  // kept vectors, tridiagonal for the Lanczos vectors that follow
+  Eigen::MatrixXd t = Eigen::MatrixXd::Zero(m, m);
+  // estimated overlaps of the current (omega) and previous (omegaOld)
+  // Lanczos vectors with the others
+  std::vector<double> omega(m + 1, eps), omegaOld(m + 1, eps);
+  omega[0] = 1.;
+
+  ParallelMatrix<T> vOld = op.newBlock(1);
+  ParallelMatrix<T> kept;  // kept Ritz vectors
+  int numKept = 0;
+  double normEstimate = 0.;
+  double beta = 0.;
+  Eigen::VectorXd theta;
+  Eigen::MatrixXd y;
+  bool converged = false;
+
+  for (int restart = 0;; restart++) {
+    for (int j = numKept; j < m; j++) {
+      ParallelMatrix<T> w = op.apply(v);
+
+      std::vector<double> omegaNew(m + 1, eps);
+      bool fullOrthogonalization = false;
+      if (j == numKept) {
+        // first vector of the cycle: couples with all the kept Ritz vectors
+        auto h = orthogonalize(basis, w).toEigen();
+        for (int i = 0; i < j; i++) t(i, j) = t(j, i) = std::real(h(i, 0));
+        t(j, j) = std::real(h(j, 0));
+        fullOrthogonalization = true;
+      } else {
+        auto alpha = v.prod(w, ParallelMatrix<T>::transC,
+                            ParallelMatrix<T>::transN).toEigen()(0, 0);
+        t(j, j) = std::real(alpha);
+        ParallelMatrix<T> correction = v;
+        correction *= T(t(j, j));
+        w -= correction;
+        correction = vOld;
+        correction *= T(t(j, j - 1));
+        w -= correction;
+        if (numKept > 0) orthogonalize(kept, w);
+      }
+      beta = vectorNorm(w);
+      normEstimate = std::max(normEstimate, std::abs(t(j, j)) + beta +
+                                                (j > 0 ? std::abs(t(j, j - 1)) : 0.));
+
+      if (!fullOrthogonalization && beta > 0.) {
+        // omega recurrence for the overlaps of the next vector
+        double maxOmega = 0.;
+        for (int i = numKept; i < j; i++) {
+          double x = t(i, i + 1) * omega[i + 1] + (t(i, i) - t(j, j)) * omega[i]
+                     - t(j, j - 1) * omegaOld[i];
+          if (i > numKept) x += t(i, i - 1) * omega[i - 1];
+          x += std::copysign(eps * normEstimate, x);
+          omegaNew[i] = x / beta;
+          maxOmega = std::max(maxOmega, std::abs(omegaNew[i]));
+        }
+        omegaNew[j] = eps * normEstimate / beta;
+        if (maxOmega > sqrtEps) {
+          orthogonalize(basis, w);
+          beta = vectorNorm(w);
+          for (int i = 0; i <= j; i++) omegaNew[i] = eps;
+        }
+      }
+
+      if (beta <= eps * normEstimate) {
+        // invariant subspace: continue with a new random direction
+        beta = 0.;
+        w = op.newBlock(1);
+        if (j + 1 < n) {
+          fillRandom(w, uint64_t(j + 1) + uint64_t(restart) * uint64_t(m));
+          orthogonalize(basis, w);
+          orthogonalize(basis, w);
+          w /= T(vectorNorm(w));
+        }
+        std::fill(omegaNew.begin(), omegaNew.end(), eps);
+      } else {
+        w /= T(beta);
+      }
+      if (j + 1 < m) t(j, j + 1) = t(j + 1, j) = beta;
+      basis.setColumns(j + 1, w);
+      vOld = v;
+      v = w;
+      omegaOld = omega;
+      omega = omegaNew;
+      omega[j + 1] = 1.;
+    }
+
+    // Rayleigh-Ritz on the projected matrix, solved on every process
+    Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(t);
+    theta = solver.eigenvalues();
+    y = solver.eigenvectors();
+
+    // residual norms of the Ritz pairs are |beta y_{m-1,i}|
+    int numConverged = 0;
+    for (int i = 0; i < k; i++) {
+      if (std::abs(beta * y(m - 1, i)) <= options.tolerance * normEstimate) {
+        numConverged++;
+      }
+    }
+    if (numConverged == k || m == n) {
+      converged = true;
+      break;
+    }
+    if (restart >= options.maxRestarts) break;
+
+    // thick restart: keep the lowest Ritz vectors and the residual vector
+    int newKept = std::min(m - 1, k + (m - k) / 2);
+    Eigen::MatrixXd r = Eigen::MatrixXd::Zero(m + 1, m + 1);
+    r.topLeftCorner(m, newKept) = y.leftCols(newKept);
+    r(m, newKept) = 1.;
+    rotation.fromEigen(r.cast<T>());
+    basis = basis.prod(rotation);
+    t.setZero();
+    for (int i = 0; i < newKept; i++) t(i, i) = theta(i);
+    numKept = newKept;
+    kept = basis.getColumns(0, numKept);
+    v = basis.getColumns(numKept, 1);
+    std::fill(omega.begin(), omega.end(), eps);
+    omega[numKept] = 1.;
+  }
+
+  if (!converged && mpi->mpiHead()) {
+    std::cout << "Warning: lanczos didn't converge in " << options.maxRestarts
+              << " restarts.\n";
+  }
+
+  std::vector<double> eigenvalues(theta.data(), theta.data() + k);
+  Eigen::MatrixXd r = Eigen::MatrixXd::Zero(m + 1, k);
+  r.topRows(m) = y.leftCols(k);
+  ParallelMatrix<T> ritzCoefficients = rotation.newBlock(k);
+  ritzCoefficients.fromEigen(r.cast<T>());
+  ParallelMatrix<T> eigenvectors = basis.prod(ritzCoefficients);
+  return {eigenvalues, eigenvectors};
+}
+
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>> lobpcg(
+    const LinearOperator<T>& op, const int& numEigenvalues,
+    const std::type_identity_t<ParallelMatrix<T>>* initialVectors,
+    const std::type_identity_t<LinearOperator<T>>* preconditioner,
+    const LobpcgOptions& options, int* numIterations) {
+  using Matrix = Eigen::Matrix<ProjectedScalar<T>, -1, -1>;
+
+  const int n = op.rows();
+  const int k = numEigenvalues;
+  if (k < 1 || 3 * k > n) {
+    Error("lobpcg: the number of eigenvalues must be between 1 and N/3.");
+  }
+  if (!options.diagonal.empty() && int(options.diagonal.size()) != n) {
+    Error("lobpcg: the diagonal must have N elements.");
+  }
+  RegionTimer timer("lobpcg");
+  const double eps = epsilonOf<T>();
+  const double tolerance = std::max(options.tolerance, 100. * eps);
+
+  ParallelMatrix<T> x = op.newBlock(k);
+  if (initialVectors != nullptr) {
+    if (initialVectors->rows() != n || initialVectors->cols() != k) {
+      Error("lobpcg: the initial vectors must be a N x k block.");
+    }
+    x = *initialVectors;
+  } else {
+    fillRandom(x, 0);
+  }
+  ParallelMatrix<T> ax = op.apply(x);
+  ParallelMatrix<T> p, ap;  // previous directions, and A times them
+  int numP = 0;
+  ParallelMatrix<T> gram;
+  Eigen::VectorXd theta;
+  Matrix c;
+
+  // Rayleigh-Ritz on the start block, which needn't be orthonormal
+  if (!rayleighRitz(x, ax, k, theta, c, gram)) {
+    Error("lobpcg: the initial vectors are linearly dependent.");
+  }
+  {
+    ParallelMatrix<T> coefficients = gram.newBlock(k);
+    coefficients.fromEigen(c.template cast<T>());
+    x = x.prod(coefficients);
+    ax = ax.prod(coefficients);
+  }
+
+  int iteration = 0;
+  bool converged = false;
+  for (;; iteration++) {
+    ParallelMatrix<T> r = ax;
+    std::vector<double> norms = residuals(x, r, theta);
+    double scale = std::max(theta.cwiseAbs().maxCoeff(),
+                            std::numeric_limits<double>::min());
+    int numConverged = 0;
+    for (int j = 0; j < k; j++) {
+      if (norms[j] <= tolerance * scale) numConverged++;
+    }
+    if (numConverged == k) {
+      converged = true;
+      break;
+    }
+    if (iteration >= options.maxIterations) break;
+
+    // preconditioned residuals
+    ParallelMatrix<T> w = r;
+    if (preconditioner != nullptr) {
+      w = preconditioner->apply(r);
+    } else if (!options.diagonal.empty()) {
+      double floor = std::sqrt(eps) * scale;
+      for (auto [i, j] : w.getAllLocalElements()) {
+        double d = std::abs(options.diagonal[i] - theta(j));
+        d = std::max(d, floor);
+        w(i, j) /= T(d);
+      }
+    }
+    ParallelMatrix<T> aw = op.apply(w);
+
+    // Rayleigh-Ritz on [X, W, P]; without P if the subspace is degenerate
+    bool solved = false;
+    while (!solved) {
+      int numCols = 2 * k + numP;
+      ParallelMatrix<T> s = op.newBlock(numCols);
+      ParallelMatrix<T> as = op.newBlock(numCols);
+      s.setColumns(0, x);
+      s.setColumns(k, w);
+      as.setColumns(0, ax);
+      as.setColumns(k, aw);
+      if (numP > 0) {
+        s.setColumns(2 * k, p);
+        as.setColumns(2 * k, ap);
+      }
+      solved = rayleighRitz(s, as, k, theta, c, gram);
+      if (solved) {
+        // new Ritz vectors X = S C, and directions P = [W, P] C_{W,P}
+        Matrix cc = Matrix::Zero(numCols, 2 * k);
+        cc.leftCols(k) = c;
+        cc.bottomRightCorner(numCols - k, k) = c.bottomRows(numCols - k);
+        ParallelMatrix<T> coefficients = gram.newBlock(2 * k);
+        coefficients.fromEigen(cc.template cast<T>());
+        ParallelMatrix<T> sc = s.prod(coefficients);
+        ParallelMatrix<T> asc = as.prod(coefficients);
+        x = sc.getColumns(0, k);
+        p = sc.getColumns(k, k);
+        ax = asc.getColumns(0, k);
+        ap = asc.getColumns(k, k);
+        numP = k;
+      } else if (numP > 0) {
+        numP = 0;
+      } else {
+        break;
+      }
+    }
+    if (!solved) break;
+  }
+
+  if (!converged && mpi->mpiHead()) {
+    std::cout << "Warning: lobpcg didn't converge in " << iteration
+              << " iterations.\n";
+  }
+  if (numIterations != nullptr) *numIterations = iteration;
+  std::vector<double> eigenvalues(theta.data(), theta.data() + k);
+  return {eigenvalues, x};
+}
+
+template <typename T>
+std::tuple<double, double> spectralBounds(const LinearOperator<T>& op,
+                                          const int& numSteps) {
+  const int m = std::min(numSteps, op.rows());
+  if (m < 1) Error("spectralBounds: needs at least one Lanczos step.");
+  RegionTimer timer("spectralBounds");
+
+  // plain Lanczos recurrence, without reorthogonalization: a loss of
+  // orthogonality only duplicates Ritz values
+  ParallelMatrix<T> v = op.newBlock(1);
+  fillRandom(v, 1);
+  v /= T(vectorNorm(v));
+  ParallelMatrix<T> vOld = op.newBlock(1);
+  Eigen::MatrixXd t = Eigen::MatrixXd::Zero(m, m);
+  double beta = 0.;
+  int numUsed = m;
+  for (int j = 0; j < m; j++) {
+    ParallelMatrix<T> w = op.apply(v);
+    t(j, j) = std::real(v.prod(w, ParallelMatrix<T>::transC,
+                               ParallelMatrix<T>::transN).toEigen()(0, 0));
+    ParallelMatrix<T> correction = v;
+    correction *= T(t(j, j));
+    w -= correction;
+    if (j > 0) {
+      correction = vOld;
+      correction *= T(beta);
+      w -= correction;
+    }
+    beta = vectorNorm(w);
+    if (beta <= epsilonOf<T>() * std::abs(t(j, j)) || j == m - 1) {
+      numUsed = j + 1;
+      break;
+    }
+    t(j, j + 1) = t(j + 1, j) = beta;
+    w /= T(beta);
+    vOld = v;
+    v = w;
+  }
+
+  Eigen::SelfAdjointEigenSolver<Eigen::MatrixXd> solver(
+      t.topLeftCorner(numUsed, numUsed));
+  const Eigen::VectorXd& theta = solver.eigenvalues();
+  double residual = std::abs(beta * solver.eigenvectors()(numUsed - 1,
+                                                          numUsed - 1));
+  return {theta(0), theta(numUsed - 1) + residual};
+}
+
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>> chebyshevFilteredSubspace(
+    const LinearOperator<T>& op, const int& numEigenvalues,
+    const std::type_identity_t<ParallelMatrix<T>>& initialVectors,
+    const double& upperBound, const ChebyshevOptions& options,
+    int* numIterations) {
+  using Matrix = Eigen::Matrix<ProjectedScalar<T>, -1, -1>;
+
+  const int n = op.rows();
+  const int k = numEigenvalues;
+  const int m = initialVectors.cols();
+  if (initialVectors.rows() != n) {
+    Error("chebyshevFilteredSubspace: the initial vectors must have N rows.");
+  }
+  if (k < 1 || k > m) {
+    Error("chebyshevFilteredSubspace: the number of eigenvalues must be "
+          "between 1 and the number of initial vectors.");
+  }
+  if (options.degree < 1) {
+    Error("chebyshevFilteredSubspace: the filter degree must be positive.");
+  }
+  RegionTimer timer("chebyshevFilteredSubspace");
+  const double tolerance = std::max(options.tolerance, 100. * epsilonOf<T>());
+
+  ParallelMatrix<T> x = initialVectors;
+  ParallelMatrix<T> ax = op.apply(x);
+  ParallelMatrix<T> gram;
+  Eigen::VectorXd theta;
+  Matrix c;
+
+  int iteration = 0;
+  bool converged = false;
+  for (;; iteration++) {
+    // Rayleigh-Ritz on the (filtered) block
+    if (!rayleighRitz(x, ax, m, theta, c, gram)) {
+      Error("chebyshevFilteredSubspace: the block became linearly dependent; "
+            "use a lower filter degree or fewer vectors.");
+    }
+    ParallelMatrix<T> coefficients = gram.newBlock(m);
+    coefficients.fromEigen(c.template cast<T>());
+    x = x.prod(coefficients);
+    ax = ax.prod(coefficients);
+
+    ParallelMatrix<T> r = ax;
+    std::vector<double> norms = residuals(x, r, theta);
+    double scale = std::max(theta.cwiseAbs().maxCoeff(),
+                            std::numeric_limits<double>::min());
+    int numConverged = 0;
+    for (int j = 0; j < k; j++) {
+      if (norms[j] <= tolerance * scale) numConverged++;
+    }
+    if (numConverged == k) {
+      converged = true;
+      break;
+    }
+    if (iteration >= options.maxIterations) break;
+
+    // Chebyshev filter on [cutoff, upperBound], scaled by its value at the
+    // lowest Ritz value to keep the block at unit scale. The three term
+    // recurrence reuses A X from the Rayleigh-Ritz step.
+    double cutoff = theta(m - 1);
+    if (cutoff >= upperBound) {
+      Error("chebyshevFilteredSubspace: the upper bound is below the "
+            "Ritz values.");
+    }
+    double e = 0.5 * (upperBound - cutoff);
+    double center = 0.5 * (upperBound + cutoff);
+    double sigma = e / (theta(0) - center);
+    double sigmaScale = sigma;
+    ParallelMatrix<T> y = ax;
+    ParallelMatrix<T> work = x;
+    work *= T(center);
+    y -= work;
+    y *= T(sigma / e);
+    for (int degree = 2; degree <= options.degree; degree++) {
+      double sigmaNew = 1. / (2. / sigmaScale - sigma);
+      // yNew = 2 sigmaNew / e (A - center) y - sigma sigmaNew x
+      ParallelMatrix<T> yNew = op.apply(y);
+      work = y;
+      work *= T(center);
+      yNew -= work;
+      yNew *= T(2. * sigmaNew / e);
+      work = x;
+      work *= T(sigma * sigmaNew);
+      yNew -= work;
+      x = y;
+      y = yNew;
+      sigma = sigmaNew;
+    }
+    x = y;
+    ax = op.apply(x);
+  }
+
+  if (!converged && mpi->mpiHead()) {
+    std::cout << "Warning: chebyshevFilteredSubspace didn't converge in "
+              << iteration << " iterations.\n";
+  }
+  if (numIterations != nullptr) *numIterations = iteration;
+  std::vector<double> eigenvalues(theta.data(), theta.data() + m);
+  return {eigenvalues, x};
+}
+
+// Explicit instantiations, for every type of ParallelMatrix
+#define INSTANTIATE_EIGENSOLVERS(T)                                           \
+  template std::tuple<std::vector<double>, ParallelMatrix<T>> lanczos(        \
+      const LinearOperator<T>&, const int&,                                   \
+      const std::type_identity_t<ParallelMatrix<T>>*, const LanczosOptions&); \
+  template std::tuple<std::vector<double>, ParallelMatrix<T>> lobpcg(         \
+      const LinearOperator<T>&, const int&,                                   \
+      const std::type_identity_t<ParallelMatrix<T>>*,                         \
+      const std::type_identity_t<LinearOperator<T>>*, const LobpcgOptions&,   \
+      int*);                                                                  \
+  template std::tuple<double, double> spectralBounds(                         \
+      const LinearOperator<T>&, const int&);                                  \
+  template std::tuple<std::vector<double>, ParallelMatrix<T>>                 \
+  chebyshevFilteredSubspace(const LinearOperator<T>&, const int&,             \
+                            const std::type_identity_t<ParallelMatrix<T>>&,   \
+                            const double&, const ChebyshevOptions&, int*);
+
+INSTANTIATE_EIGENSOLVERS(double)
+INSTANTIATE_EIGENSOLVERS(float)
+INSTANTIATE_EIGENSOLVERS(std::complex<double>)
+INSTANTIATE_EIGENSOLVERS(std::complex<float>)
+
+#undef INSTANTIATE_EIGENSOLVERS
+
+#endif  // MPI_AVAIL
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <tuple>
+#include <type_traits>
+#include <vector>
+#include "LinearOperator.h"
+#include "PMatrix.h"
+
+/** Iterative eigensolvers for the lowest eigenpairs of a Hermitian operator,
+ * which only use products with blocks of vectors (see LinearOperator.h).
+ *
+ * Vectors are N x k ParallelMatrices made by the operator. Small projected
+ * matrices are copied on all processes (ParallelMatrix::toEigen) and solved
+ * redundantly with Eigen, in double precision.
+ */
+
+/** Parameters of the thick-restart Lanczos solver.
+ */
+struct LanczosOptions {
+  // number of Lanczos vectors per restart cycle; 0 uses max(2k, k+20),
+  // at most N
+  int basisSize = 0;
+  // relative tolerance on the residual norms |A x - theta x|, in units of
+  // the estimated norm of the operator
+  double tolerance = 1e-10;
+  // maximum number of restarts, after which the best Ritz pairs are returned
+  int maxRestarts = 100;
+};
+
+/** Thick-restart Lanczos, for the numEigenvalues lowest eigenpairs of a
+ * Hermitian operator.
+ *
+ * Each cycle extends a Krylov basis to basisSize vectors and solves the
+ * projected problem; the cycle restarts keeping about half the Ritz vectors,
+ * the lowest ones, plus the residual vector. Orthogonality is kept selectively:
+ * new vectors are orthogonalized against the kept Ritz vectors, and against
+ * the whole basis only when the estimated loss of orthogonality (Simon's
+ * omega recurrence) exceeds sqrt(epsilon).
+ *
+ * @param op: the operator, Hermitian.
+ * @param numEigenvalues: number k of eigenpairs.
+ * @param startVector: optional N x 1 start vector made by op.newBlock(1);
+ * if null, a pseudo-random vector that doesn't depend on the distribution.
+ * @return eigenvalues: the k lowest eigenvalues, in ascending order.
+ * @return eigenvectors: N x k block of the corresponding eigenvectors.
+ */
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>> lanczos(
+    const LinearOperator<T>& op, const int& numEigenvalues,
+    const std::type_identity_t<ParallelMatrix<T>>* startVector = nullptr,
+    const LanczosOptions& options = LanczosOptions());
+
+/** Parameters of the LOBPCG solver.
+ */
+struct LobpcgOptions {
+  // relative tolerance on the residual norms |A x - theta x|, in units of
+  // the largest Ritz value; at least 100 epsilon of the precision of T
+  double tolerance = 1e-8;
+  // maximum number of iterations, after which the best Ritz pairs are
+  // returned
+  int maxIterations = 200;
+  // diagonal of the operator, if not empty: residuals are preconditioned
+  // with |d_i - theta_j|^-1, a positive variant of Davidson's preconditioner
+  // (LOBPCG needs a positive definite one)
+  std::vector<double> diagonal;
+};
+
+/** Locally optimal block preconditioned conjugate gradient (LOBPCG), for
+ * the numEigenvalues lowest eigenpairs of a Hermitian operator.
+ *
+ * Each iteration applies the operator to the k preconditioned residuals
+ * only, and solves the projected problem on the 3k vectors [X, W, P]
+ * (Ritz vectors, preconditioned residuals and previous directions),
+ * orthonormalized through their Gram matrix: directions that have become
+ * linearly dependent are dropped instead of breaking down.
+ *
+ * @param op: the operator, Hermitian.
+ * @param numEigenvalues: number k of eigenpairs.
+ * @param initialVectors: optional N x k block made by op.newBlock(k), e.g.
+ * the eigenvectors of a previous, similar operator (warm start); if null,
+ * pseudo-random vectors.
+ * @param preconditioner: optional operator approximating (A - sigma)^-1,
+ * applied to the block of residuals; it takes precedence over
+ * options.diagonal.
+ * @param numIterations: if not null, set to the number of iterations.
+ * @return eigenvalues: the k lowest eigenvalues, in ascending order.
+ * @return eigenvectors: N x k block of the corresponding eigenvectors.
+ */
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>> lobpcg(
+    const LinearOperator<T>& op, const int& numEigenvalues,
+    const std::type_identity_t<ParallelMatrix<T>>* initialVectors = nullptr,
+    const std::type_identity_t<LinearOperator<T>>* preconditioner = nullptr,
+    const LobpcgOptions& options = LobpcgOptions(),
+    int* numIterations = nullptr);
+
+/** Estimates the interval containing the spectrum of a Hermitian operator,
+ * with numSteps Lanczos steps from a pseudo-random vector: the lowest Ritz
+ * value, which is above the lowest eigenvalue, and an upper bound, the
+ * largest Ritz value plus the norm of its residual.
+ * @return bounds: tuple of the lower estimate and the upper bound.
+ */
+template <typename T>
+std::tuple<double, double> spectralBounds(const LinearOperator<T>& op,
+                                          const int& numSteps = 20);
+
+/** Parameters of the Chebyshev-filtered subspace iteration.
+ */
+struct ChebyshevOptions {
+  // degree of the filter polynomial, i.e. number of operator applications
+  // to the block per iteration
+  int degree = 10;
+  // relative tolerance on the residual norms, as in LobpcgOptions
+  double tolerance = 1e-8;
+  int maxIterations = 50;
+};
+
+/** Chebyshev-filtered subspace iteration, which updates the numEigenvalues
+ * lowest eigenpairs of a Hermitian operator from approximate eigenvectors,
+ * e.g. those of the previous step of a self-consistent loop.
+ *
+ * Each iteration applies a Chebyshev polynomial of the operator to the
+ * block, which damps the components of eigenvalues in [a, upperBound],
+ * with a the largest Ritz value of the block, then solves the projected
+ * problem on the filtered block (Rayleigh-Ritz). The products are done by
+ * the operator, i.e. with prod() for a dense matrix, and no diagonalization
+ * of size N is needed.
+ *
+ * @param op: the operator, Hermitian.
+ * @param numEigenvalues: number k of converged eigenpairs needed.
+ * @param initialVectors: N x m block made by op.newBlock(m), with m >= k;
+ * a few more vectors than k speed up the convergence of the last ones.
+ * @param upperBound: upper bound of the spectrum, e.g. from spectralBounds()
+ * or the previous step.
+ * @param numIterations: if not null, set to the number of iterations.
+ * @return eigenvalues: the m lowest Ritz values, in ascending order, of
+ * which the first k are converged.
+ * @return eigenvectors: N x m block of the corresponding Ritz vectors.
+ */
+template <typename T>
+std::tuple<std::vector<double>, ParallelMatrix<T>> chebyshevFilteredSubspace(
+    const LinearOperator<T>& op, const int& numEigenvalues,
+    const std::type_identity_t<ParallelMatrix<T>>& initialVectors,
+    const double& upperBound,
+    const ChebyshevOptions& options = ChebyshevOptions(),
+    int* numIterations = nullptr);
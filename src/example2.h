@@ -1,6 +1,7 @@
 #pragma once
 #include "mpi/mpiHelper.h"
 #include "PMatrix.h"
+#include "profiler.h"
 
  // --------------------- Example 2 ------------------------------
 
@@ -16,16 +17,22 @@ void example2() {
   Eigen::MatrixXi serialMatrix(nRows, nCols); serialMatrix.setZero();
 
   // iterate over rows and columns
-  for(auto [rowIdx,colIdx] : theMatrix.getAllLocalElements()) {
+  {
+    RegionTimer timer("fill");
+    for(auto [rowIdx,colIdx] : theMatrix.getAllLocalElements()) {
 
-    // fill a copy of this serial matrix with the rank of the process that owns the parallel matrix element
-    serialMatrix(rowIdx, colIdx) = mpi->getRank();
+      // fill a copy of this serial matrix with the rank of the process that owns the parallel matrix element
+      serialMatrix(rowIdx, colIdx) = mpi->getRank();
 
+    }
   }
   // reduce the serialMatrix owned by each MPI process into one matrix, which is basically
   // a print of the ranks owning elements of the parallel one
+  trackMemory("MPI staging", serialMatrix.size() * sizeof(int));
   mpi->allReduceSum(&serialMatrix);
+  profiler->memoryCheckpoint("example2 reduction");
 
   if(mpi->mpiHead()) std::cout << "the matrix: \n" << serialMatrix << std::endl;
+  trackMemory("MPI staging", -long(serialMatrix.size() * sizeof(int)));
 
 }
@@ -1,5 +1,7 @@
 #pragma once
 #include "PMatrix.h"
+#include "profiler.h"
+#include "benchmark.h"
 
 void example3() {
 
@@ -11,12 +13,14 @@ void example3() {
   // allocate the matrix
   ParallelMatrix<double> pmat = ParallelMatrix<double>(dim, dim, nBlocks, nBlocks);
 
-  // fill in the matrix, iterate over local rows and columns
-  for(auto [rowIdx,colIdx] : pmat.getAllLocalElements()) {
-    // fill with nonsense values (for now, use MPI rank)
-    pmat(rowIdx, colIdx) = mpi->getRank();
+  // fill in the matrix with a symmetric test matrix,
+  // iterating over local rows and columns
+  {
+    RegionTimer timer("fill");
+    fillTestMatrix(pmat);
   }
   if(mpi->mpiHead()) std::cout << "Done filling matrix." << std::endl;
+  profiler->memoryCheckpoint("before diagonalize");
 
   // diagonalize
   auto start = std::chrono::high_resolution_clock::now();
@@ -26,4 +30,11 @@ void example3() {
   auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(end - start);
   if(mpi->mpiHead()) std::cout << "Time [milli s]: " << duration.count() << std::endl;
 
+  // achieved flop rate of the eigensolver call
+  RegionStats stats = profiler->getRegion("diagonalize");
+  double gflops = stats.flops / stats.time * 1.e-9;
+  double totalGflops = stats.flops * mpi->getSize() / stats.time * 1.e-9;
+  if(mpi->mpiHead()) std::cout << "GFLOP/s per rank: " << gflops
+                        << ", overall: " << totalGflops << std::endl;
+
 } // end function
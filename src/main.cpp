@@ -1,7 +1,10 @@
 #include "mpi/mpiHelper.h"
 #include "PMatrix.h"
+#include "profiler.h"
 #include "example2.h"
 #include "example3.h"
+#include "planner.h"
+#include "benchmark.h"
 #include <chrono>
 
 int main(int argc, char **argv) {
@@ -14,13 +17,35 @@ int main(int argc, char **argv) {
   // Print parallelization info
   parallelInfo();
 
-  // --------------------- Example 2 ------------------------------
-
-  //example2();
-
-  // --------------------- Example 3 ------------------------------
-
-  //example3();
+  // ------------------- Dry-run planner ---------------------------
+  // e.g. PMatrix -plan -n 120000 -grid 16x16 -block 64 -op syevd
+  // predicts memory and flops of an operation without allocating it
+
+  if (hasArgument(argc, argv, "-plan")) {
+    PlanRequest request = parsePlanRequest(argc, argv);
+    if (request.gflopsPerProcess == 0.) {
+      request.gflopsPerProcess = profiler->calibratePeak();
+    }
+    printPlan(request, planOperation(request));
+  }
+
+  // ------------------- Benchmarks --------------------------------
+  // e.g. PMatrix -bench -ops gemm,syevd -sizes 2048,4096 -blocks 64 -reps 3
+  // or   PMatrix -bench -config bench.cfg
+  // see benchmark.h for all the settings
+
+  else if (hasArgument(argc, argv, "-bench")) {
+    runBenchmarks(parseBenchmarkConfig(argc, argv));
+  }
+
+  // --------------------- Examples ---------------------------------
+
+  else if (getArgument(argc, argv, "-example", "") == "2") {
+    example2();
+  }
+  else if (getArgument(argc, argv, "-example", "") == "3") {
+    example3();
+  }
 
   // close out MPI env ---------------------------------------------------------
 
@@ -11,6 +11,9 @@
 // constructor
 MPIcontroller::MPIcontroller(int argc, char *argv[]) {
 
+  // one set of traffic counters per wrapper and communicator
+  commStats.resize(numCommWrappers * numComms_);
+
 #ifdef MPI_AVAIL
   // start the MPI environment
   int errCode = MPI_Init(nullptr, nullptr);
@@ -106,6 +109,11 @@ const int MPIcontroller::worldComm = worldComm_;
 const int MPIcontroller::intraPoolComm = intraPoolComm_;
 const int MPIcontroller::interPoolComm = interPoolComm_;
 
+const std::vector<std::string> MPIcontroller::commWrapperNames = {
+    "bcast", "reduceSum", "allReduceSum", "reduceMax", "allReduceMax",
+    "reduceMin", "allReduceMin", "gatherv", "gather", "allGatherv",
+    "allGather", "bigAllGatherV", "allToAllv"};
+
 void MPIcontroller::finalize() const {
   if(mpiHead()) {
     // print date and time of run
@@ -115,6 +123,7 @@ void MPIcontroller::finalize() const {
   }
 #ifdef MPI_AVAIL
   barrier();
+  printCommStats();
   if (mpiHead()) {
     fprintf(stdout, "Run time: %3f s\n", MPI_Wtime() - startTime);
   }
@@ -230,6 +239,8 @@ int MPIcontroller::getRank(const int& communicator) const {
     return rank;
   } else if (communicator == intraPoolComm) {
     return poolRank;
+  } else if (communicator == interPoolComm) {
+    return poolId;
   } else {
     Error("Invalid communicator in getRank.");
     return 0;
@@ -244,6 +255,8 @@ int MPIcontroller::getSize(const int& communicator) const {
     return size;
   } else if (communicator == intraPoolComm) {
     return poolSize;
+  } else if (communicator == interPoolComm) {
+    return size / poolSize;
   } else {
     Error("Invalid communicator in getSize.");
     return 0;
@@ -284,3 +297,90 @@ std::tuple<MPI_Comm,int> MPIcontroller::decideCommunicator(const int& communicat
   return std::make_tuple(comm, broadcaster);
 }
 #endif
+
+// Communication statistics -----------------------------------------
+
+void MPIcontroller::recordComm(const int& wrapperId, const int& communicator,
+                               const size_t& bytesSent,
+                               const size_t& bytesReceived, const double& time,
+                               const size_t& numMessages) const {
+  CommStats& stats = commStats[wrapperId * numComms_ + communicator];
+  stats.bytesSent += bytesSent;
+  stats.bytesReceived += bytesReceived;
+  stats.numMessages += numMessages;
+  stats.time += time;
+}
+
+CommStats MPIcontroller::getCommStats(const std::string& wrapper,
+                                      const int& communicator) const {
+  for (int i = 0; i < numCommWrappers; i++) {
+    if (commWrapperNames[i] == wrapper) {
+      if (communicator < 0 || communicator >= numComms_) {
+        Error("Invalid communicator in getCommStats.");
+      }
+      return commStats[i * numComms_ + communicator];
+    }
+  }
+  Error("Unknown MPI wrapper " + wrapper + " in getCommStats.");
+  return CommStats();
+}
+
+CommStats MPIcontroller::getCommStats() const {
+  CommStats total;
+  for (const CommStats& stats : commStats) {
+    total.bytesSent += stats.bytesSent;
+    total.bytesReceived += stats.bytesReceived;
+    total.numMessages += stats.numMessages;
+    total.time += stats.time;
+  }
+  return total;
+}
+
+void MPIcontroller::resetCommStats() {
+  for (CommStats& stats : commStats) stats = CommStats();
+}
+
+void MPIcontroller::printCommStats() const {
+  // flatten the counters so that they can be reduced in a single call.
+  // We use raw MPI calls, so that the report doesn't count itself.
+  int numEntries = numCommWrappers * numComms_;
+  std::vector<double> volumes(3 * numEntries);
+  std::vector<double> times(numEntries);
+  for (int i = 0; i < numEntries; i++) {
+    volumes[3 * i] = double(commStats[i].bytesSent);
+    volumes[3 * i + 1] = double(commStats[i].bytesReceived);
+    volumes[3 * i + 2] = double(commStats[i].numMessages);
+    times[i] = commStats[i].time;
+  }
+#ifdef MPI_AVAIL
+  if (mpiHead()) {
+    MPI_Reduce(MPI_IN_PLACE, volumes.data(), 3 * numEntries, MPI_DOUBLE,
+               MPI_SUM, mpiHeadId, MPI_COMM_WORLD);
+    MPI_Reduce(MPI_IN_PLACE, times.data(), numEntries, MPI_DOUBLE, MPI_MAX,
+               mpiHeadId, MPI_COMM_WORLD);
+  } else {
+    MPI_Reduce(volumes.data(), volumes.data(), 3 * numEntries, MPI_DOUBLE,
+               MPI_SUM, mpiHeadId, MPI_COMM_WORLD);
+    MPI_Reduce(times.data(), times.data(), numEntries, MPI_DOUBLE, MPI_MAX,
+               mpiHeadId, MPI_COMM_WORLD);
+  }
+#endif
+  if (!mpiHead()) return;
+
+  const std::vector<std::string> commNames = {"world", "intraPool",
+                                              "interPool"};
+  bool headerPrinted = false;
+  for (int i = 0; i < numEntries; i++) {
+    if (volumes[3 * i + 2] == 0.) continue;
+    if (!headerPrinted) {
+      fprintf(stdout, "MPI traffic (all processes, max time over processes):\n");
+      fprintf(stdout, "%-14s %-10s %10s %14s %14s %12s\n", "wrapper", "comm",
+              "calls", "sent [MB]", "received [MB]", "time [s]");
+      headerPrinted = true;
+    }
+    fprintf(stdout, "%-14s %-10s %10.0f %14.6f %14.6f %12.6f\n",
+            commWrapperNames[i / numComms_].c_str(),
+            commNames[i % numComms_].c_str(), volumes[3 * i + 2],
+            volumes[3 * i] / 1.e6, volumes[3 * i + 1] / 1.e6, times[i]);
+  }
+}
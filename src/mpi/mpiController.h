@@ -12,6 +12,7 @@
 #include <tuple>
 #include <iostream>
 #include <string>
+#include <climits>
 
 #ifdef MPI_AVAIL
 #include <mpi.h>
@@ -20,6 +21,28 @@
 const int worldComm_ = 0;
 const int intraPoolComm_ = 1;
 const int interPoolComm_ = 2;
+const int numComms_ = 3;
+
+/** Identifiers of the MPIcontroller wrappers whose traffic is recorded.
+ * The order must match the list of names in commWrapperNames.
+ */
+enum CommWrapperId {
+  bcastId, reduceSumId, allReduceSumId, reduceMaxId, allReduceMaxId,
+  reduceMinId, allReduceMinId, gathervId, gatherId, allGathervId,
+  allGatherId, bigAllGatherVId, allToAllvId, numCommWrappers
+};
+
+/** Traffic recorded for one wrapper on one communicator by this MPI process.
+ * Bytes are counted at the wrapper level, i.e. the payload handed to or
+ * received from MPI, not the traffic on the wire generated by the
+ * algorithm chosen by the MPI library.
+ */
+struct CommStats {
+  size_t bytesSent = 0;
+  size_t bytesReceived = 0;
+  size_t numMessages = 0;  // number of MPI calls issued
+  double time = 0.;        // seconds spent inside the MPI calls
+};
 
 
 /* NOTE: When using this object make sure to use the divideWork
@@ -53,6 +76,10 @@ class MPIcontroller {
   const int mpiHeadPoolId = 0;
   const int mpiHeadColsId = 0;
 
+  // number of gathered elements above which bigAllGatherV switches from
+  // MPI_Allgatherv to point to point messages of large datatypes
+  static constexpr size_t bigCountLimit = INT_MAX;
+
   int poolSize = 1; // # of MPI processes in the pool
   bool hasMPIPools = false;
   int poolRank = 0; // rank of the MPI process within the pool from 0 to poolSize
@@ -66,7 +93,32 @@ class MPIcontroller {
   // helper function used internally
   std::tuple<std::vector<int>, std::vector<int>> workDivHelper(size_t numTasks) const;
 
+  // traffic counters, indexed as wrapperId * numComms_ + communicator.
+  // These are mutable as the collective wrappers are const methods.
+  mutable std::vector<CommStats> commStats;
+
+  /** Adds one call of a wrapper to the traffic counters.
+   * @param wrapperId: CommWrapperId of the calling wrapper.
+   * @param communicator: communicator used by the call.
+   * @param bytesSent/bytesReceived: payload sent/received by this process.
+   * @param time: seconds spent in the MPI call.
+   * @param numMessages: number of MPI calls issued by the wrapper.
+   */
+  void recordComm(const int& wrapperId, const int& communicator,
+                  const size_t& bytesSent, const size_t& bytesReceived,
+                  const double& time, const size_t& numMessages = 1) const;
+
+  /** Prints the traffic counters, summed (and timed by the slowest process)
+   * over all MPI processes. Called by finalize.
+   */
+  void printCommStats() const;
+
 #ifdef MPI_AVAIL
+  /** Returns the number of bytes in the data of a container.
+   */
+  template <typename T>
+  size_t numBytes(T* data) const;
+
   double startTime;  // the time for the entire mpi operation
   /** Utility function used to convert the integer communicator to a MPI_COMM
    * communicator.
@@ -195,6 +247,18 @@ class MPIcontroller {
   template <typename T, typename V>
   void allGather(T* dataIn, V* dataOut, const int& communicator=worldComm) const;
 
+  /** Wrapper for MPI_Alltoallv, where each rank sends a different number
+   * of elements to every other rank.
+   * @param dataIn: pointer to sent data, ordered by destination rank.
+   * @param sendCounts: number of elements sent to each rank.
+   * @param dataOut: pointer to output buffer, already of the size of the
+   *       received data, which is ordered by source rank.
+   * @param receiveCounts: number of elements received from each rank.
+   */
+  template <typename T, typename V>
+  void allToAllv(T* dataIn, const std::vector<int>& sendCounts, V* dataOut,
+                 const std::vector<int>& receiveCounts) const;
+
   /** Helper function to create a custom MPI datatype.
    *  Intended to be used with bigAllGatherv
    *  @param container: a pointer to the mpi datatype we want to create
@@ -219,11 +283,15 @@ class MPIcontroller {
    *       to be collected from each process.
    *  @param workDivisionHeads: a vector containing the start positions
    *       of each processes' elements in the dataOut array.
+   *  @param countLimit: number of gathered elements from which the point
+   *       to point path is used. Only lowered by the microbenchmarks, to
+   *       time that path on small messages.
    */
   template <typename T>
   void bigAllGatherV(T* dataIn, T* dataOut,
   std::vector<size_t>& workDivs, std::vector<size_t>& workDivisionHeads,
-  const int& communicator=worldComm) const;
+  const int& communicator=worldComm,
+  const size_t& countLimit=bigCountLimit) const;
 
   // Asynchronous functions
   /** Wrapper for MPI_Barrier()
@@ -278,6 +346,27 @@ class MPIcontroller {
    */
   std::vector<size_t> divideWorkIter(size_t numTasks, const int& communicator=worldComm);
 
+  // Communication statistics -----------------------------------
+  /** Returns the traffic recorded by this MPI process for a wrapper.
+   * @param wrapper: name of the wrapper, e.g. "allReduceSum".
+   * @param communicator: communicator used by the wrapper.
+   */
+  CommStats getCommStats(const std::string& wrapper,
+                         const int& communicator=worldComm) const;
+
+  /** Returns the traffic recorded by this MPI process summed over all
+   * wrappers and communicators.
+   */
+  CommStats getCommStats() const;
+
+  /** Sets all traffic counters of this MPI process to zero.
+   */
+  void resetCommStats();
+
+  /** Names of the wrappers, indexed by CommWrapperId.
+   */
+  static const std::vector<std::string> commWrapperNames;
+
   /** integer used to specify the call to MPI uses the world communicator.
    */
   static const int worldComm;
@@ -450,6 +539,16 @@ struct containerType;
 #endif
 }  // namespace mpiContainer
 
+#ifdef MPI_AVAIL
+template <typename T>
+size_t MPIcontroller::numBytes(T* data) const {
+  using namespace mpiContainer;
+  int typeSize;
+  MPI_Type_size(containerType<T>::getMPItype(), &typeSize);
+  return containerType<T>::getSize(data) * size_t(typeSize);
+}
+#endif
+
 // Collective communications functions -----------------------------------
 template <typename T>
 void MPIcontroller::bcast(T* dataIn, const int& communicator, const int root) const {
@@ -464,12 +563,21 @@ void MPIcontroller::bcast(T* dataIn, const int& communicator, const int root) co
 
   broadcasterId = root < 0 ? broadcasterId : root;
 
+  double t0 = MPI_Wtime();
   int errCode = MPI_Bcast(containerType<T>::getAddress(dataIn),
                       containerType<T>::getSize(dataIn),
                       containerType<T>::getMPItype(), broadcasterId, comm);
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  int commRank;
+  MPI_Comm_rank(comm, &commRank);
+  size_t bytes = numBytes(dataIn);
+  if (commRank == broadcasterId) {
+    recordComm(bcastId, communicator, bytes, 0, MPI_Wtime() - t0);
+  } else {
+    recordComm(bcastId, communicator, 0, bytes, MPI_Wtime() - t0);
+  }
  #else
  (void)dataIn;
  (void)communicator;
@@ -483,6 +591,7 @@ void MPIcontroller::reduceSum(T* dataIn) const {
   if (size == 1) return;
   int errCode;
 
+  double t0 = MPI_Wtime();
   if (rank == 0) {
     errCode =
         MPI_Reduce(MPI_IN_PLACE, containerType<T>::getAddress(dataIn),
@@ -497,6 +606,12 @@ void MPIcontroller::reduceSum(T* dataIn) const {
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  size_t bytes = numBytes(dataIn);
+  if (rank == mpiHeadId) {
+    recordComm(reduceSumId, worldComm, 0, bytes * (size - 1), MPI_Wtime() - t0);
+  } else {
+    recordComm(reduceSumId, worldComm, bytes, 0, MPI_Wtime() - t0);
+  }
   #else
   (void)dataIn;
   #endif
@@ -506,9 +621,13 @@ template <typename T>
 void MPIcontroller::allReduceSum(T* dataIn, T* dataOut) const {
   using namespace mpiContainer;
 #ifdef MPI_AVAIL
-  if (size == 1) return;
+  if (size == 1) {
+    *dataOut = *dataIn;
+    return;
+  }
   int errCode;
 
+  double t0 = MPI_Wtime();
   errCode = MPI_Allreduce(
       containerType<T>::getAddress(dataIn),
       containerType<T>::getAddress(dataOut), containerType<T>::getSize(dataIn),
@@ -516,8 +635,10 @@ void MPIcontroller::allReduceSum(T* dataIn, T* dataOut) const {
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  size_t bytes = numBytes(dataIn);
+  recordComm(allReduceSumId, worldComm, bytes, bytes, MPI_Wtime() - t0);
 #else
-  pointerSwap(dataIn, dataOut);  // just switch the pointers in serial case
+  *dataOut = *dataIn;
 #endif
 }
 
@@ -528,6 +649,7 @@ void MPIcontroller::reduceMax(T* dataIn) const {
   if (size == 1) return;
   int errCode;
 
+  double t0 = MPI_Wtime();
   if (rank == 0) {
     errCode =
         MPI_Reduce(MPI_IN_PLACE, containerType<T>::getAddress(dataIn),
@@ -542,6 +664,12 @@ void MPIcontroller::reduceMax(T* dataIn) const {
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  size_t bytes = numBytes(dataIn);
+  if (rank == mpiHeadId) {
+    recordComm(reduceMaxId, worldComm, 0, bytes * (size - 1), MPI_Wtime() - t0);
+  } else {
+    recordComm(reduceMaxId, worldComm, bytes, 0, MPI_Wtime() - t0);
+  }
   #else
   (void)dataIn;
   #endif
@@ -556,6 +684,7 @@ void MPIcontroller::allReduceSum(T* dataIn, const int& communicator) const {
 
   MPI_Comm comm = std::get<0>(decideCommunicator(communicator));
 
+  double t0 = MPI_Wtime();
   int errCode =
       MPI_Allreduce(MPI_IN_PLACE, containerType<T>::getAddress(dataIn),
                     containerType<T>::getSize(dataIn),
@@ -563,6 +692,8 @@ void MPIcontroller::allReduceSum(T* dataIn, const int& communicator) const {
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  size_t bytes = numBytes(dataIn);
+  recordComm(allReduceSumId, communicator, bytes, bytes, MPI_Wtime() - t0);
   #else
   (void)dataIn;
   (void)communicator;
@@ -578,6 +709,7 @@ void MPIcontroller::allReduceMax(T* dataIn, const int& communicator) const {
 
   MPI_Comm comm = std::get<0>(decideCommunicator(communicator));
 
+  double t0 = MPI_Wtime();
   int errCode =
       MPI_Allreduce(MPI_IN_PLACE, containerType<T>::getAddress(dataIn),
                     containerType<T>::getSize(dataIn),
@@ -585,6 +717,8 @@ void MPIcontroller::allReduceMax(T* dataIn, const int& communicator) const {
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  size_t bytes = numBytes(dataIn);
+  recordComm(allReduceMaxId, communicator, bytes, bytes, MPI_Wtime() - t0);
   #else
   (void)dataIn;
   (void)communicator;
@@ -599,6 +733,7 @@ void MPIcontroller::reduceMin(T* dataIn) const {
   if (size == 1) return;
   int errCode;
 
+  double t0 = MPI_Wtime();
   if (rank == 0) {
     errCode =
         MPI_Reduce(MPI_IN_PLACE, containerType<T>::getAddress(dataIn),
@@ -613,6 +748,12 @@ void MPIcontroller::reduceMin(T* dataIn) const {
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  size_t bytes = numBytes(dataIn);
+  if (rank == mpiHeadId) {
+    recordComm(reduceMinId, worldComm, 0, bytes * (size - 1), MPI_Wtime() - t0);
+  } else {
+    recordComm(reduceMinId, worldComm, bytes, 0, MPI_Wtime() - t0);
+  }
   #else
   (void)dataIn;
   #endif
@@ -624,6 +765,7 @@ void MPIcontroller::allReduceMin(T* dataIn) const {
   #ifdef MPI_AVAIL
   if (size == 1) return;
   int errCode;
+  double t0 = MPI_Wtime();
   errCode =
       MPI_Allreduce(MPI_IN_PLACE, containerType<T>::getAddress(dataIn),
                     containerType<T>::getSize(dataIn),
@@ -631,6 +773,8 @@ void MPIcontroller::allReduceMin(T* dataIn) const {
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  size_t bytes = numBytes(dataIn);
+  recordComm(allReduceMinId, worldComm, bytes, bytes, MPI_Wtime() - t0);
   #else
   (void)dataIn;
   #endif
@@ -676,6 +820,7 @@ void MPIcontroller::gatherv(T* dataIn, V* dataOut) const {
   std::vector<int> workDivs = std::get<0>(tup);
   std::vector<int> workDivisionHeads = std::get<1>(tup);
 
+  double t0 = MPI_Wtime();
   errCode = MPI_Gatherv(
       containerType<T>::getAddress(dataIn), containerType<T>::getSize(dataIn),
       containerType<T>::getMPItype(), containerType<V>::getAddress(dataOut),
@@ -684,6 +829,8 @@ void MPIcontroller::gatherv(T* dataIn, V* dataOut) const {
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  recordComm(gathervId, worldComm, numBytes(dataIn),
+             rank == mpiHeadId ? numBytes(dataOut) : 0, MPI_Wtime() - t0);
   #else
   pointerSwap(dataIn, dataOut);  // just switch the pointers in serial case
   #endif
@@ -695,6 +842,7 @@ void MPIcontroller::gather(T* dataIn, V* dataOut) const {
   #ifdef MPI_AVAIL
   int errCode;
 
+  double t0 = MPI_Wtime();
   errCode = MPI_Gather(
       containerType<T>::getAddress(dataIn), containerType<T>::getSize(dataIn),
       containerType<T>::getMPItype(), containerType<V>::getAddress(dataOut),
@@ -703,6 +851,9 @@ void MPIcontroller::gather(T* dataIn, V* dataOut) const {
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  size_t bytes = numBytes(dataIn);
+  recordComm(gatherId, worldComm, bytes,
+             rank == mpiHeadId ? bytes * size : 0, MPI_Wtime() - t0);
   #else
   pointerSwap(dataIn, dataOut);  // just switch the pointers in serial case
   #endif
@@ -738,6 +889,7 @@ void MPIcontroller::allGatherv(T* dataIn, V* dataOut) const {
     std::vector<int> workDivisionHeads = std::get<1>(tup);
   //}
 
+  double t0 = MPI_Wtime();
   errCode = MPI_Allgatherv(
       containerType<T>::getAddress(dataIn), containerType<T>::getSize(dataIn),
       containerType<T>::getMPItype(), containerType<V>::getAddress(dataOut),
@@ -745,6 +897,8 @@ void MPIcontroller::allGatherv(T* dataIn, V* dataOut) const {
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  recordComm(allGathervId, worldComm, numBytes(dataIn), numBytes(dataOut),
+             MPI_Wtime() - t0);
   #else
   pointerSwap(dataIn, dataOut);
   #endif
@@ -759,6 +913,7 @@ void MPIcontroller::allGather(T* dataIn, V* dataOut, const int& communicator) co
   auto t = decideCommunicator(communicator);
   MPI_Comm comm = std::get<0>(t);
 
+  double t0 = MPI_Wtime();
   errCode = MPI_Allgather(
       containerType<T>::getAddress(dataIn), containerType<T>::getSize(dataIn),
       containerType<T>::getMPItype(), containerType<V>::getAddress(dataOut),
@@ -767,11 +922,59 @@ void MPIcontroller::allGather(T* dataIn, V* dataOut, const int& communicator) co
   if (errCode != MPI_SUCCESS) {
     errorReport(errCode);
   }
+  int commSize;
+  MPI_Comm_size(comm, &commSize);
+  size_t bytes = numBytes(dataIn);
+  recordComm(allGatherId, communicator, bytes, bytes * commSize,
+             MPI_Wtime() - t0);
   #else
   pointerSwap(dataIn, dataOut);  // just switch the pointers in serial case
   #endif
 }
 
+template <typename T, typename V>
+void MPIcontroller::allToAllv(T* dataIn, const std::vector<int>& sendCounts,
+                              V* dataOut,
+                              const std::vector<int>& receiveCounts) const {
+  using namespace mpiContainer;
+  #ifdef MPI_AVAIL
+  if (size == 1) {
+    *dataOut = *dataIn;
+    return;
+  }
+  std::vector<int> sendDispls(size, 0), receiveDispls(size, 0);
+  for (int i = 1; i < size; i++) {
+    sendDispls[i] = sendDispls[i - 1] + sendCounts[i - 1];
+    receiveDispls[i] = receiveDispls[i - 1] + receiveCounts[i - 1];
+  }
+
+  double t0 = MPI_Wtime();
+  int errCode = MPI_Alltoallv(
+      containerType<T>::getAddress(dataIn), sendCounts.data(),
+      sendDispls.data(), containerType<T>::getMPItype(),
+      containerType<V>::getAddress(dataOut), receiveCounts.data(),
+      receiveDispls.data(), containerType<V>::getMPItype(), MPI_COMM_WORLD);
+  if (errCode != MPI_SUCCESS) {
+    errorReport(errCode);
+  }
+  // only the data exchanged with other ranks is traffic
+  int typeSize;
+  MPI_Type_size(containerType<T>::getMPItype(), &typeSize);
+  size_t elementsSent = 0, elementsReceived = 0;
+  for (int i = 0; i < size; i++) {
+    if (i == rank) continue;
+    elementsSent += sendCounts[i];
+    elementsReceived += receiveCounts[i];
+  }
+  recordComm(allToAllvId, worldComm, elementsSent * typeSize,
+             elementsReceived * typeSize, MPI_Wtime() - t0);
+  #else
+  (void)sendCounts;
+  (void)receiveCounts;
+  *dataOut = *dataIn;
+  #endif
+}
+
 #ifdef MPI_AVAIL
 template <typename T>
 void MPIcontroller::datatypeHelper(MPI_Datatype* container,
@@ -831,7 +1034,7 @@ MPI_Count count, T* data) const {
 template <typename T>
 void MPIcontroller::bigAllGatherV(T* dataIn, T* dataOut,
   std::vector<size_t>& workDivs, std::vector<size_t>& workDivisionHeads,
-  const int& communicator) const {
+  const int& communicator, const size_t& countLimit) const {
 
   using namespace mpiContainer;
   #ifdef MPI_AVAIL
@@ -852,10 +1055,10 @@ void MPIcontroller::bigAllGatherV(T* dataIn, T* dataOut,
       return;
     }
 
-    // if the size of the out array is less than INT_MAX,
+    // if the size of the out array is less than countLimit (INT_MAX),
     // we can just call regular allGatherV
     size_t outSize = workDivisionHeads.back() + workDivs.back();
-    if(outSize < INT_MAX) {
+    if(outSize < countLimit) {
 
       // if size is less than INT_MAX, it's safe to store
       // these as ints and pass them directly to allgatherv
@@ -867,6 +1070,7 @@ void MPIcontroller::bigAllGatherV(T* dataIn, T* dataOut,
       }
 
       int errCode;
+      double t0 = MPI_Wtime();
       errCode = MPI_Allgatherv(
           containerType<T>::getAddress(dataIn), workDivs_[thisRank],
           containerType<T>::getMPItype(), containerType<T>::getAddress(dataOut),
@@ -874,6 +1078,9 @@ void MPIcontroller::bigAllGatherV(T* dataIn, T* dataOut,
           containerType<T>::getMPItype(), comm);
 
       if (errCode != MPI_SUCCESS) errorReport(errCode);
+      recordComm(bigAllGatherVId, communicator,
+                 workDivs[thisRank] * sizeof(T), outSize * sizeof(T),
+                 MPI_Wtime() - t0);
       return;
     }
     else if(version < 3) { // this will have problems in mpi version <3   
@@ -886,6 +1093,7 @@ void MPIcontroller::bigAllGatherV(T* dataIn, T* dataOut,
     }
 
     int errCodeSend, errCodeRecv;
+    double t0 = MPI_Wtime();
 
     // this is required to use non-blocking communications
     // it will mark when all send/recv calls posted have been executed
@@ -928,7 +1136,7 @@ void MPIcontroller::bigAllGatherV(T* dataIn, T* dataOut,
 
       // create a container object to encapsulate all the data this process will send
       MPI_Datatype container;
-      datatypeHelper(&container, workDivs[rank], dataIn);
+      datatypeHelper(&container, workDivs[thisRank], dataIn);
 
       errCodeSend = MPI_Isend(containerType<T>::getAddress(dataIn), 1, container,
           dst, tag, comm, &reqs[nRanks+i]);
@@ -941,6 +1149,9 @@ void MPIcontroller::bigAllGatherV(T* dataIn, T* dataOut,
     }
     // wait until all send/recv pairs have completed to end the function
     MPI_Waitall(2*nRanks, reqs.data(), MPI_STATUSES_IGNORE);
+    recordComm(bigAllGatherVId, communicator,
+               workDivs[thisRank] * sizeof(T) * nRanks, outSize * sizeof(T),
+               MPI_Wtime() - t0, 2 * nRanks);
 
   #else
   for (unsigned int i=0;i<workDivs[0];i++) {
@@ -1,5 +1,6 @@
 #include "mpiHelper.h"
 #include <iostream>
+#include "../profiler.h"
 
 #ifdef OMP_AVAIL
 #include "omp.h"
@@ -10,9 +11,20 @@ MPIcontroller *mpi = nullptr;
 // A function to set up the mpi env by creating the controller object.
 void initMPI(int argc, char *argv[]) {
   mpi = new MPIcontroller(argc, argv);
+  profiler = new Profiler();
+
+  // hardware counters around the profiled regions, if requested
+  for (int i = 0; i < argc; i++) {
+    if (std::string(argv[i]) == "-perf") {
+      profiler->enablePerfCounters();
+    }
+  }
 }
 
 void deleteMPI() {
+  profiler->report();
+  delete profiler;
+  profiler = nullptr;
   mpi->finalize();
   delete mpi;
 }
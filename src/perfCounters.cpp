@@ -0,0 +1,81 @@
+#include "perfCounters.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cstring>
+#endif
+
+const std::vector<std::string> PerfCounters::eventNames = {
+    "cycles", "instructions", "LLC misses", "stall cycles"};
+
+PerfCounters::~PerfCounters() {
+  close();
+}
+
+bool PerfCounters::open() {
+  bool available = false;
+#ifdef __linux__
+  const uint64_t configs[numPerfEvents] = {
+      PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_STALLED_CYCLES_BACKEND};
+
+  for (int i = 0; i < numPerfEvents; i++) {
+    if (fds[i] != -1) {
+      available = true;
+      continue;
+    }
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(perf_event_attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(perf_event_attr);
+    attr.config = configs[i];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.inherit = 1;  // also count threads spawned later, e.g. by BLAS
+
+    // pid = 0, cpu = -1: this process, on any cpu. Events are opened
+    // separately, so that an unsupported event doesn't disable the others.
+    fds[i] = int(syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0));
+    if (fds[i] != -1) {
+      ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+      available = true;
+    }
+  }
+#endif
+  return available;
+}
+
+void PerfCounters::close() {
+#ifdef __linux__
+  for (int i = 0; i < numPerfEvents; i++) {
+    if (fds[i] != -1) {
+      ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+      ::close(fds[i]);
+      fds[i] = -1;
+    }
+  }
+#endif
+}
+
+bool PerfCounters::isAvailable(const int& i) const {
+  return fds[i] != -1;
+}
+
+void PerfCounters::read(uint64_t* values) const {
+  for (int i = 0; i < numPerfEvents; i++) {
+    values[i] = 0;
+#ifdef __linux__
+    if (fds[i] != -1) {
+      uint64_t value;
+      if (::read(fds[i], &value, sizeof(uint64_t)) == sizeof(uint64_t)) {
+        values[i] = value;
+      }
+    }
+#endif
+  }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// number of hardware events sampled by PerfCounters
+const int numPerfEvents = 4;
+
+/** Class reading hardware performance counters of this MPI process through
+ * the Linux perf_event_open interface.
+ *
+ * We sample cycles, instructions, last level cache misses and backend
+ * stall cycles (cycles in which the core waits mostly on memory).
+ * The counters run from open() to close(), and are read at the start and
+ * end of a region to get the events that happened inside of it.
+ * Events not supported by the CPU (or not allowed by the kernel settings,
+ * see /proc/sys/kernel/perf_event_paranoid) read as zero.
+ * On systems other than Linux, no counter is ever available.
+ */
+class PerfCounters {
+ private:
+  int fds[numPerfEvents] = {-1, -1, -1, -1};
+
+ public:
+  /** Names of the sampled events.
+   */
+  static const std::vector<std::string> eventNames;
+
+  ~PerfCounters();
+
+  /** Opens and starts the counters.
+   * @return available: true if at least one event can be counted.
+   */
+  bool open();
+
+  /** Stops and closes the counters.
+   */
+  void close();
+
+  /** Returns true if the event of index i is counted.
+   */
+  bool isAvailable(const int& i) const;
+
+  /** Reads the current value of all counters.
+   * @param values: array of length numPerfEvents, filled on return.
+   */
+  void read(uint64_t* values) const;
+};
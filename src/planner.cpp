@@ -0,0 +1,170 @@
+#include "planner.h"
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstdio>
+#include <complex>
+#include "blacs.h"
+#include "mpi/mpiHelper.h"
+#include "profiler.h"
+#include "utilities.h"
+
+PlanEstimate planOperation(const PlanRequest& request) {
+  PlanEstimate estimate;
+
+  int n = request.numRows;
+  int nb = request.blockSize;
+  int numProcs = request.numBlacsRows * request.numBlacsCols;
+  int nprow = request.numBlacsRows;
+  int npcol = request.numBlacsCols;
+  // number of rows (or cols) of size m held by process 0, with blocks nb
+  auto localSize = [](blacsInt m, blacsInt nb, blacsInt numProcs) {
+    blacsInt iZero = 0;
+    return int(numroc_(&m, &nb, &iZero, &iZero, &numProcs));
+  };
+
+  // process (0,0) holds the largest local block
+  int np = localSize(n, nb, nprow);
+  int nq = localSize(n, nb, npcol);
+  estimate.localRows = np;
+  estimate.localCols = nq;
+  double localElements = double(np) * double(nq);
+
+  bool isComplex = request.isComplex || request.operation == "heev";
+  double elementBytes = isComplex ? sizeof(std::complex<double>) : sizeof(double);
+  double matrixBytes = localElements * elementBytes;
+
+  double workspaceBytes = 0.;
+  double maxWorkspace = 0.;  // largest work array, in elements
+  double flops = 0.;
+  if (request.operation == "fill") {
+    estimate.matrixBytes = matrixBytes;
+  } else if (request.operation == "gemm") {
+    // A, B and the result C
+    estimate.matrixBytes = 3. * matrixBytes;
+    flops = isComplex ? flopsGemm<std::complex<double>>(n, n, n)
+                      : flopsGemm<double>(n, n, n);
+  } else if (request.operation == "syevd") {
+    // A and the eigenvectors Z
+    estimate.matrixBytes = 2. * matrixBytes;
+    // liwork >= 7n + 8npcol + 2, as in diagonalize()
+    double liwork = 7. * n + 8. * npcol + 2.;
+    // lwork >= max(1 + 6n + 2 np nq, trilwmin) + 2n
+    double trilwmin = 3. * n + std::max(double(nb) * (np + 1), 3. * nb);
+    double lwork = std::max(1. + 6. * n + 2. * localElements, trilwmin) + 2. * n;
+    workspaceBytes = lwork * sizeof(double) + liwork * sizeof(blacsInt);
+    maxWorkspace = lwork;
+    flops = flopsSyevd(n);
+  } else if (request.operation == "syevr") {
+    int numEigenvalues = request.numEigenvalues > 0
+        ? std::min(request.numEigenvalues, n) : n;
+    estimate.matrixBytes = 2. * matrixBytes;
+    // liwork = 12 nnp + 2n, nnp = max(n, nprow npcol + 1, 4), as in diagonalize()
+    double nnp = std::max(std::max(n, numProcs + 1), 4);
+    double liwork = 12. * nnp + 2. * n;
+    // lwork >= 2 + 5n + max(18 nn, np0 mq0 + 2 nb^2) + (2 + ceil(neig/p)) nn
+    int nn = std::max(std::max(n, nb), 2);
+    int np0 = localSize(nn, nb, nprow);
+    int neigMax = std::max(std::max(numEigenvalues, nb), 2);
+    int mq0 = localSize(neigMax, nb, npcol);
+    double lwork = 2. + 5. * n
+        + std::max(18. * nn, double(np0) * mq0 + 2. * nb * nb)
+        + (2. + (numEigenvalues + numProcs - 1) / numProcs) * nn;
+    workspaceBytes = lwork * sizeof(double) + liwork * sizeof(blacsInt);
+    maxWorkspace = lwork;
+    flops = flopsSyevr(n, numEigenvalues);
+  } else if (request.operation == "heev") {
+    estimate.matrixBytes = 2. * matrixBytes;
+    // diagonalize() uses p?heevd for complex matrices:
+    // lwork >= n + (np0 + mq0 + nb) nb, lrwork >= 1 + 9n + 3 np nq,
+    // liwork >= 7n + 8npcol + 2
+    int nn = std::max(std::max(n, nb), 2);
+    int np0 = localSize(nn, nb, nprow);
+    int mq0 = localSize(nn, nb, npcol);
+    double lwork = n + double(np0 + mq0 + nb) * nb;
+    double lrwork = std::max(1. + 9. * n + 3. * localElements,
+                             double(np0 + mq0 + nb) * nb);
+    double liwork = 7. * n + 8. * npcol + 2.;
+    workspaceBytes = lwork * sizeof(std::complex<double>)
+        + lrwork * sizeof(double) + liwork * sizeof(blacsInt);
+    maxWorkspace = std::max(lwork, lrwork);
+    flops = flopsHeevd(n);
+  } else {
+    Error("Unknown operation " + request.operation + " in planOperation.");
+  }
+
+  // eigensolvers also return the eigenvalues
+  if (request.operation != "fill" && request.operation != "gemm") {
+    workspaceBytes += double(n) * sizeof(double);
+  }
+  estimate.workspaceBytes = workspaceBytes;
+  estimate.flops = flops;
+  estimate.flopsPerProcess = flops / numProcs;
+  if (request.gflopsPerProcess > 0.) {
+    estimate.time = estimate.flopsPerProcess / request.gflopsPerProcess * 1.e-9;
+  }
+  // only a limit of the 32-bit scalapack interface
+  estimate.overflowsInt = sizeof(blacsInt) < sizeof(int64_t)
+      && (localElements > INT_MAX || maxWorkspace > INT_MAX);
+  return estimate;
+}
+
+void printPlan(const PlanRequest& request, const PlanEstimate& estimate) {
+  if (!mpi->mpiHead()) return;
+  fprintf(stdout, "Plan for %s, N = %d, grid %d x %d, block size %d%s:\n",
+          request.operation.c_str(), request.numRows, request.numBlacsRows,
+          request.numBlacsCols, request.blockSize,
+          request.isComplex ? " (complex)" : "");
+  fprintf(stdout, "  local block of the largest process: %d x %d\n",
+          estimate.localRows, estimate.localCols);
+  fprintf(stdout, "  matrix memory per process:    %12.3f GB\n",
+          estimate.matrixBytes / 1.e9);
+  fprintf(stdout, "  workspace memory per process: %12.3f GB\n",
+          estimate.workspaceBytes / 1.e9);
+  fprintf(stdout, "  total memory per process:     %12.3f GB\n",
+          (estimate.matrixBytes + estimate.workspaceBytes) / 1.e9);
+  fprintf(stdout, "  flops: %.4g total, %.4g per process\n", estimate.flops,
+          estimate.flopsPerProcess);
+  if (estimate.time > 0.) {
+    fprintf(stdout, "  estimated time at %.3f GFLOP/s per process: %.3f s\n",
+            request.gflopsPerProcess, estimate.time);
+  }
+  if (estimate.overflowsInt) {
+    fprintf(stdout, "  Warning: local elements or workspace exceed the range "
+            "of a 32-bit int: use more processes, or an ILP64 build.\n");
+  }
+  if (request.operation != "fill" && request.operation != "gemm" &&
+      request.numBlacsRows != request.numBlacsCols) {
+    fprintf(stdout, "  Warning: diagonalize requires a square process grid.\n");
+  }
+}
+
+PlanRequest parsePlanRequest(int argc, char** argv) {
+  PlanRequest request;
+  request.numRows = std::stoi(getArgument(argc, argv, "-n", "0"));
+  request.blockSize = std::stoi(getArgument(argc, argv, "-block", "64"));
+  request.operation = getArgument(argc, argv, "-op", "syevd");
+  request.numEigenvalues = std::stoi(getArgument(argc, argv, "-nev", "0"));
+  request.isComplex = hasArgument(argc, argv, "-complex");
+  request.gflopsPerProcess = std::stod(getArgument(argc, argv, "-gflops", "0"));
+
+  // grid as <rows>x<cols>, defaults to the current number of MPI processes
+  std::string grid = getArgument(argc, argv, "-grid", "");
+  if (grid.empty()) {
+    request.numBlacsRows = int(sqrt(mpi->getSize()));
+    request.numBlacsCols = mpi->getSize() / request.numBlacsRows;
+  } else {
+    size_t x = grid.find('x');
+    if (x == std::string::npos) {
+      Error("The -grid flag must be given as <rows>x<cols>.");
+    }
+    request.numBlacsRows = std::stoi(grid.substr(0, x));
+    request.numBlacsCols = std::stoi(grid.substr(x + 1));
+  }
+  if (request.numRows <= 0 || request.blockSize <= 0 ||
+      request.numBlacsRows <= 0 || request.numBlacsCols <= 0) {
+    Error("The planner needs positive -n, -block and -grid values.");
+  }
+  return request;
+}
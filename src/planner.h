@@ -0,0 +1,54 @@
+#pragma once
+
+#include <string>
+
+/** Description of a ParallelMatrix operation to be planned.
+ * The matrix is square, of size numRows, block-cyclically distributed with
+ * square blocks of size blockSize over a numBlacsRows x numBlacsCols grid.
+ */
+struct PlanRequest {
+  int numRows = 0;
+  int numBlacsRows = 1;
+  int numBlacsCols = 1;
+  int blockSize = 64;
+  // one of "fill", "gemm", "syevd", "syevr", "heev" (complex p?heevd)
+  std::string operation = "syevd";
+  int numEigenvalues = 0;     // only used by syevr, 0 means all
+  bool isComplex = false;     // heev is always complex
+  double gflopsPerProcess = 0.;  // if > 0, used to estimate the run time
+};
+
+/** Cost of an operation for the MPI process holding the largest block of
+ * the matrix (process (0,0) of the grid).
+ */
+struct PlanEstimate {
+  int localRows = 0;
+  int localCols = 0;
+  double matrixBytes = 0.;     // all ParallelMatrix buffers of the operation
+  double workspaceBytes = 0.;  // ScaLAPACK work arrays and eigenvalues
+  double flops = 0.;           // total over all processes
+  double flopsPerProcess = 0.;
+  double time = 0.;            // seconds, 0 if no flop rate was given
+  // true if the workspace or local element count overflow a 32-bit int,
+  // in a build with the 32-bit (LP64) scalapack interface
+  bool overflowsInt = false;
+};
+
+/** Predicts memory and flops of an operation without allocating anything.
+ * Local sizes are computed with numroc_ and workspaces with the same
+ * formulas used by ParallelMatrix::diagonalize (the minimum sizes
+ * documented by ScaLAPACK, where diagonalize asks ScaLAPACK for them).
+ * @param request: the operation to plan.
+ * @return estimate: per-process memory and flops.
+ */
+PlanEstimate planOperation(const PlanRequest& request);
+
+/** Prints the estimate of an operation on the head MPI process.
+ */
+void printPlan(const PlanRequest& request, const PlanEstimate& estimate);
+
+/** Builds a plan request from the command line flags
+ * -n <size> -grid <rows>x<cols> -block <size> -op <operation>
+ * -nev <number of eigenvalues> -complex -gflops <rate per process>.
+ */
+PlanRequest parsePlanRequest(int argc, char** argv);
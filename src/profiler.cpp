@@ -0,0 +1,301 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <set>
+#include <vector>
+#include "blacs.h"
+#include "mpi/mpiHelper.h"
+
+Profiler* profiler = nullptr;
+
+void Profiler::addRegion(const std::string& name, const double& time,
+                         const double& flops, const uint64_t* events) {
+  RegionStats& stats = regions[name];
+  stats.numCalls += 1;
+  stats.time += time;
+  stats.flops += flops;
+  if (events != nullptr) {
+    for (int i = 0; i < numPerfEvents; i++) stats.events[i] += double(events[i]);
+  }
+}
+
+void Profiler::addMemory(const std::string& category, const long& bytes) {
+  MemoryStats& stats = memory[category];
+  stats.current += bytes;
+  stats.peak = std::max(stats.peak, stats.current);
+  totalMemory.current += bytes;
+  totalMemory.peak = std::max(totalMemory.peak, totalMemory.current);
+}
+
+MemoryStats Profiler::getMemory(const std::string& category) const {
+  auto it = memory.find(category);
+  if (it == memory.end()) return MemoryStats();
+  return it->second;
+}
+
+void Profiler::memoryCheckpoint(const std::string& label) {
+  // processes may not have allocated all kinds of buffers, so we first
+  // collect the union of the category names of all processes
+  std::vector<int> chars;
+  for (auto& [name, stats] : memory) {
+    chars.insert(chars.end(), name.begin(), name.end());
+    chars.push_back('\n');
+  }
+  int numProcs = mpi->getSize();
+  int numChars = int(chars.size());
+  std::vector<int> allNumChars(numProcs);
+  mpi->allGather(&numChars, &allNumChars);
+  std::vector<size_t> workDivs(numProcs);
+  std::vector<size_t> workDivisionHeads(numProcs);
+  size_t totalChars = 0;
+  for (int p = 0; p < numProcs; p++) {
+    workDivs[p] = allNumChars[p];
+    workDivisionHeads[p] = totalChars;
+    totalChars += allNumChars[p];
+  }
+  std::vector<int> allChars(totalChars);
+  mpi->bigAllGatherV(chars.data(), allChars.data(), workDivs,
+                     workDivisionHeads);
+  std::set<std::string> categories;
+  std::string name;
+  for (int c : allChars) {
+    if (c == '\n') {
+      categories.insert(name);
+      name.clear();
+    } else {
+      name += char(c);
+    }
+  }
+
+  // columns: rss, peak rss, tracked current, tracked peak, category peaks
+  auto [rss, peakRss] = residentSetSize();
+  std::vector<double> values = {double(rss), double(peakRss),
+                                double(totalMemory.current),
+                                double(totalMemory.peak)};
+  for (auto& category : categories) {
+    values.push_back(double(getMemory(category).peak));
+  }
+  int numValues = int(values.size());
+  std::vector<double> allValues(numValues * numProcs);
+  mpi->allGather(&values, &allValues);
+
+  if (!mpi->mpiHead()) return;
+  std::cout << "Memory at " << label << " [MB]:\n";
+  fprintf(stdout, "%6s %10s %10s %10s %10s", "rank", "RSS", "peak RSS",
+          "tracked", "peak");
+  for (auto& category : categories) fprintf(stdout, " %22s", category.c_str());
+  fprintf(stdout, "\n");
+  for (int p = 0; p < numProcs; p++) {
+    fprintf(stdout, "%6d", p);
+    for (int i = 0; i < numValues; i++) {
+      fprintf(stdout, i < 4 ? " %10.2f" : " %22.2f",
+              allValues[p * numValues + i] / 1.e6);
+    }
+    fprintf(stdout, "\n");
+  }
+}
+
+void Profiler::enablePerfCounters() {
+  usePerfCounters = perfCounters.open();
+  int available = usePerfCounters ? 1 : 0;
+  mpi->allReduceMin(&available);
+  if (available == 0 && mpi->mpiHead()) {
+    std::cout << "Warning: hardware counters are not available on all "
+                 "processes (check /proc/sys/kernel/perf_event_paranoid)."
+              << std::endl;
+  }
+}
+
+void Profiler::readPerfCounters(uint64_t* values) const {
+  perfCounters.read(values);
+}
+
+RegionStats Profiler::getRegion(const std::string& name) const {
+  auto it = regions.find(name);
+  if (it == regions.end()) return RegionStats();
+  return it->second;
+}
+
+double Profiler::calibratePeak(const int& dim) {
+  std::vector<double> a(size_t(dim) * dim, 1.);
+  std::vector<double> b(size_t(dim) * dim, 1.);
+  std::vector<double> c(size_t(dim) * dim, 0.);
+  char trans = 'N';
+  double alpha = 1.;
+  double beta = 0.;
+  blacsInt n = dim;
+
+  // warm up the library (threads, buffers), then keep the fastest run
+  dgemm_(&trans, &trans, &n, &n, &n, &alpha, a.data(), &n, b.data(), &n,
+         &beta, c.data(), &n);
+  mpi->barrier();
+  double bestTime = std::numeric_limits<double>::max();
+  for (int i = 0; i < 3; i++) {
+    auto start = std::chrono::steady_clock::now();
+    dgemm_(&trans, &trans, &n, &n, &n, &alpha, a.data(), &n, b.data(), &n,
+           &beta, c.data(), &n);
+    std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    bestTime = std::min(bestTime, elapsed.count());
+  }
+  peakGflops = flopsGemm<double>(dim, dim, dim) / bestTime * 1.e-9;
+  return peakGflops;
+}
+
+void Profiler::report() {
+
+  // regions are reduced one by one, so all processes must have the same list:
+  // compare a hash (FNV-1a) of the sorted region names
+  int numRegions = int(regions.size());
+  size_t namesHash = 14695981039346656037ull;
+  for (auto& [name, stats] : regions) {
+    for (char c : name + '\n') {
+      namesHash = (namesHash ^ size_t((unsigned char)c)) * 1099511628211ull;
+    }
+  }
+  size_t minHash = namesHash;
+  size_t maxHash = namesHash;
+  mpi->allReduceMin(&minHash);
+  mpi->allReduceMax(&maxHash);
+  if (minHash != maxHash) {
+    if (mpi->mpiHead()) {
+      std::cout << "Profiler: timed regions differ across MPI processes, "
+                   "no report is printed." << std::endl;
+    }
+    memoryCheckpoint("end of run");
+    return;
+  }
+  if (numRegions == 0) {
+    memoryCheckpoint("end of run");
+    return;
+  }
+
+  // calibrate the peak only if there is something to compare it with
+  double localFlops = 0.;
+  for (auto& [name, stats] : regions) localFlops += stats.flops;
+  mpi->allReduceSum(&localFlops);
+  double totalPeak = 0.;
+  if (localFlops > 0.) {
+    if (peakGflops == 0.) calibratePeak();
+    totalPeak = peakGflops;
+    mpi->allReduceSum(&totalPeak);
+  }
+
+  if (mpi->mpiHead()) {
+    std::cout << "Profiled regions (time of the slowest process):\n";
+    fprintf(stdout, "%-20s %8s %12s %14s %14s %14s %8s\n", "region", "calls",
+            "time [s]", "GFLOP/s total", "GFLOP/s/p min", "GFLOP/s/p max",
+            "% peak");
+  }
+  for (auto& [name, stats] : regions) {
+    double maxTime = stats.time;
+    double flops = stats.flops;
+    double rate = stats.time > 0. ? stats.flops / stats.time * 1.e-9 : 0.;
+    double minRate = rate;
+    double maxRate = rate;
+    mpi->allReduceMax(&maxTime);
+    mpi->allReduceSum(&flops);
+    mpi->allReduceMin(&minRate);
+    mpi->allReduceMax(&maxRate);
+
+    double totalRate = maxTime > 0. ? flops / maxTime * 1.e-9 : 0.;
+    double fraction = totalPeak > 0. ? 100. * totalRate / totalPeak : 0.;
+    if (mpi->mpiHead()) {
+      fprintf(stdout, "%-20s %8zu %12.4f %14.3f %14.3f %14.3f %8.2f\n",
+              name.c_str(), stats.numCalls, maxTime, totalRate, minRate,
+              maxRate, fraction);
+    }
+  }
+  if (mpi->mpiHead() && totalPeak > 0.) {
+    fprintf(stdout, "Peak from local DGEMM calibration: %.3f GFLOP/s total, "
+            "%.3f GFLOP/s per process\n", totalPeak,
+            totalPeak / mpi->getSize());
+  }
+
+  int useCounters = usePerfCounters ? 1 : 0;
+  mpi->allReduceMax(&useCounters);
+  if (useCounters == 1) reportPerfCounters();
+
+  memoryCheckpoint("end of run");
+}
+
+void Profiler::reportPerfCounters() {
+  if (mpi->mpiHead()) {
+    std::cout << "Hardware counters (sum over processes):\n";
+    fprintf(stdout, "%-20s %14s %14s %8s %14s %10s %10s\n", "region",
+            "cycles", "instructions", "IPC", "LLC misses", "miss/kins",
+            "% stalled");
+  }
+  for (auto& [name, stats] : regions) {
+    double events[numPerfEvents];
+    for (int i = 0; i < numPerfEvents; i++) events[i] = stats.events[i];
+    for (int i = 0; i < numPerfEvents; i++) mpi->allReduceSum(&events[i]);
+    if (!mpi->mpiHead()) continue;
+
+    double cycles = events[0];
+    double instructions = events[1];
+    double misses = events[2];
+    double stalls = events[3];
+    double ipc = cycles > 0. ? instructions / cycles : 0.;
+    double missRate = instructions > 0. ? 1000. * misses / instructions : 0.;
+    double stallFraction = cycles > 0. ? 100. * stalls / cycles : 0.;
+    fprintf(stdout, "%-20s %14.4g %14.4g %8.3f %14.4g %10.3f %10.2f\n",
+            name.c_str(), cycles, instructions, ipc, misses, missRate,
+            stallFraction);
+  }
+  if (mpi->mpiHead()) {
+    for (int i = 0; i < numPerfEvents; i++) {
+      if (!perfCounters.isAvailable(i)) {
+        std::cout << "Note: " << PerfCounters::eventNames[i]
+                  << " are not counted on this system." << std::endl;
+      }
+    }
+  }
+}
+
+RegionTimer::RegionTimer(const std::string& name_, const double& flops_)
+    : name(name_), flops(flops_) {
+  if (profiler != nullptr && profiler->perfCountersEnabled()) {
+    profiler->readPerfCounters(startEvents);
+  }
+  start = std::chrono::steady_clock::now();
+}
+
+RegionTimer::~RegionTimer() {
+  if (profiler == nullptr) return;
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  if (profiler->perfCountersEnabled()) {
+    uint64_t events[numPerfEvents];
+    profiler->readPerfCounters(events);
+    for (int i = 0; i < numPerfEvents; i++) events[i] -= startEvents[i];
+    profiler->addRegion(name, elapsed.count(), flops, events);
+  } else {
+    profiler->addRegion(name, elapsed.count(), flops);
+  }
+}
+
+void trackMemory(const std::string& category, const long& bytes) {
+  if (profiler != nullptr) profiler->addMemory(category, bytes);
+}
+
+std::tuple<long, long> residentSetSize() {
+  long rss = 0;
+  long peakRss = 0;
+  std::ifstream status("/proc/self/status");
+  std::string key;
+  while (status >> key) {
+    // values are given in kB
+    if (key == "VmRSS:") {
+      status >> rss;
+      rss *= 1024;
+    } else if (key == "VmHWM:") {
+      status >> peakRss;
+      peakRss *= 1024;
+    }
+  }
+  return std::make_tuple(rss, peakRss);
+}
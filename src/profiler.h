@@ -0,0 +1,220 @@
+#pragma once
+
+#include <chrono>
+#include <complex>
+#include <map>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include "perfCounters.h"
+
+/** Statistics accumulated by one MPI process for a named region of code.
+ */
+struct RegionStats {
+  size_t numCalls = 0;
+  double time = 0.;   // seconds
+  double flops = 0.;  // floating point operations
+  // hardware events, see PerfCounters::eventNames. Zero unless enabled.
+  double events[numPerfEvents] = {0., 0., 0., 0.};
+};
+
+/** Bytes held by one MPI process for a category of buffers.
+ */
+struct MemoryStats {
+  long current = 0;
+  long peak = 0;
+};
+
+/** Class collecting the timings and floating point operation counts of
+ * named regions of the code (e.g. "prod" or "diagonalize").
+ *
+ * Regions are filled by RegionTimer objects. The report, printed when the
+ * MPI environment is deleted, contains for each region the achieved GFLOP/s
+ * per process and overall, and the fraction of machine peak, where the peak
+ * is measured by a local DGEMM calibration on each process.
+ * Optionally, hardware counters are sampled around each region
+ * (run with the -perf command line flag), to tell whether a region is
+ * compute bound or waiting on the memory.
+ *
+ * The profiler also tracks the bytes held, currently and at peak, by
+ * categories of buffers (ParallelMatrix storage, eigensolver workspaces,
+ * MPI staging buffers), which are printed per process with the resident
+ * set size read from /proc/self/status, at the end of the run and at
+ * labelled checkpoints.
+ */
+class Profiler {
+ private:
+  std::map<std::string, RegionStats> regions;
+
+  // DGEMM rate of this MPI process in GFLOP/s, 0 until calibrated
+  double peakGflops = 0.;
+
+  PerfCounters perfCounters;
+  bool usePerfCounters = false;
+
+  std::map<std::string, MemoryStats> memory;
+  MemoryStats totalMemory;  // sum over all categories
+
+  /** Prints the hardware events of all regions, summed over processes.
+   */
+  void reportPerfCounters();
+
+ public:
+  /** Adds one call of a region.
+   * @param name: name of the region.
+   * @param time: seconds spent in the region.
+   * @param flops: floating point operations executed by this process.
+   * @param events: hardware events counted in the region, array of length
+   * numPerfEvents, or nullptr if counters are not in use.
+   */
+  void addRegion(const std::string& name, const double& time,
+                 const double& flops = 0., const uint64_t* events = nullptr);
+
+  /** Starts sampling hardware counters around every region.
+   * If no counter can be opened, a warning is printed and counters
+   * stay disabled.
+   */
+  void enablePerfCounters();
+
+  /** Returns true if the regions sample hardware counters.
+   */
+  bool perfCountersEnabled() const { return usePerfCounters; }
+
+  /** Reads the current values of the hardware counters.
+   * @param values: array of length numPerfEvents, filled on return.
+   */
+  void readPerfCounters(uint64_t* values) const;
+
+  /** Returns the statistics of a region on this MPI process.
+   * Returns empty statistics if the region has never been called.
+   */
+  RegionStats getRegion(const std::string& name) const;
+
+  /** Measures the DGEMM rate of this MPI process on a local square
+   * matrix product, which we use as the machine peak.
+   * All processes run the calibration at the same time, so that the result
+   * accounts for the contention over the memory bandwidth of a node.
+   * @param dim: size of the matrices multiplied.
+   * @return peak: GFLOP/s of this process.
+   */
+  double calibratePeak(const int& dim = 1024);
+
+  /** Adds bytes to a memory category, or removes them if negative.
+   * @param category: name of the category, e.g. "ParallelMatrix".
+   * @param bytes: number of bytes allocated (>0) or freed (<0).
+   */
+  void addMemory(const std::string& category, const long& bytes);
+
+  /** Returns the bytes tracked for a category on this MPI process.
+   */
+  MemoryStats getMemory(const std::string& category) const;
+
+  /** Prints, for every MPI process, the tracked memory and the resident set
+   * size. Must be called by all MPI processes.
+   * @param label: name of the checkpoint, printed in the header.
+   */
+  void memoryCheckpoint(const std::string& label);
+
+  /** Prints the statistics of all regions, reduced over MPI processes,
+   * and the memory of every process.
+   * Must be called by all MPI processes.
+   */
+  void report();
+};
+
+// globally available profiler, created with the MPI environment
+extern Profiler* profiler;
+
+/** Timer of a region of code, from construction to destruction.
+ * The measured time and flops are added to the global profiler.
+ */
+class RegionTimer {
+ private:
+  std::string name;
+  double flops;
+  std::chrono::steady_clock::time_point start;
+  uint64_t startEvents[numPerfEvents];
+
+ public:
+  /** @param name: name of the region.
+   * @param flops: floating point operations executed by this process
+   * in the region, see the flop models below.
+   */
+  RegionTimer(const std::string& name, const double& flops = 0.);
+  ~RegionTimer();
+};
+
+/** Adds (or removes, if negative) bytes to a category of buffers of the
+ * global profiler. Does nothing if the profiler doesn't exist.
+ */
+void trackMemory(const std::string& category, const long& bytes);
+
+/** Reads the resident set size of this process from /proc/self/status.
+ * @return rss: tuple of current and peak resident set sizes in bytes,
+ * zero if they cannot be read.
+ */
+std::tuple<long, long> residentSetSize();
+
+// Flop models ----------------------------------------------------------
+// Counts are the standard estimates (real flops), and are divided by the
+// number of MPI processes when used for a distributed operation.
+
+template <typename T>
+struct isComplex : std::false_type {};
+template <typename T>
+struct isComplex<std::complex<T>> : std::true_type {};
+
+/** Flops of a matrix product C(m,n) = A(m,k) * B(k,n).
+ * A complex multiply-add costs 8 real flops instead of 2.
+ */
+template <typename T>
+double flopsGemm(const int& m, const int& n, const int& k) {
+  double f = 2. * double(m) * double(n) * double(k);
+  return isComplex<T>::value ? 4. * f : f;
+}
+
+/** Flops of the real symmetric divide and conquer eigensolver (p?syevd),
+ * with eigenvectors: 4/3 n^3 for the tridiagonal reduction, 4/3 n^3 for the
+ * divide and conquer step and 2 n^3 for the back transformation.
+ */
+inline double flopsSyevd(const int& n) {
+  double n3 = double(n) * double(n) * double(n);
+  return 14. / 3. * n3;
+}
+
+/** Flops of the real symmetric MRRR eigensolver (p?syevr) computing
+ * k eigenvectors: 4/3 n^3 for the tridiagonal reduction and 2 n^2 k for the
+ * back transformation.
+ */
+inline double flopsSyevr(const int& n, const int& k) {
+  double n2 = double(n) * double(n);
+  return 4. / 3. * n2 * double(n) + 2. * n2 * double(k);
+}
+
+/** Flops of the complex hermitian divide and conquer eigensolver (p?heevd),
+ * with eigenvectors: 16/3 n^3 for the complex tridiagonal reduction, 4/3 n^3
+ * for the real divide and conquer step and 8 n^3 for the complex back
+ * transformation.
+ */
+inline double flopsHeevd(const int& n) {
+  double n3 = double(n) * double(n) * double(n);
+  return 44. / 3. * n3;
+}
+
+/** Flops of the LU factorization of a square matrix (p?getrf).
+ * A complex multiply-add costs 8 real flops instead of 2.
+ */
+template <typename T>
+double flopsGetrf(const int& n) {
+  double f = 2. / 3. * double(n) * double(n) * double(n);
+  return isComplex<T>::value ? 4. * f : f;
+}
+
+/** Flops of the solution of a linear system from its LU factors (p?getrs),
+ * for numRhs right hand sides.
+ */
+template <typename T>
+double flopsGetrs(const int& n, const int& numRhs) {
+  double f = 2. * double(n) * double(n) * double(numRhs);
+  return isComplex<T>::value ? 4. * f : f;
+}
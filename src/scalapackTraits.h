@@ -0,0 +1,337 @@
+#pragma once
+
+/** \file   scalapackTraits.h
+ *  \brief  Compile-time map from the element type of a ParallelMatrix to
+ *  the ScaLAPACK routines of that precision (p?gemm, p?syevd, ...).
+ *
+ *  scalapack<T> has the same static functions for every T, with the
+ *  argument lists of the complex routines. The real specializations drop
+ *  the arguments that only the complex routines take (e.g. rwork), so that
+ *  operations can be written once, as templates over T.
+ *  Adding a precision means adding one specialization here.
+ */
+
+#include <complex>
+#include "blacs.h"
+
+template <typename T>
+struct scalapack;
+
+template <>
+struct scalapack<double> {
+  using real = double;  // type of the eigenvalues and of rwork
+  static constexpr const char* prefix = "PD";  // for error messages
+
+  static void gemm(const char* transa, const char* transb, blacsInt* m,
+                   blacsInt* n, const blacsInt* k, double* alpha, double* a,
+                   blacsInt* ia, blacsInt* ja, const blacsInt* desca, double* b,
+                   blacsInt* ib, blacsInt* jb, const blacsInt* descb,
+                   double* beta, double* c, blacsInt* ic, blacsInt* jc,
+                   blacsInt* descc) {
+    pdgemm_(transa, transb, m, n, k, alpha, a, ia, ja, desca, b, ib, jb, descb,
+            beta, c, ic, jc, descc);
+  }
+  // real symmetric / complex hermitian, divide and conquer
+  static void heevd(char* jobz, char* uplo, blacsInt* n, double* a,
+                    blacsInt* ia, blacsInt* ja, blacsInt* desca, double* w,
+                    double* z, blacsInt* iz, blacsInt* jz, blacsInt* descz,
+                    double* work, blacsInt* lwork, double* /*rwork*/,
+                    blacsInt* /*lrwork*/, blacsInt* iwork, blacsInt* liwork,
+                    blacsInt* info) {
+    pdsyevd_(jobz, uplo, n, a, ia, ja, desca, w, z, iz, jz, descz, work, lwork,
+             iwork, liwork, info);
+  }
+  // real symmetric / complex hermitian, MRRR, for a subset of eigenpairs
+  static void heevr(const char* jobz, const char* range, const char* uplo,
+                    blacsInt* n, double* a, blacsInt* ia, blacsInt* ja,
+                    blacsInt* desca, double* vl, double* vu, blacsInt* il,
+                    blacsInt* iu, blacsInt* m, blacsInt* nz, double* w,
+                    double* z, blacsInt* iz, blacsInt* jz, blacsInt* descz,
+                    double* work, blacsInt* lwork, double* /*rwork*/,
+                    blacsInt* /*lrwork*/, blacsInt* iwork, blacsInt* liwork,
+                    blacsInt* info) {
+    pdsyevr_(jobz, range, uplo, n, a, ia, ja, desca, vl, vu, il, iu, m, nz, w,
+             z, iz, jz, descz, work, lwork, iwork, liwork, info);
+  }
+  // reduction to real tridiagonal form, with the tridiagonal matrix in d, e
+  static void hetrd(char* uplo, blacsInt* n, double* a, blacsInt* ia,
+                    blacsInt* ja, blacsInt* desca, double* d, double* e,
+                    double* tau, double* work, blacsInt* lwork,
+                    blacsInt* info) {
+    pdsytrd_(uplo, n, a, ia, ja, desca, d, e, tau, work, lwork, info);
+  }
+  // C = alpha A A^T + beta C on the uplo triangle of C (A A^H, with real
+  // alpha and beta, for complex numbers)
+  static void syrk(const char* uplo, const char* trans, blacsInt* n,
+                   blacsInt* k, double* alpha, double* a, blacsInt* ia,
+                   blacsInt* ja, blacsInt* desca, double* beta, double* c,
+                   blacsInt* ic, blacsInt* jc, blacsInt* descc) {
+    pdsyrk_(uplo, trans, n, k, alpha, a, ia, ja, desca, beta, c, ic, jc, descc);
+  }
+  // C = beta C + alpha A^T (A^H for complex numbers)
+  static void tran(blacsInt* m, blacsInt* n, double* alpha, double* a,
+                   blacsInt* ia, blacsInt* ja, blacsInt* desca, double* beta,
+                   double* c, blacsInt* ic, blacsInt* jc, blacsInt* descc) {
+    pdtran_(m, n, alpha, a, ia, ja, desca, beta, c, ic, jc, descc);
+  }
+  static void gemr2d(blacsInt* m, blacsInt* n, double* a, blacsInt* ia,
+                     blacsInt* ja, blacsInt* desca, double* b, blacsInt* ib,
+                     blacsInt* jb, blacsInt* descb, blacsInt* context) {
+    pdgemr2d_(m, n, a, ia, ja, desca, b, ib, jb, descb, context);
+  }
+  static void getrf(blacsInt* m, blacsInt* n, double* a, blacsInt* ia,
+                    blacsInt* ja, blacsInt* desca, blacsInt* ipiv,
+                    blacsInt* info) {
+    pdgetrf_(m, n, a, ia, ja, desca, ipiv, info);
+  }
+  static void getrs(char* trans, blacsInt* n, blacsInt* nrhs, double* a,
+                    blacsInt* ia, blacsInt* ja, blacsInt* desca, blacsInt* ipiv,
+                    double* b, blacsInt* ib, blacsInt* jb, blacsInt* descb,
+                    blacsInt* info) {
+    pdgetrs_(trans, n, nrhs, a, ia, ja, desca, ipiv, b, ib, jb, descb, info);
+  }
+  // BLACS broadcast of an m x n matrix within scope, from this process
+  static void gebs2d(const blacsInt* context, const char* scope,
+                     const blacsInt* m, const blacsInt* n, double* a,
+                     const blacsInt* lda) {
+    dgebs2d_(context, scope, " ", m, n, a, lda);
+  }
+  // receives the broadcast sent by process (rsrc,csrc)
+  static void gebr2d(const blacsInt* context, const char* scope,
+                     const blacsInt* m, const blacsInt* n, double* a,
+                     const blacsInt* lda, const blacsInt* rsrc,
+                     const blacsInt* csrc) {
+    dgebr2d_(context, scope, " ", m, n, a, lda, rsrc, csrc);
+  }
+};
+
+template <>
+struct scalapack<float> {
+  using real = float;
+  static constexpr const char* prefix = "PS";
+
+  static void gemm(const char* transa, const char* transb, blacsInt* m,
+                   blacsInt* n, const blacsInt* k, float* alpha, float* a,
+                   blacsInt* ia, blacsInt* ja, const blacsInt* desca, float* b,
+                   blacsInt* ib, blacsInt* jb, const blacsInt* descb,
+                   float* beta, float* c, blacsInt* ic, blacsInt* jc,
+                   blacsInt* descc) {
+    psgemm_(transa, transb, m, n, k, alpha, a, ia, ja, desca, b, ib, jb, descb,
+            beta, c, ic, jc, descc);
+  }
+  static void heevd(char* jobz, char* uplo, blacsInt* n, float* a, blacsInt* ia,
+                    blacsInt* ja, blacsInt* desca, float* w, float* z,
+                    blacsInt* iz, blacsInt* jz, blacsInt* descz, float* work,
+                    blacsInt* lwork, float* /*rwork*/, blacsInt* /*lrwork*/,
+                    blacsInt* iwork, blacsInt* liwork, blacsInt* info) {
+    pssyevd_(jobz, uplo, n, a, ia, ja, desca, w, z, iz, jz, descz, work, lwork,
+             iwork, liwork, info);
+  }
+  static void heevr(const char* jobz, const char* range, const char* uplo,
+                    blacsInt* n, float* a, blacsInt* ia, blacsInt* ja,
+                    blacsInt* desca, float* vl, float* vu, blacsInt* il,
+                    blacsInt* iu, blacsInt* m, blacsInt* nz, float* w, float* z,
+                    blacsInt* iz, blacsInt* jz, blacsInt* descz, float* work,
+                    blacsInt* lwork, float* /*rwork*/, blacsInt* /*lrwork*/,
+                    blacsInt* iwork, blacsInt* liwork, blacsInt* info) {
+    pssyevr_(jobz, range, uplo, n, a, ia, ja, desca, vl, vu, il, iu, m, nz, w,
+             z, iz, jz, descz, work, lwork, iwork, liwork, info);
+  }
+  static void hetrd(char* uplo, blacsInt* n, float* a, blacsInt* ia,
+                    blacsInt* ja, blacsInt* desca, float* d, float* e,
+                    float* tau, float* work, blacsInt* lwork, blacsInt* info) {
+    pssytrd_(uplo, n, a, ia, ja, desca, d, e, tau, work, lwork, info);
+  }
+  static void syrk(const char* uplo, const char* trans, blacsInt* n,
+                   blacsInt* k, float* alpha, float* a, blacsInt* ia,
+                   blacsInt* ja, blacsInt* desca, float* beta, float* c,
+                   blacsInt* ic, blacsInt* jc, blacsInt* descc) {
+    pssyrk_(uplo, trans, n, k, alpha, a, ia, ja, desca, beta, c, ic, jc, descc);
+  }
+  static void tran(blacsInt* m, blacsInt* n, float* alpha, float* a,
+                   blacsInt* ia, blacsInt* ja, blacsInt* desca, float* beta,
+                   float* c, blacsInt* ic, blacsInt* jc, blacsInt* descc) {
+    pstran_(m, n, alpha, a, ia, ja, desca, beta, c, ic, jc, descc);
+  }
+  static void gemr2d(blacsInt* m, blacsInt* n, float* a, blacsInt* ia,
+                     blacsInt* ja, blacsInt* desca, float* b, blacsInt* ib,
+                     blacsInt* jb, blacsInt* descb, blacsInt* context) {
+    psgemr2d_(m, n, a, ia, ja, desca, b, ib, jb, descb, context);
+  }
+  static void getrf(blacsInt* m, blacsInt* n, float* a, blacsInt* ia,
+                    blacsInt* ja, blacsInt* desca, blacsInt* ipiv,
+                    blacsInt* info) {
+    psgetrf_(m, n, a, ia, ja, desca, ipiv, info);
+  }
+  static void getrs(char* trans, blacsInt* n, blacsInt* nrhs, float* a,
+                    blacsInt* ia, blacsInt* ja, blacsInt* desca, blacsInt* ipiv,
+                    float* b, blacsInt* ib, blacsInt* jb, blacsInt* descb,
+                    blacsInt* info) {
+    psgetrs_(trans, n, nrhs, a, ia, ja, desca, ipiv, b, ib, jb, descb, info);
+  }
+  static void gebs2d(const blacsInt* context, const char* scope,
+                     const blacsInt* m, const blacsInt* n, float* a,
+                     const blacsInt* lda) {
+    sgebs2d_(context, scope, " ", m, n, a, lda);
+  }
+  static void gebr2d(const blacsInt* context, const char* scope,
+                     const blacsInt* m, const blacsInt* n, float* a,
+                     const blacsInt* lda, const blacsInt* rsrc,
+                     const blacsInt* csrc) {
+    sgebr2d_(context, scope, " ", m, n, a, lda, rsrc, csrc);
+  }
+};
+
+template <>
+struct scalapack<std::complex<double>> {
+  using T = std::complex<double>;
+  using real = double;
+  static constexpr const char* prefix = "PZ";
+
+  static void gemm(const char* transa, const char* transb, blacsInt* m,
+                   blacsInt* n, const blacsInt* k, T* alpha, T* a, blacsInt* ia,
+                   blacsInt* ja, const blacsInt* desca, T* b, blacsInt* ib,
+                   blacsInt* jb, const blacsInt* descb, T* beta, T* c,
+                   blacsInt* ic, blacsInt* jc, blacsInt* descc) {
+    pzgemm_(transa, transb, m, n, k, alpha, a, ia, ja, desca, b, ib, jb, descb,
+            beta, c, ic, jc, descc);
+  }
+  static void heevd(char* jobz, char* uplo, blacsInt* n, T* a, blacsInt* ia,
+                    blacsInt* ja, blacsInt* desca, real* w, T* z, blacsInt* iz,
+                    blacsInt* jz, blacsInt* descz, T* work, blacsInt* lwork,
+                    real* rwork, blacsInt* lrwork, blacsInt* iwork,
+                    blacsInt* liwork, blacsInt* info) {
+    pzheevd_(jobz, uplo, n, a, ia, ja, desca, w, z, iz, jz, descz, work, lwork,
+             rwork, lrwork, iwork, liwork, info);
+  }
+  static void heevr(const char* jobz, const char* range, const char* uplo,
+                    blacsInt* n, T* a, blacsInt* ia, blacsInt* ja,
+                    blacsInt* desca, real* vl, real* vu, blacsInt* il,
+                    blacsInt* iu, blacsInt* m, blacsInt* nz, real* w, T* z,
+                    blacsInt* iz, blacsInt* jz, blacsInt* descz, T* work,
+                    blacsInt* lwork, real* rwork, blacsInt* lrwork,
+                    blacsInt* iwork, blacsInt* liwork, blacsInt* info) {
+    pzheevr_(jobz, range, uplo, n, a, ia, ja, desca, vl, vu, il, iu, m, nz, w,
+             z, iz, jz, descz, work, lwork, rwork, lrwork, iwork, liwork,
+             info);
+  }
+  static void hetrd(char* uplo, blacsInt* n, T* a, blacsInt* ia,
+                    blacsInt* ja, blacsInt* desca, real* d, real* e, T* tau,
+                    T* work, blacsInt* lwork, blacsInt* info) {
+    pzhetrd_(uplo, n, a, ia, ja, desca, d, e, tau, work, lwork, info);
+  }
+  static void syrk(const char* uplo, const char* trans, blacsInt* n,
+                   blacsInt* k, real* alpha, T* a, blacsInt* ia, blacsInt* ja,
+                   blacsInt* desca, real* beta, T* c, blacsInt* ic,
+                   blacsInt* jc, blacsInt* descc) {
+    pzherk_(uplo, trans, n, k, alpha, a, ia, ja, desca, beta, c, ic, jc, descc);
+  }
+  static void tran(blacsInt* m, blacsInt* n, T* alpha, T* a, blacsInt* ia,
+                   blacsInt* ja, blacsInt* desca, T* beta, T* c, blacsInt* ic,
+                   blacsInt* jc, blacsInt* descc) {
+    pztranc_(m, n, alpha, a, ia, ja, desca, beta, c, ic, jc, descc);
+  }
+  static void gemr2d(blacsInt* m, blacsInt* n, T* a, blacsInt* ia, blacsInt* ja,
+                     blacsInt* desca, T* b, blacsInt* ib, blacsInt* jb,
+                     blacsInt* descb, blacsInt* context) {
+    pzgemr2d_(m, n, a, ia, ja, desca, b, ib, jb, descb, context);
+  }
+  static void getrf(blacsInt* m, blacsInt* n, T* a, blacsInt* ia, blacsInt* ja,
+                    blacsInt* desca, blacsInt* ipiv, blacsInt* info) {
+    pzgetrf_(m, n, a, ia, ja, desca, ipiv, info);
+  }
+  static void getrs(char* trans, blacsInt* n, blacsInt* nrhs, T* a,
+                    blacsInt* ia, blacsInt* ja, blacsInt* desca, blacsInt* ipiv,
+                    T* b, blacsInt* ib, blacsInt* jb, blacsInt* descb,
+                    blacsInt* info) {
+    pzgetrs_(trans, n, nrhs, a, ia, ja, desca, ipiv, b, ib, jb, descb, info);
+  }
+  static void gebs2d(const blacsInt* context, const char* scope,
+                     const blacsInt* m, const blacsInt* n, T* a,
+                     const blacsInt* lda) {
+    zgebs2d_(context, scope, " ", m, n, a, lda);
+  }
+  static void gebr2d(const blacsInt* context, const char* scope,
+                     const blacsInt* m, const blacsInt* n, T* a,
+                     const blacsInt* lda, const blacsInt* rsrc,
+                     const blacsInt* csrc) {
+    zgebr2d_(context, scope, " ", m, n, a, lda, rsrc, csrc);
+  }
+};
+
+template <>
+struct scalapack<std::complex<float>> {
+  using T = std::complex<float>;
+  using real = float;
+  static constexpr const char* prefix = "PC";
+
+  static void gemm(const char* transa, const char* transb, blacsInt* m,
+                   blacsInt* n, const blacsInt* k, T* alpha, T* a, blacsInt* ia,
+                   blacsInt* ja, const blacsInt* desca, T* b, blacsInt* ib,
+                   blacsInt* jb, const blacsInt* descb, T* beta, T* c,
+                   blacsInt* ic, blacsInt* jc, blacsInt* descc) {
+    pcgemm_(transa, transb, m, n, k, alpha, a, ia, ja, desca, b, ib, jb, descb,
+            beta, c, ic, jc, descc);
+  }
+  static void heevd(char* jobz, char* uplo, blacsInt* n, T* a, blacsInt* ia,
+                    blacsInt* ja, blacsInt* desca, real* w, T* z, blacsInt* iz,
+                    blacsInt* jz, blacsInt* descz, T* work, blacsInt* lwork,
+                    real* rwork, blacsInt* lrwork, blacsInt* iwork,
+                    blacsInt* liwork, blacsInt* info) {
+    pcheevd_(jobz, uplo, n, a, ia, ja, desca, w, z, iz, jz, descz, work, lwork,
+             rwork, lrwork, iwork, liwork, info);
+  }
+  static void heevr(const char* jobz, const char* range, const char* uplo,
+                    blacsInt* n, T* a, blacsInt* ia, blacsInt* ja,
+                    blacsInt* desca, real* vl, real* vu, blacsInt* il,
+                    blacsInt* iu, blacsInt* m, blacsInt* nz, real* w, T* z,
+                    blacsInt* iz, blacsInt* jz, blacsInt* descz, T* work,
+                    blacsInt* lwork, real* rwork, blacsInt* lrwork,
+                    blacsInt* iwork, blacsInt* liwork, blacsInt* info) {
+    pcheevr_(jobz, range, uplo, n, a, ia, ja, desca, vl, vu, il, iu, m, nz, w,
+             z, iz, jz, descz, work, lwork, rwork, lrwork, iwork, liwork,
+             info);
+  }
+  static void hetrd(char* uplo, blacsInt* n, T* a, blacsInt* ia,
+                    blacsInt* ja, blacsInt* desca, real* d, real* e, T* tau,
+                    T* work, blacsInt* lwork, blacsInt* info) {
+    pchetrd_(uplo, n, a, ia, ja, desca, d, e, tau, work, lwork, info);
+  }
+  static void syrk(const char* uplo, const char* trans, blacsInt* n,
+                   blacsInt* k, real* alpha, T* a, blacsInt* ia, blacsInt* ja,
+                   blacsInt* desca, real* beta, T* c, blacsInt* ic,
+                   blacsInt* jc, blacsInt* descc) {
+    pcherk_(uplo, trans, n, k, alpha, a, ia, ja, desca, beta, c, ic, jc, descc);
+  }
+  static void tran(blacsInt* m, blacsInt* n, T* alpha, T* a, blacsInt* ia,
+                   blacsInt* ja, blacsInt* desca, T* beta, T* c, blacsInt* ic,
+                   blacsInt* jc, blacsInt* descc) {
+    pctranc_(m, n, alpha, a, ia, ja, desca, beta, c, ic, jc, descc);
+  }
+  static void gemr2d(blacsInt* m, blacsInt* n, T* a, blacsInt* ia, blacsInt* ja,
+                     blacsInt* desca, T* b, blacsInt* ib, blacsInt* jb,
+                     blacsInt* descb, blacsInt* context) {
+    pcgemr2d_(m, n, a, ia, ja, desca, b, ib, jb, descb, context);
+  }
+  static void getrf(blacsInt* m, blacsInt* n, T* a, blacsInt* ia, blacsInt* ja,
+                    blacsInt* desca, blacsInt* ipiv, blacsInt* info) {
+    pcgetrf_(m, n, a, ia, ja, desca, ipiv, info);
+  }
+  static void getrs(char* trans, blacsInt* n, blacsInt* nrhs, T* a,
+                    blacsInt* ia, blacsInt* ja, blacsInt* desca, blacsInt* ipiv,
+                    T* b, blacsInt* ib, blacsInt* jb, blacsInt* descb,
+                    blacsInt* info) {
+    pcgetrs_(trans, n, nrhs, a, ia, ja, desca, ipiv, b, ib, jb, descb, info);
+  }
+  static void gebs2d(const blacsInt* context, const char* scope,
+                     const blacsInt* m, const blacsInt* n, T* a,
+                     const blacsInt* lda) {
+    cgebs2d_(context, scope, " ", m, n, a, lda);
+  }
+  static void gebr2d(const blacsInt* context, const char* scope,
+                     const blacsInt* m, const blacsInt* n, T* a,
+                     const blacsInt* lda, const blacsInt* rsrc,
+                     const blacsInt* csrc) {
+    cgebr2d_(context, scope, " ", m, n, a, lda, rsrc, csrc);
+  }
+};
@@ -36,4 +36,27 @@ template <typename T> T* allocate(T *&array, const unsigned int size){
         return array;
 }
 
-inline int mod(const int &a, const int &b) { return (a % b + b) % b; }
\ No newline at end of file
+inline int mod(const int &a, const int &b) { return (a % b + b) % b; }
+
+// Returns true if a flag (e.g. "-plan") was given on the command line
+inline bool hasArgument(int argc, char *argv[], const std::string &flag) {
+  for (int i = 0; i < argc; i++) {
+    if (std::string(argv[i]) == flag) return true;
+  }
+  return false;
+}
+
+// Returns the value following a flag on the command line, or defaultValue
+// if the flag wasn't given
+inline std::string getArgument(int argc, char *argv[], const std::string &flag,
+                               const std::string &defaultValue) {
+  for (int i = 0; i < argc; i++) {
+    if (std::string(argv[i]) == flag) {
+      if (i == argc - 1) {
+        Error("Missing value after " + flag + " on the command line");
+      }
+      return std::string(argv[i + 1]);
+    }
+  }
+  return defaultValue;
+}
\ No newline at end of file
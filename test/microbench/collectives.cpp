@@ -0,0 +1,184 @@
+#include <benchmark/benchmark.h>
+#include <climits>
+#include "microbench.h"
+#include "mpi/mpiHelper.h"
+
+// Each benchmark times a fixed number of calls, identical on all processes
+// since every call is collective. The time of a call is the time of the
+// slowest process, and the bandwidth is computed with the bytes sent by
+// one process.
+
+static const std::vector<std::string> commNames = {"world", "intraPool",
+                                                   "interPool"};
+
+// number of calls timed for a message size, fewer for large messages
+static int numIterations(const size_t& bytes) {
+  size_t n = (size_t(1) << 28) / bytes;
+  return int(std::max(size_t(3), std::min(size_t(1000), n)));
+}
+
+// times one call, as the maximum over the processes
+template <typename F>
+static void timeCall(benchmark::State& state, F call) {
+  double t0 = MPI_Wtime();
+  call();
+  double time = MPI_Wtime() - t0;
+  MPI_Allreduce(MPI_IN_PLACE, &time, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+  state.SetIterationTime(time);
+}
+
+static void bmBcast(benchmark::State& state, int communicator, bool raw,
+                    size_t count) {
+  std::vector<double> buffer(count, 1.);
+  MPI_Comm comm = mpi->getComm(communicator);
+  mpi->barrier();
+  for (auto _ : state) {
+    timeCall(state, [&] {
+      if (raw) {
+        MPI_Bcast(buffer.data(), int(count), MPI_DOUBLE, 0, comm);
+      } else {
+        mpi->bcast(&buffer, communicator);
+      }
+    });
+  }
+  state.SetBytesProcessed(state.iterations() * count * sizeof(double));
+}
+
+static void bmAllReduceSum(benchmark::State& state, int communicator,
+                           bool raw, size_t count) {
+  std::vector<double> buffer(count, 1.);
+  MPI_Comm comm = mpi->getComm(communicator);
+  mpi->barrier();
+  for (auto _ : state) {
+    timeCall(state, [&] {
+      if (raw) {
+        MPI_Allreduce(MPI_IN_PLACE, buffer.data(), int(count), MPI_DOUBLE,
+                      MPI_SUM, comm);
+      } else {
+        mpi->allReduceSum(&buffer, communicator);
+      }
+    });
+  }
+  state.SetBytesProcessed(state.iterations() * count * sizeof(double));
+}
+
+static void bmAllGather(benchmark::State& state, int communicator, bool raw,
+                        size_t count) {
+  std::vector<double> dataIn(count, 1.);
+  std::vector<double> dataOut(count * mpi->getSize(communicator));
+  MPI_Comm comm = mpi->getComm(communicator);
+  mpi->barrier();
+  for (auto _ : state) {
+    timeCall(state, [&] {
+      if (raw) {
+        MPI_Allgather(dataIn.data(), int(count), MPI_DOUBLE, dataOut.data(),
+                      int(count), MPI_DOUBLE, comm);
+      } else {
+        mpi->allGather(&dataIn, &dataOut, communicator);
+      }
+    });
+  }
+  state.SetBytesProcessed(state.iterations() * count * sizeof(double));
+}
+
+// gatherv only works on the world communicator
+static void bmGatherv(benchmark::State& state, int communicator, bool raw,
+                      size_t count) {
+  (void)communicator;
+  int size = mpi->getSize();
+  std::vector<double> dataIn(count, 1.);
+  std::vector<double> dataOut(count * size);
+  std::vector<int> counts(size, int(count));
+  std::vector<int> displacements(size);
+  for (int i = 0; i < size; i++) displacements[i] = i * int(count);
+  mpi->barrier();
+  for (auto _ : state) {
+    timeCall(state, [&] {
+      if (raw) {
+        MPI_Gatherv(dataIn.data(), int(count), MPI_DOUBLE, dataOut.data(),
+                    counts.data(), displacements.data(), MPI_DOUBLE, 0,
+                    MPI_COMM_WORLD);
+      } else {
+        mpi->gatherv(&dataIn, &dataOut);
+      }
+    });
+  }
+  state.SetBytesProcessed(state.iterations() * count * sizeof(double));
+}
+
+// the raw version is MPI_Allgatherv, hence only for outputs below INT_MAX.
+// bigAllGatherV uses its point to point path from countLimit elements
+static void timeBigAllGatherV(benchmark::State& state, int communicator,
+                              bool raw, size_t count, size_t countLimit) {
+  int size = mpi->getSize(communicator);
+  std::vector<double> dataIn(count, 1.);
+  std::vector<double> dataOut(count * size);
+  std::vector<size_t> workDivs(size, count);
+  std::vector<size_t> workDivisionHeads(size);
+  std::vector<int> counts(size, int(count));
+  std::vector<int> displacements(size);
+  for (int i = 0; i < size; i++) {
+    workDivisionHeads[i] = i * count;
+    displacements[i] = i * int(count);
+  }
+  MPI_Comm comm = mpi->getComm(communicator);
+  mpi->barrier();
+  for (auto _ : state) {
+    timeCall(state, [&] {
+      if (raw) {
+        MPI_Allgatherv(dataIn.data(), int(count), MPI_DOUBLE, dataOut.data(),
+                       counts.data(), displacements.data(), MPI_DOUBLE, comm);
+      } else {
+        mpi->bigAllGatherV(dataIn.data(), dataOut.data(), workDivs,
+                           workDivisionHeads, communicator, countLimit);
+      }
+    });
+  }
+  state.SetBytesProcessed(state.iterations() * count * sizeof(double));
+}
+
+static void bmBigAllGatherV(benchmark::State& state, int communicator,
+                            bool raw, size_t count) {
+  timeBigAllGatherV(state, communicator, raw, count, INT_MAX);
+}
+
+// bigAllGatherV forced through its point to point path, whatever the size
+static void bmBigAllGatherVBigCount(benchmark::State& state, int communicator,
+                                    bool raw, size_t count) {
+  timeBigAllGatherV(state, communicator, raw, count, 0);
+}
+
+void registerCollectiveBenchmarks(const size_t& maxBytes) {
+  typedef void (*Function)(benchmark::State&, int, bool, size_t);
+  const std::vector<std::tuple<std::string, Function, bool>> benchmarks = {
+      // name, function, whether it runs on all communicators
+      {"bcast", bmBcast, true},
+      {"allReduceSum", bmAllReduceSum, true},
+      {"allGather", bmAllGather, true},
+      {"gatherv", bmGatherv, false},
+      {"bigAllGatherV", bmBigAllGatherV, true},
+      {"bigAllGatherV(bigCount)", bmBigAllGatherVBigCount, true}};
+
+  for (auto& [name, function, allComms] : benchmarks) {
+    for (int communicator = 0; communicator < numComms_; communicator++) {
+      if (!allComms && communicator != mpi->worldComm) continue;
+      int commSize = mpi->getSize(communicator);
+      for (size_t bytes = 8; bytes <= maxBytes; bytes *= 8) {
+        size_t count = bytes / sizeof(double);
+        for (bool raw : {false, true}) {
+          // raw MPI calls take int counts
+          if (raw && count * commSize > INT_MAX) continue;
+          if (raw && name == "bigAllGatherV(bigCount)") continue;
+          std::string fullName = name + "/" + commNames[communicator] + "/" +
+                                 (raw ? "raw" : "wrapper") +
+                                 "/bytes:" + std::to_string(bytes);
+          benchmark::RegisterBenchmark(fullName.c_str(), function,
+                                       communicator, raw, count)
+              ->Iterations(numIterations(bytes))
+              ->UseManualTime()
+              ->Unit(benchmark::kMicrosecond);
+        }
+      }
+    }
+  }
+}
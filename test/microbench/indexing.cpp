@@ -0,0 +1,172 @@
+#include <benchmark/benchmark.h>
+#include <memory>
+#include "PMatrix.h"
+#include "microbench.h"
+
+// size of the matrices of the indexing benchmarks
+static const int numRows = 2048;
+static const std::vector<int> blockSizes = {16, 64, 256};
+
+// matrices are created once, collectively, before running the benchmarks
+static std::vector<std::unique_ptr<ParallelMatrix<double>>> matrices;
+static std::vector<blacsInt> contexts;
+
+// Primitives ----------------------------------------------------------------
+// Each iteration is one call, so the reported time is the time per call.
+// Indices sweep the matrix, rather than repeating one element.
+
+static void bmGlobal2Local(benchmark::State& state,
+                           ParallelMatrix<double>* m) {
+  int row = 0, col = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(m->global2Local(row, col));
+    if (++row == numRows) {
+      row = 0;
+      if (++col == numRows) col = 0;
+    }
+  }
+}
+
+static void bmIndicesAreLocal(benchmark::State& state,
+                              ParallelMatrix<double>* m) {
+  int row = 0, col = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(m->indicesAreLocal(row, col));
+    if (++row == numRows) {
+      row = 0;
+      if (++col == numRows) col = 0;
+    }
+  }
+}
+
+static void bmLocal2GlobalK(benchmark::State& state,
+                            ParallelMatrix<double>* m) {
+  int64_t numLocal = int64_t(m->localRows()) * m->localCols();
+  int64_t k = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(m->local2Global(k));
+    if (++k == numLocal) k = 0;
+  }
+}
+
+static void bmLocal2GlobalIJ(benchmark::State& state,
+                             ParallelMatrix<double>* m) {
+  int i = 0, j = 0;
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(m->local2Global(i, j));
+    if (++i == m->localRows()) {
+      i = 0;
+      if (++j == m->localCols()) j = 0;
+    }
+  }
+}
+
+// the vector getters also report the indices converted per second
+static void bmGetAllLocalRows(benchmark::State& state,
+                              ParallelMatrix<double>* m) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(m->getAllLocalRows());
+  }
+  state.SetItemsProcessed(state.iterations() * m->localRows());
+}
+
+static void bmGetAllLocalCols(benchmark::State& state,
+                              ParallelMatrix<double>* m) {
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(m->getAllLocalCols());
+  }
+  state.SetItemsProcessed(state.iterations() * m->localCols());
+}
+
+// Fill loops ------------------------------------------------------------------
+// Each iteration fills all the local elements of the matrix; the throughput
+// is reported in local elements per second.
+
+// loop over all global elements, skipping the non local ones
+static void bmFillGlobalLoop(benchmark::State& state,
+                             ParallelMatrix<double>* m) {
+  for (auto _ : state) {
+    for (int col = 0; col < numRows; col++) {
+      for (int row = 0; row < numRows; row++) {
+        if (m->indicesAreLocal(row, col)) (*m)(row, col) = row - col;
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * m->localRows() *
+                          m->localCols());
+}
+
+// loop over the list of local elements, as done in the examples
+static void bmFillLocalElements(benchmark::State& state,
+                                ParallelMatrix<double>* m) {
+  for (auto _ : state) {
+    for (auto [row, col] : m->getAllLocalElements()) {
+      (*m)(row, col) = row - col;
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * m->localRows() *
+                          m->localCols());
+}
+
+// loop over the local rows and columns
+static void bmFillLocalRowsCols(benchmark::State& state,
+                                ParallelMatrix<double>* m) {
+  for (auto _ : state) {
+    std::vector<int> rows = m->getAllLocalRows();
+    for (int col : m->getAllLocalCols()) {
+      for (int row : rows) {
+        (*m)(row, col) = row - col;
+      }
+    }
+    benchmark::ClobberMemory();
+  }
+  state.SetItemsProcessed(state.iterations() * m->localRows() *
+                          m->localCols());
+}
+
+void registerIndexingBenchmarks() {
+  const std::vector<std::tuple<std::string,
+      void (*)(benchmark::State&, ParallelMatrix<double>*)>> benchmarks = {
+      {"global2Local", bmGlobal2Local},
+      {"indicesAreLocal", bmIndicesAreLocal},
+      {"local2Global(k)", bmLocal2GlobalK},
+      {"local2Global(i,j)", bmLocal2GlobalIJ},
+      {"getAllLocalRows", bmGetAllLocalRows},
+      {"getAllLocalCols", bmGetAllLocalCols},
+      {"fill/globalLoop", bmFillGlobalLoop},
+      {"fill/localElements", bmFillLocalElements},
+      {"fill/localRowsCols", bmFillLocalRowsCols}};
+
+  char layout = 'R';
+  blacsInt iZero = 0;
+  for (auto [gridRows, gridCols] : benchmarkGridShapes()) {
+    blacsInt numBlacsRows = gridRows;
+    blacsInt numBlacsCols = gridCols;
+    blacsInt context;
+    blacs_get_(&iZero, &iZero, &context);
+    blacs_gridinit_(&context, &layout, &numBlacsRows, &numBlacsCols);
+    contexts.push_back(context);
+
+    for (int blockSize : blockSizes) {
+      int numBlocks = numRows / blockSize;
+      matrices.push_back(std::make_unique<ParallelMatrix<double>>(
+          numRows, numRows, numBlocks, numBlocks, context));
+      ParallelMatrix<double>* m = matrices.back().get();
+
+      for (auto& [name, function] : benchmarks) {
+        std::string fullName =
+            name + benchmarkSuffix(blockSize, numBlacsRows, numBlacsCols);
+        auto* b = benchmark::RegisterBenchmark(fullName.c_str(), function, m);
+        if (name.rfind("fill", 0) == 0) b->Unit(benchmark::kMillisecond);
+      }
+    }
+  }
+}
+
+void clearIndexingBenchmarks() {
+  matrices.clear();
+  for (blacsInt context : contexts) blacs_gridexit_(&context);
+  contexts.clear();
+}
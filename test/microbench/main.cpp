@@ -0,0 +1,51 @@
+#include <benchmark/benchmark.h>
+#include <cmath>
+#include "microbench.h"
+#include "mpi/mpiHelper.h"
+#include "utilities.h"
+
+// reporter for the non-head processes, which discards the results
+class NullReporter : public benchmark::BenchmarkReporter {
+ public:
+  bool ReportContext(const Context&) override { return true; }
+  void ReportRuns(const std::vector<Run>&) override {}
+};
+
+std::vector<std::tuple<int, int>> benchmarkGridShapes() {
+  int size = mpi->getSize();
+  int squareRows = int(sqrt(size));
+  while (size % squareRows != 0) squareRows--;
+  std::vector<std::tuple<int, int>> shapes = {{squareRows, size / squareRows}};
+  if (squareRows != 1) shapes.push_back({1, size});
+  if (size != 1) shapes.push_back({size, 1});
+  return shapes;
+}
+
+std::string benchmarkSuffix(const int& blockSize, const int& numBlacsRows,
+                            const int& numBlacsCols) {
+  return "/block:" + std::to_string(blockSize) + "/grid:" +
+         std::to_string(numBlacsRows) + "x" + std::to_string(numBlacsCols);
+}
+
+int main(int argc, char** argv) {
+  initMPI(argc, argv);
+  benchmark::Initialize(&argc, argv);
+
+  registerIndexingBenchmarks();
+  // largest message of the collective benchmarks, in bytes per process
+  size_t maxBytes = std::stoul(getArgument(argc, argv, "-max-bytes",
+                                           "16777216"));
+  registerCollectiveBenchmarks(maxBytes);
+
+  if (mpi->mpiHead()) {
+    benchmark::RunSpecifiedBenchmarks();
+  } else {
+    NullReporter reporter;
+    benchmark::RunSpecifiedBenchmarks(&reporter);
+  }
+  benchmark::Shutdown();
+
+  clearIndexingBenchmarks();
+  deleteMPI();
+  return 0;
+}
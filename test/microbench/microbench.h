@@ -0,0 +1,39 @@
+#pragma once
+
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Microbenchmarks, built with google-benchmark as the microbench target
+// and run with mpirun, e.g. mpirun -np 4 ./microbench -max-bytes 4294967296
+// Every MPI process runs the benchmarks, only the head prints the results.
+// Benchmarks are registered at runtime, since their parameters depend on the
+// number of MPI processes.
+
+/** Returns the shapes (rows, cols) of the process grids used by the
+ * benchmarks: the row, the column and the most square grid using all the
+ * MPI processes.
+ */
+std::vector<std::tuple<int, int>> benchmarkGridShapes();
+
+/** Returns a name suffix like "/block:64/grid:2x2".
+ */
+std::string benchmarkSuffix(const int& blockSize, const int& numBlacsRows,
+                            const int& numBlacsCols);
+
+/** Registers the benchmarks of the block-cyclic indexing primitives of
+ * ParallelMatrix and of the fill loops. Must be called by all processes,
+ * since it creates the distributed matrices.
+ */
+void registerIndexingBenchmarks();
+
+/** Frees the matrices created for the indexing benchmarks.
+ */
+void clearIndexingBenchmarks();
+
+/** Registers the benchmarks of the MPIcontroller collectives (bcast,
+ * allReduceSum, allGather, gatherv, bigAllGatherV) and of the equivalent
+ * raw MPI calls, on every communicator, for messages of 8 bytes to maxBytes
+ * per process, in steps of 8x.
+ */
+void registerCollectiveBenchmarks(const size_t& maxBytes);
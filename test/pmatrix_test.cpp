@@ -1,7 +1,47 @@
 #include "gtest/gtest.h"
 #include "PMatrix.h" 
+#include "SymmetricPMatrix.h"
+#include "BlockSparsePMatrix.h"
+#include "SparsePMatrix.h"
+#include "eigensolvers.h"
 #include <cmath>
 
+// A symmetric test matrix, with well separated eigenvalues
+// diagonalScale * i + diagonalShift and decaying off-diagonal elements.
+static double testElement(int i, int j, double diagonalShift = 1.,
+                          double diagonalScale = 1.) {
+  return (i == j) ? diagonalScale * i + diagonalShift
+                  : 1. / (1. + std::abs(i - j));
+}
+
+static void fillTestMatrix(ParallelMatrix<double>& pMat,
+                           double diagonalShift = 1.,
+                           double diagonalScale = 1.) {
+  for(int i = 0; i < pMat.rows(); i++) {
+    for(int j = 0; j < pMat.cols(); j++) {
+      if(pMat.indicesAreLocal(i,j)) {
+        pMat(i,j) = testElement(i, j, diagonalShift, diagonalScale);
+      }
+    }
+  }
+}
+
+// A square blacs grid, for matrices that must share a blacs context,
+// released at the end of the test (declare it before those matrices).
+struct TestBlacsGrid {
+  blacsInt context;
+  TestBlacsGrid() {
+    blacsInt iZero = 0;
+    blacsInt numBlacsRows = int(sqrt(mpi->getSize()));
+    char layout = 'R';
+    blacs_get_(&iZero, &iZero, &context);
+    blacs_gridinit_(&context, &layout, &numBlacsRows, &numBlacsRows);
+  }
+  ~TestBlacsGrid() { blacs_gridexit_(&context); }
+  TestBlacsGrid(const TestBlacsGrid&) = delete;
+  TestBlacsGrid& operator=(const TestBlacsGrid&) = delete;
+};
+
 TEST (PMatrixTest, diagonalize) { 
    
   int numRows = 2; 
@@ -50,3 +90,475 @@ TEST (PMatrixTest, diagonalize) {
   if(pMat.indicesAreLocal(1,1)) { EXPECT_EQ(pMat(1,1), 0.0); }
 
 }
+
+TEST (PMatrixTest, localIndexing) {
+
+  // small blocks, so that each process owns several blocks
+  // and the conversions cross block boundaries
+  int numRows = 10;
+  int numBlocks = 5;
+  ParallelMatrix<double> pMat(numRows, numRows, numBlocks, numBlocks);
+
+  std::vector<int> localRows = pMat.getAllLocalRows();
+  std::vector<int> localCols = pMat.getAllLocalCols();
+  ASSERT_EQ(int(localRows.size()), pMat.localRows());
+  ASSERT_EQ(int(localCols.size()), pMat.localCols());
+
+  for(int j = 0; j < pMat.localCols(); j++) {
+    for(int i = 0; i < pMat.localRows(); i++) {
+      int k = j * pMat.localRows() + i;
+      auto [row, col] = pMat.local2Global(k);
+      EXPECT_EQ(pMat.local2Global(i, j), std::make_tuple(row, col));
+      EXPECT_EQ(localRows[i], row);
+      EXPECT_EQ(localCols[j], col);
+      EXPECT_EQ(pMat.global2Local(row, col), k);
+    }
+  }
+}
+
+TEST (PMatrixTest, diagonalizeMixedPrecision) {
+
+  // a symmetric matrix with well separated eigenvalues
+  int numRows = 8;
+  ParallelMatrix<double> pMat(numRows, numRows);
+  fillTestMatrix(pMat);
+
+  // diagonalize overwrites the matrix, so we work on copies
+  ParallelMatrix<double> pMatCopy = pMat;
+  auto [eigenvalues, eigenvectors] = pMatCopy.diagonalize();
+  auto [mixedEigenvalues, mixedEigenvectors] = pMat.diagonalizeMixedPrecision();
+
+  for(int i = 0; i < numRows; i++) {
+    EXPECT_NEAR(mixedEigenvalues[i], eigenvalues[i], 1e-12);
+  }
+
+  // eigenvectors are defined up to a sign: compare |<x_i,y_i>| = 1
+  auto overlap = eigenvectors.prod(mixedEigenvectors, 'T', 'N');
+  for(int i = 0; i < numRows; i++) {
+    if(overlap.indicesAreLocal(i,i)) {
+      EXPECT_NEAR(std::abs(overlap(i,i)), 1., 1e-12);
+    }
+  }
+}
+
+TEST (PMatrixTest, solveMixedPrecision) {
+
+  // a well conditioned system with known solution x_i = i
+  // the matrix and the right hand side must share a blacs context
+  int numRows = 8;
+  TestBlacsGrid grid;
+  blacsInt context = grid.context;
+  ParallelMatrix<double> pMat(numRows, numRows, 4, 4, context);
+  ParallelMatrix<double> rhs(numRows, 1, 4, 1, context);
+  for(int i = 0; i < numRows; i++) {
+    double b = 0.;
+    for(int j = 0; j < numRows; j++) {
+      double aij = testElement(i, j, 4.);
+      if(pMat.indicesAreLocal(i,j)) pMat(i,j) = aij;
+      b += aij * j;
+    }
+    if(rhs.indicesAreLocal(i,0)) rhs(i,0) = b;
+  }
+  ParallelMatrix<double> pMatCopy = pMat;
+  ParallelMatrix<double> rhsCopy = rhs;
+
+  int numIterations = 0;
+  auto x = pMat.solveMixedPrecision(rhs, &numIterations);
+  EXPECT_GE(numIterations, 0);  // converged without the double fallback
+  auto xDouble = pMatCopy.solve(rhsCopy);
+  for(int i = 0; i < numRows; i++) {
+    if(x.indicesAreLocal(i,0)) {
+      EXPECT_NEAR(x(i,0), double(i), 1e-12);
+      EXPECT_NEAR(xDouble(i,0), double(i), 1e-12);
+    }
+  }
+}
+
+TEST (PMatrixTest, symmetricStorage) {
+
+  // a symmetric matrix, with several blocks per process
+  int numRows = 8;
+  ParallelMatrix<double> pMat(numRows, numRows, 4, 4);
+  fillTestMatrix(pMat);
+  SymmetricParallelMatrix<double> sMat(pMat);
+
+  // less than the dense storage, summed over processes
+  double packedSize = sMat.localSize();
+  mpi->allReduceSum(&packedSize);
+  EXPECT_LT(packedSize, numRows * numRows);
+
+  // elements of both triangles, read from the upper one
+  auto full = sMat.toParallelMatrix(true);
+  for(int i = 0; i < numRows; i++) {
+    for(int j = 0; j < numRows; j++) {
+      if(full.indicesAreLocal(i,j)) {
+        EXPECT_DOUBLE_EQ(full(i,j), pMat(i,j));
+      }
+      if(sMat.indicesAreLocal(i,j)) {
+        EXPECT_DOUBLE_EQ(sMat.get(i,j), testElement(i, j));
+      }
+    }
+  }
+  EXPECT_NEAR(sMat.dot(sMat), pMat.dot(pMat), 1e-12);
+
+  ParallelMatrix<double> pMatCopy = pMat;
+  auto [eigenvalues, eigenvectors] = pMatCopy.diagonalize();
+  auto [packedEigenvalues, packedEigenvectors] = sMat.diagonalize();
+  for(int i = 0; i < numRows; i++) {
+    EXPECT_NEAR(packedEigenvalues[i], eigenvalues[i], 1e-12);
+  }
+  // as for the dense matrix, diagonalize() overwrites the packed one
+  EXPECT_EQ(sMat.squaredNorm(), 0.);
+}
+
+TEST (PMatrixTest, blockSparse) {
+
+  // 2x2 tiles, only the tiles next to the diagonal are nonzero
+  int numRows = 8;
+  ParallelMatrix<double> pMat(numRows, numRows, 4, 4);
+  for(int i = 0; i < numRows; i++) {
+    for(int j = 0; j < numRows; j++) {
+      if(pMat.indicesAreLocal(i,j)) {
+        pMat(i,j) = (std::abs(i / 2 - j / 2) > 1) ? 0. : 1. + i + 0.5 * j;
+      }
+    }
+  }
+  BlockSparseParallelMatrix<double> sMat(pMat);
+  EXPECT_EQ(sMat.numNonzeroTiles(), 10);
+  EXPECT_LT(sMat.fillRatio(), 1.);
+
+  auto dense = sMat.toParallelMatrix();
+  for(int i = 0; i < numRows; i++) {
+    for(int j = 0; j < numRows; j++) {
+      if(dense.indicesAreLocal(i,j)) {
+        EXPECT_DOUBLE_EQ(dense(i,j), pMat(i,j));
+        EXPECT_DOUBLE_EQ(sMat.get(i,j), pMat(i,j));
+      }
+    }
+  }
+  EXPECT_NEAR(sMat.dot(sMat), pMat.dot(pMat), 1e-10);
+
+  // the product fills the tiles at distance 2 from the diagonal
+  ParallelMatrix<double> pMatCopy = pMat;
+  auto product = pMat.prod(pMatCopy);
+  auto sparseProduct = sMat.prod(sMat);
+  EXPECT_EQ(sparseProduct.numNonzeroTiles(), 14);
+  auto denseProduct = sparseProduct.toParallelMatrix();
+  for(int i = 0; i < numRows; i++) {
+    for(int j = 0; j < numRows; j++) {
+      if(product.indicesAreLocal(i,j)) {
+        EXPECT_NEAR(denseProduct(i,j), product(i,j), 1e-10);
+      }
+    }
+  }
+
+  // adding the product adds its tiles
+  sMat += sparseProduct;
+  EXPECT_EQ(sMat.numNonzeroTiles(), 14);
+  product += pMat;
+  EXPECT_NEAR(sMat.squaredNorm(), product.squaredNorm(), 1e-8);
+}
+
+TEST (PMatrixTest, sparseMatrix) {
+
+  // a tridiagonal matrix, assembled on the head process with the diagonal
+  // given in two halves, and two vectors on the same blacs context
+  int numRows = 10;
+  TestBlacsGrid grid;
+  blacsInt context = grid.context;
+  std::vector<SparseParallelMatrix<double>::Triplet> triplets;
+  if(mpi->mpiHead()) {
+    for(int i = 0; i < numRows; i++) {
+      triplets.push_back({i, i, 1. + i});
+      triplets.push_back({i, i, 1. + i});
+      if(i > 0) triplets.push_back({i, i - 1, -1.});
+      if(i < numRows - 1) triplets.push_back({i, i + 1, -0.5});
+    }
+  }
+  SparseParallelMatrix<double> sMat(numRows, numRows, triplets);
+  EXPECT_EQ(sMat.numNonzeros(), size_t(3 * numRows - 2));
+
+  ParallelMatrix<double> pMat = sMat.toParallelMatrix(5, 5, context);
+  for(int i = 0; i < numRows; i++) {
+    for(int j = 0; j < numRows; j++) {
+      if(pMat.indicesAreLocal(i,j)) {
+        double aij = (i == j) ? 2. + 2. * i
+            : (j == i - 1 ? -1. : (j == i + 1 ? -0.5 : 0.));
+        EXPECT_DOUBLE_EQ(pMat(i,j), aij);
+      }
+    }
+  }
+
+  ParallelMatrix<double> x(numRows, 2, 5, 1, context);
+  for(int i = 0; i < numRows; i++) {
+    for(int j = 0; j < 2; j++) {
+      if(x.indicesAreLocal(i,j)) x(i,j) = 1. + i * (j + 1);
+    }
+  }
+  auto y = sMat.prod(x);
+  auto yDense = pMat.prod(x);
+  for(int i = 0; i < numRows; i++) {
+    for(int j = 0; j < 2; j++) {
+      if(y.indicesAreLocal(i,j)) {
+        EXPECT_NEAR(y(i,j), yDense(i,j), 1e-12);
+      }
+    }
+  }
+}
+
+TEST (PMatrixTest, lanczos) {
+
+  // the lowest eigenvalues of a symmetric matrix, with a small basis
+  // so that the solver restarts. The callback operator below shares the
+  // blacs context of the matrix
+  int numRows = 40;
+  int numEigenvalues = 3;
+  TestBlacsGrid grid;
+  blacsInt context = grid.context;
+  ParallelMatrix<double> pMat(numRows, numRows, 0, 0, context);
+  fillTestMatrix(pMat);
+  ParallelMatrix<double> pMatCopy = pMat;
+  auto [eigenvalues, eigenvectors] = pMatCopy.diagonalize();
+
+  MatrixOperator<double> op(pMat);
+  LanczosOptions options;
+  options.basisSize = 10;
+  auto [lanczosEigenvalues, lanczosEigenvectors] =
+      lanczos(op, numEigenvalues, nullptr, options);
+  ASSERT_EQ(int(lanczosEigenvalues.size()), numEigenvalues);
+  for(int i = 0; i < numEigenvalues; i++) {
+    EXPECT_NEAR(lanczosEigenvalues[i], eigenvalues[i], 1e-10);
+  }
+
+  // residuals A x - theta x are small
+  auto residual = pMat.prod(lanczosEigenvectors).toEigen();
+  auto x = lanczosEigenvectors.toEigen();
+  for(int i = 0; i < numEigenvalues; i++) {
+    residual.col(i) -= lanczosEigenvalues[i] * x.col(i);
+    EXPECT_LT(residual.col(i).norm(), 1e-8);
+  }
+
+  // same operator, given as a function
+  CallbackOperator<double> callbackOp(
+      numRows,
+      [&](const ParallelMatrix<double>& v) { return pMat.prod(v); }, 0,
+      context);
+  auto [callbackEigenvalues, callbackEigenvectors] =
+      lanczos(callbackOp, numEigenvalues);
+  for(int i = 0; i < numEigenvalues; i++) {
+    EXPECT_NEAR(callbackEigenvalues[i], eigenvalues[i], 1e-10);
+  }
+}
+
+TEST (PMatrixTest, lobpcg) {
+
+  // the lowest eigenvalues of a symmetric matrix, with the diagonal
+  // preconditioner, then again after a small change of the matrix,
+  // starting from the previous eigenvectors
+  int numRows = 60;
+  int numEigenvalues = 4;
+  ParallelMatrix<double> pMat(numRows, numRows);
+  LobpcgOptions options;
+  options.diagonal.resize(numRows);
+  fillTestMatrix(pMat);
+  for(int i = 0; i < numRows; i++) options.diagonal[i] = testElement(i, i);
+  MatrixOperator<double> op(pMat);
+  int numIterations = 0;
+  auto [eigenvalues, eigenvectors] =
+      lobpcg(op, numEigenvalues, nullptr, nullptr, options, &numIterations);
+
+  for(int i = 0; i < numRows; i++) {
+    options.diagonal[i] += 1e-3 * sin(i);
+    if(pMat.indicesAreLocal(i,i)) pMat(i,i) += 1e-3 * sin(i);
+  }
+  int numWarmIterations = 0;
+  auto [warmEigenvalues, warmEigenvectors] = lobpcg(
+      op, numEigenvalues, &eigenvectors, nullptr, options, &numWarmIterations);
+  EXPECT_LT(numWarmIterations, numIterations);
+
+  ParallelMatrix<double> pMatCopy = pMat;
+  auto [exactEigenvalues, exactEigenvectors] = pMatCopy.diagonalize();
+  for(int i = 0; i < numEigenvalues; i++) {
+    EXPECT_NEAR(warmEigenvalues[i], exactEigenvalues[i], 1e-10);
+  }
+}
+
+TEST (PMatrixTest, chebyshevFilteredSubspace) {
+
+  // eigenvectors of a symmetric matrix, updated after a small change of
+  // its diagonal, with two more vectors than eigenvalues
+  int numRows = 60;
+  int numEigenvalues = 4;
+  int numVectors = numEigenvalues + 2;
+  ParallelMatrix<double> pMat(numRows, numRows);
+  fillTestMatrix(pMat);
+  ParallelMatrix<double> pMatCopy = pMat;
+  auto [eigenvalues, eigenvectors] = pMatCopy.diagonalize();
+  auto initialVectors = eigenvectors.getColumns(0, numVectors);
+
+  for(int i = 0; i < numRows; i++) {
+    if(pMat.indicesAreLocal(i,i)) pMat(i,i) += 1e-2 * sin(i);
+  }
+  MatrixOperator<double> op(pMat);
+  auto [lowerBound, upperBound] = spectralBounds(op);
+
+  auto [newEigenvalues, newEigenvectors] =
+      chebyshevFilteredSubspace(op, numEigenvalues, initialVectors, upperBound);
+  ASSERT_EQ(int(newEigenvalues.size()), numVectors);
+  pMatCopy = pMat;
+  auto [exactEigenvalues, exactEigenvectors] = pMatCopy.diagonalize();
+  EXPECT_GE(upperBound, exactEigenvalues[numRows - 1]);
+  for(int i = 0; i < numEigenvalues; i++) {
+    EXPECT_NEAR(newEigenvalues[i], exactEigenvalues[i], 1e-10);
+  }
+}
+
+TEST (PMatrixTest, diagonalizeSlices) {
+
+  // spectrum slicing over the MPI pools (run with -ps to use more than one)
+  // gives the eigenpairs of diagonalize()
+  int numRows = 16;
+  ParallelMatrix<double> pMat(numRows, numRows, 4, 4);
+  fillTestMatrix(pMat);
+  auto [eigenvalues, eigenvectors] = pMat.diagonalizeSlices();
+  ParallelMatrix<double> pMatCopy = pMat;
+  auto [exactEigenvalues, exactEigenvectors] = pMatCopy.diagonalize();
+  ASSERT_EQ(int(eigenvalues.size()), numRows);
+  for(int i = 0; i < numRows; i++) {
+    EXPECT_NEAR(eigenvalues[i], exactEigenvalues[i], 1e-10);
+  }
+
+  // eigenvectors up to a sign: |<x_i,y_i>| = 1
+  auto overlap = exactEigenvectors.prod(eigenvectors, 'T', 'N');
+  for(int i = 0; i < numRows; i++) {
+    if(overlap.indicesAreLocal(i,i)) {
+      EXPECT_NEAR(std::abs(overlap(i,i)), 1., 1e-10);
+    }
+  }
+}
+
+TEST (PMatrixTest, applyFunction) {
+
+  // f(A) = V f(Lambda) V^T, checked through products:
+  // sqrt(A) sqrt(A) = A (positive f, with p?syrk) and A^-1 A = 1 (p?gemm)
+  int numRows = 12;
+  ParallelMatrix<double> pMat(numRows, numRows, 3, 3);
+  fillTestMatrix(pMat, 2.);
+  ParallelMatrix<double> pMatCopy = pMat;
+
+  auto root = pMat.applyFunction([](double x) { return std::sqrt(x); });
+  auto square = root.prod(root);
+  square -= pMatCopy;
+  EXPECT_NEAR(square.norm(), 0., 1e-10);
+
+  // the eigendecomposition kept by the second call is reused by the third
+  auto shifted = pMat.applyFunction([](double x) { return -1. / x; }, true);
+  auto identity = shifted.prod(pMatCopy);
+  identity *= -1.;
+  ParallelMatrix<double> pMatEye(numRows, numRows, 3, 3);
+  pMatEye.eye();
+  identity -= pMatEye;
+  EXPECT_NEAR(identity.norm(), 0., 1e-10);
+  auto keptRoot = pMat.applyFunction([](double x) { return std::sqrt(x); });
+  keptRoot -= root;
+  EXPECT_NEAR(keptRoot.norm(), 0., 1e-12);
+
+  // the matrix itself is unchanged
+  pMatCopy -= pMat;
+  EXPECT_NEAR(pMatCopy.norm(), 0., 1e-12);
+}
+
+TEST (PMatrixTest, applyFunctionAfterSolve) {
+
+  // solve() overwrites its copy of the right hand side: the solution must
+  // not keep the eigendecomposition cached by the right hand side
+  int numRows = 8;
+  ParallelMatrix<double> rhs(numRows, numRows, 2, 2);
+  fillTestMatrix(rhs, 2.);
+  auto rhsCopy = rhs.applyFunction([](double x) { return x; }, true);
+
+  // A = 2, so that X = rhs / 2 is symmetric
+  ParallelMatrix<double> pMat(numRows, numRows, 2, 2);
+  pMat.eye();
+  pMat *= 2.;
+  ParallelMatrix<double> x = pMat.solve(rhs);
+  auto xCopy = x.applyFunction([](double v) { return v; });
+  rhsCopy *= 0.5;
+  xCopy -= rhsCopy;
+  EXPECT_NEAR(xCopy.norm(), 0., 1e-10);
+}
+
+TEST (PMatrixTest, matrixFunctionsWithoutDiagonalization) {
+
+  // exp(A) by Pade and by a Chebyshev expansion, against the
+  // eigendecomposition, with exp(A) exp(-A) = 1 as a further check
+  int numRows = 10;
+  ParallelMatrix<double> pMat(numRows, numRows, 2, 2);
+  fillTestMatrix(pMat, -2., 0.5);
+  ParallelMatrix<double> pMatCopy = pMat;
+  auto exact = pMatCopy.applyFunction([](double x) { return std::exp(x); });
+  double scale = exact.norm();
+
+  int numProducts = 0;
+  auto pade = pMat.expm(0., &numProducts);
+  EXPECT_GT(numProducts, 0);
+  auto inverse = (-pMat).expm();
+  auto identity = pade.prod(inverse);
+  ParallelMatrix<double> pMatEye(numRows, numRows, 2, 2);
+  pMatEye.eye();
+  identity -= pMatEye;
+  EXPECT_NEAR(identity.norm(), 0., 1e-12);
+  pade -= exact;
+  EXPECT_NEAR(pade.norm() / scale, 0., 1e-13);
+
+  int degree = 0;
+  auto chebyshev = pMat.chebyshevFunction(
+      [](double x) { return std::exp(x); }, 1e-6, 0., 0., &degree);
+  EXPECT_GT(degree, 0);
+  chebyshev -= exact;
+  EXPECT_NEAR(chebyshev.norm() / scale, 0., 1e-5);
+}
+
+TEST (PMatrixTest, diagonalOperations) {
+
+  // scaling rows and columns, diagonal and trace, against the elements
+  int numRows = 7;
+  ParallelMatrix<double> pMat(numRows, numRows, 3, 3);
+  for (auto [i, j] : pMat.getAllLocalElements()) {
+    pMat(i, j) = 10. * i + j;
+  }
+  std::vector<double> factors(numRows);
+  for (int i = 0; i < numRows; i++) factors[i] = i + 1.;
+
+  ParallelMatrix<double> rows = pMat;
+  rows.scaleRows(factors);
+  ParallelMatrix<double> cols = pMat;
+  cols.scaleCols(factors);
+  for (auto [i, j] : pMat.getAllLocalElements()) {
+    EXPECT_DOUBLE_EQ(rows(i, j), (i + 1.) * (10. * i + j));
+    EXPECT_DOUBLE_EQ(cols(i, j), (j + 1.) * (10. * i + j));
+  }
+
+  pMat.addToDiagonal(factors);
+  pMat.addToDiagonal(0.5);
+  std::vector<double> diagonal = pMat.getDiagonal();
+  ASSERT_EQ(int(diagonal.size()), numRows);
+  double trace = 0.;
+  for (int i = 0; i < numRows; i++) {
+    EXPECT_DOUBLE_EQ(diagonal[i], 11. * i + i + 1.5);
+    trace += diagonal[i];
+  }
+  EXPECT_DOUBLE_EQ(pMat.trace(), trace);
+}
+
+TEST (PMatrixTest, eyeWithUnequalBlocks) {
+
+  // the local diagonal blocks, when row and column blocks differ in size
+  int numRows = 10;
+  ParallelMatrix<double> pMat(numRows, numRows, 4, 3);
+  pMat.eye();
+  for (auto [i, j] : pMat.getAllLocalElements()) {
+    EXPECT_EQ(pMat(i, j), i == j ? 1. : 0.);
+  }
+  EXPECT_DOUBLE_EQ(pMat.trace(), double(numRows));
+}